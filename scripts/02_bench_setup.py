@@ -33,6 +33,11 @@ def main():
         pct = r.total_time / total_time * 100
         print(f"  - {r.component}/{r.operation}: {r.total_time:.4f}s ({pct:.1f}%)")
     
+    # Same index built as partial graphs in parallel, then merged
+    merged = runner.benchmark_parallel_build(vectors)
+    for r in merged:
+        print(f"  - {r.component}/{r.operation}: {r.total_time:.4f}s")
+    
     # Save results
     runner.results.save("./results/setup_timings.json")
 
@@ -26,6 +26,15 @@ def main():
     # Run retrieval tests
     results = runner.benchmark_retrieve(vectors)
     
+    # One-by-one vs. query-batched search
+    results += runner.benchmark_query_batching(vectors)
+    
+    # Coarse traversal plus precise rerank (index.two_stage)
+    results += runner.benchmark_two_stage(vectors)
+    
+    # Plaintext PQ codes, encrypted query (index.pq)
+    results += runner.benchmark_pq(vectors)
+    
     # Print summary
     print("\n" + "="*60)
     print("Retrieve Phase Summary")
@@ -26,19 +26,32 @@ def main():
     # Run retrieval tests
     results = runner.benchmark_retrieve(vectors)
     
+    # Rounds vs. distance evaluations per beam width
+    results += runner.benchmark_beam_widths(vectors)
+    
+    # Upper-layer descent on the server vs. on the client
+    results += runner.benchmark_client_routing(vectors)
+    
+    # Optional: server-side top-k with encrypted comparison (deep context, slow)
+    if runner.config.get('server_topk', {}).get('enabled', False):
+        results += runner.benchmark_server_topk(vectors)
+    
     # Print summary
     print("\n" + "="*60)
     print("Retrieve Phase Summary (Variant 2)")
     print("="*60)
     
     for r in results:
-        if 'search' in r.operation:
+        if 'search' in r.operation or 'block' in r.operation:
             print(f"\n{r.operation}:")
             print(f"  Total Time: {r.total_time:.4f}s")
             print(f"  Avg per query: {r.avg_time_per_item*1000:.4f}ms")
             if r.communication_bytes > 0:
                 print(f"  Communication: {r.communication_bytes / (1024*1024):.2f} MB")
                 print(f"  Comm per query: {r.communication_bytes / r.num_items / (1024):.2f} KB")
+            if r.details and 'rounds_per_query' in r.details:
+                print(f"  Rounds per query: {r.details['rounds_per_query']:.1f}")
+                print(f"  Distance evals per query: {r.details['distance_evals_per_query']:.1f}")
     
     runner.results.save("./results/retrieve_timings2.json")
 
@@ -26,6 +26,9 @@ def main():
     # Run update tests
     results = runner.benchmark_update(vectors)
     
+    # Same updates while searches keep running
+    results += runner.benchmark_update_concurrent(vectors)
+    
     # Print summary
     print("\n" + "="*60)
     print("Update Phase Summary")
@@ -36,6 +39,9 @@ def main():
         print(f"  Total: {r.total_time:.4f}s")
         print(f"  Avg per vector: {r.avg_time_per_item*1000:.4f}ms")
         print(f"  Throughput: {r.num_items/r.total_time:.2f} vectors/sec")
+        if r.details:
+            print(f"  Concurrent queries: {int(r.details['queries_served'])} "
+                  f"(p99 {r.details['query_p99_ms']:.2f}ms)")
     
     runner.results.save("./results/update_timings.json")
 
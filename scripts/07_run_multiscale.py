@@ -111,6 +111,9 @@ class MultiScaleRunner:
         update_results = runner.benchmark_update(vectors)
         scale_results['update'] = [r.to_dict() for r in update_results]
         
+        # Peak RSS and key/index bytes per phase
+        scale_results['memory'] = runner.results.memory
+        
         return scale_results
     
     def run_all_scales(self, scales: list = None) -> dict:
@@ -146,8 +149,9 @@ def print_summary(results: dict):
     print("="*80)
     
     # Table header
-    print(f"\n{'Scale':<10} {'Vectors':>12} {'Sample':>10} {'Setup(s)':>12} {'Retrieve(ms)':>14} {'Update(s)':>12}")
-    print("-"*80)
+    print(f"\n{'Scale':<10} {'Vectors':>12} {'Sample':>10} {'Setup(s)':>12} {'Retrieve(ms)':>14} {'Update(s)':>12}"
+          f" {'PeakRSS(MB)':>12} {'Index(MB)':>10}")
+    print("-"*104)
     
     for scale_name, scale_data in results['scales'].items():
         num_vectors = scale_data['num_vectors']
@@ -165,9 +169,15 @@ def print_summary(results: dict):
         # Compute total update time
         update_time = sum(r['total_time'] for r in scale_data['update'])
         
-        print(f"{scale_name:<10} {num_vectors:>12,} {sample_size:>10,} {setup_time:>12.4f} {avg_retrieve:>14.4f} {update_time:>12.4f}")
+        # Memory: largest phase peak, index size after setup
+        memory = scale_data.get('memory', {})
+        peak_rss = max((m['peak_rss_mb'] for m in memory.values()), default=0.0)
+        index_mb = memory.get('setup', {}).get('index_mb', 0.0)
+        
+        print(f"{scale_name:<10} {num_vectors:>12,} {sample_size:>10,} {setup_time:>12.4f} {avg_retrieve:>14.4f} {update_time:>12.4f}"
+              f" {peak_rss:>12.1f} {index_mb:>10.1f}")
     
-    print("-"*80)
+    print("-"*104)
     print("\nNote: Retrieve latency is average per query in milliseconds")
 
 
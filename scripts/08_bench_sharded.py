@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+"""
+08_bench_sharded.py
+Benchmark the sharded mode: index split across local worker processes
+"""
+import sys
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src.python.bench_runner import BenchmarkRunner
+
+
+def main():
+    print("="*60)
+    print("PP-RAG HE Benchmark - Sharded Index")
+    print("="*60)
+    
+    runner = BenchmarkRunner("./config/config.yaml")
+    vectors = runner.load_data()
+    
+    num_shards = int(sys.argv[1]) if len(sys.argv) > 1 else None
+    results = runner.benchmark_sharded(vectors, num_shards)
+    
+    # Print summary
+    print("\n" + "="*60)
+    print("Sharded Index Summary")
+    print("="*60)
+    
+    for r in results:
+        print(f"\n{r.operation} ({int(r.details['shards'])} shards):")
+        print(f"  Total: {r.total_time:.4f}s")
+        print(f"  Avg per item: {r.avg_time_per_item*1000:.4f}ms")
+        if 'bytes_per_query' in r.details:
+            print(f"  Query bytes sent: {r.details['bytes_per_query']/1e3:.1f} KB")
+    
+    runner.results.save("./results/sharded_timings.json")
+
+
+if __name__ == "__main__":
+    main()
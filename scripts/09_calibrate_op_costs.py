@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+"""
+09_calibrate_op_costs.py
+Measure per-op CKKS costs on real SEAL for the simulator cost model
+"""
+import sys
+import platform
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src.python.data_generator import load_config
+from src.python.ckks_wrapper import HEContext, SIM_BACKEND, pprag_core
+from src.python.cost_model import CostModel, DEFAULT_COSTS_PATH
+
+
+def main():
+    print("="*60)
+    print("PP-RAG HE Benchmark - Op Cost Calibration")
+    print("="*60)
+
+    if SIM_BACKEND:
+        sys.exit("Calibration needs the real SEAL build; unset PPRAG_SIM_BACKEND")
+
+    config = load_config("./config/config.yaml")
+    reps = int(sys.argv[1]) if len(sys.argv) > 1 else 20
+    he_ctx = HEContext(config)
+
+    costs = pprag_core.measure_op_costs(he_ctx.ctx, reps)
+    enc_config = config.get('encryption', {})
+    model = CostModel(costs, meta={
+        'host': platform.node(),
+        'processor': platform.processor(),
+        'poly_modulus_degree': enc_config.get('poly_modulus_degree', 8192),
+        'scale_power': enc_config.get('scale_power', 40),
+        'coeff_modulus_bits': enc_config.get('coeff_modulus_bits', [60, 40, 40, 60]),
+        'reps': reps,
+    })
+
+    print("\nSeconds per call (by chain index):")
+    for op, per_level in sorted(model.costs.items()):
+        levels = "  ".join(f"L{level}={s*1e3:.3f}ms" for level, s in sorted(per_level.items()))
+        print(f"  {op:15s} {levels}")
+
+    model.save(DEFAULT_COSTS_PATH)
+
+
+if __name__ == "__main__":
+    main()
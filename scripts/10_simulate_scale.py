@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""
+10_simulate_scale.py
+Sweep index size and HNSW parameters on the simulator backend
+
+Runs the unchanged index code on pprag_core_sim (plaintext arithmetic, per-level
+op counts) and prices the counts with the calibrated cost model, so scales and
+parameter grids that would take hours under real CKKS finish in minutes.
+Recall is exact: the simulator builds and searches the same linked graph with
+the same distances as an ideal CKKS run. A run whose recall stays near chance
+(k / N) means the graph was not linked: it is saved flagged 'graph_unlinked'
+and the sweep stops there.
+"""
+import os
+import sys
+import json
+import itertools
+from pathlib import Path
+
+import numpy as np
+
+# Must be set before the wrappers import the native module
+os.environ.setdefault('PPRAG_SIM_BACKEND', '1')
+
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src.python.data_generator import load_config, generate_synthetic_embeddings, generate_query_vectors
+from src.python.ckks_wrapper import HEContext, SecureHNSWWrapper, SIM_BACKEND, pprag_core
+from src.python.cost_model import CostModel, DEFAULT_COSTS_PATH, total_ops
+
+
+def exact_top_k(vectors, queries, k):
+    """Brute-force L2 top-k ids, one query at a time so memory stays O(N)"""
+    norms = (vectors ** 2).sum(axis=1)
+    truth = np.empty((len(queries), k), dtype=np.int64)
+    for i, q in enumerate(queries):
+        dists = norms - 2.0 * (vectors @ q)  # |q|^2 is the same for every row
+        top = np.argpartition(dists, k - 1)[:k]
+        truth[i] = top[np.argsort(dists[top])]
+    return truth
+
+
+def simulate(he_ctx, config, vectors, queries, truth, k):
+    """Build and query one configuration; returns op counts per phase and recall"""
+    hnsw = SecureHNSWWrapper(he_ctx, config)
+
+    pprag_core.reset_sim_op_counts()
+    hnsw.build_index(vectors)
+    build_counts = pprag_core.sim_op_counts()
+
+    pprag_core.reset_sim_op_counts()
+    hits = 0
+    for q, expected in zip(queries, truth):
+        found = hnsw.search(q, k)
+        hits += len(set(found.tolist()) & set(expected.tolist()))
+    search_counts = pprag_core.sim_op_counts()
+
+    return build_counts, search_counts, hits / (len(queries) * k)
+
+
+def main():
+    print("="*60)
+    print("PP-RAG HE Benchmark - Simulated Scaling")
+    print("="*60)
+
+    if not SIM_BACKEND:
+        sys.exit("The sweep runs on the simulator build; set PPRAG_SIM_BACKEND=1")
+
+    config = load_config("./config/config.yaml")
+    sim_config = config.get('simulation', {})
+    dim = config['dataset']['dimension']
+    sizes = sim_config.get('num_vectors', [1000])
+    ms = sim_config.get('hnsw_m', [config['index'].get('hnsw_m', 16)])
+    efs = sim_config.get('hnsw_ef_search', [config['index'].get('hnsw_ef_search', 100)])
+    num_queries = sim_config.get('num_queries', 20)
+    k = sim_config.get('top_k', 10)
+
+    model = CostModel.load(sim_config.get('op_costs', DEFAULT_COSTS_PATH))
+    he_ctx = HEContext(config)
+
+    results = []
+    unlinked = None
+    for n in sizes:
+        vectors = generate_synthetic_embeddings(n, dim).astype(np.float64)
+        queries = generate_query_vectors(vectors, num_queries)
+        truth = exact_top_k(vectors, queries, k)
+
+        for m, ef in itertools.product(ms, efs):
+            run_config = dict(config)
+            run_config['index'] = dict(config['index'], hnsw_m=m, hnsw_ef_search=ef)
+            build_counts, search_counts, recall = simulate(he_ctx, run_config, vectors, queries, truth, k)
+
+            entry = {
+                'num_vectors': n, 'hnsw_m': m, 'hnsw_ef_search': ef,
+                f'recall@{k}': recall,
+                'predicted_build_s': model.predict(build_counts),
+                'predicted_query_s': model.predict(search_counts) / num_queries,
+                'ops_per_query': total_ops(search_counts) / num_queries,
+                'query_breakdown_s': {op: s / num_queries
+                                      for op, s in model.breakdown(search_counts).items()},
+            }
+            results.append(entry)
+            print(f"\nN={n} M={m} ef={ef}:")
+            print(f"  Recall@{k}: {recall:.3f}")
+            print(f"  Predicted build: {entry['predicted_build_s']:.1f}s")
+            print(f"  Predicted query: {entry['predicted_query_s']*1000:.1f}ms "
+                  f"({entry['ops_per_query']:.0f} HE ops)")
+            if recall < min(0.5, 10 * k / n):
+                entry['graph_unlinked'] = True
+                unlinked = (f"N={n} M={m} ef={ef}: recall@{k} {recall:.3f} is near chance ({k / n:.3f}), "
+                            f"the index graph is not linked")
+                break
+        if unlinked:
+            break
+
+    out = Path("./results/simulated_scaling.json")
+    out.parent.mkdir(parents=True, exist_ok=True)
+    with open(out, 'w', encoding='utf-8') as f:
+        json.dump({'cost_model': model.meta, 'runs': results}, f, indent=2)
+    print(f"\nResults saved to {out}")
+    if unlinked:
+        sys.exit(unlinked)
+
+
+if __name__ == "__main__":
+    main()
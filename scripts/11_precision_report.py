@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""
+11_precision_report.py
+Report bits of CKKS precision per step for the configured encryption parameters
+
+Runs the squared distance, PolySoftmin and HomoNorm circuits with precision
+tracking on: each intermediate is decrypted and compared with a plaintext
+shadow. Use it to check that a smaller scale_power or a shorter
+coeff_modulus_bits chain still keeps enough bits before benchmarking it.
+"""
+import sys
+import json
+from pathlib import Path
+
+import numpy as np
+
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src.python.data_generator import load_config, generate_synthetic_embeddings
+from src.python.ckks_wrapper import HEContext, pprag_core
+
+
+def main():
+    print("="*60)
+    print("PP-RAG HE Benchmark - CKKS Precision Report")
+    print("="*60)
+
+    config = load_config("./config/config.yaml")
+    precision_config = config.get('precision', {})
+    index_config = config.get('index', {})
+    dim = config['dataset']['dimension']
+    num_samples = precision_config.get('num_samples', 20)
+
+    he_ctx = HEContext(config)
+    ctx = he_ctx.ctx
+    ctx.set_precision_tracking(True)
+
+    vectors = generate_synthetic_embeddings(2 * num_samples, dim).astype(np.float64)
+    softmin = pprag_core.PolySoftmin(index_config.get('softmin_degree', 4),
+                                     index_config.get('softmin_temperature', 1.0))
+    homo_norm = pprag_core.HomoNorm(precision_config.get('homo_norm_iterations', 3))
+
+    skipped = {}
+    for a, b in zip(vectors[:num_samples], vectors[num_samples:]):
+        ca, cb = he_ctx.encrypt(a), he_ctx.encrypt(b)
+        dist = ctx.he_l2_distance_squared(ca, cb)
+        # Circuits deeper than the chain fail; report which and why instead of stopping
+        for name, run in (('softmin', lambda: softmin.poly_eval_encrypted(dist, ctx)),
+                          ('homo_norm', lambda: homo_norm.normalize_encrypted(ca, ctx))):
+            if name in skipped:
+                continue
+            try:
+                run()
+            except ValueError as e:
+                skipped[name] = str(e)
+
+    report = ctx.precision_report()
+    ctx.set_precision_tracking(False)
+
+    enc_config = config.get('encryption', {})
+    print(f"\nscale_power={enc_config.get('scale_power', 40)} "
+          f"coeff_modulus_bits={enc_config.get('coeff_modulus_bits', [60, 40, 40, 60])}")
+    print(f"{'step':24s} {'count':>6s} {'min bits':>9s} {'mean bits':>10s} {'max abs err':>12s}")
+    for op, s in sorted(report.items()):
+        print(f"{op:24s} {s.count:6d} {s.min_bits:9.1f} {s.mean_bits:10.1f} {s.max_abs_error:12.3e}")
+    for name, reason in skipped.items():
+        print(f"{name}: skipped ({reason})")
+
+    out = Path("./results/precision_report.json")
+    out.parent.mkdir(parents=True, exist_ok=True)
+    with open(out, 'w', encoding='utf-8') as f:
+        json.dump({
+            'encryption': enc_config,
+            'steps': {op: {'count': s.count, 'min_bits': s.min_bits, 'mean_bits': s.mean_bits,
+                           'max_abs_error': s.max_abs_error} for op, s in report.items()},
+            'skipped': skipped,
+        }, f, indent=2)
+    print(f"\nResults saved to {out}")
+
+
+if __name__ == "__main__":
+    main()
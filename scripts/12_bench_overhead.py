@@ -0,0 +1,37 @@
+#!/usr/bin/env python3
+"""
+12_bench_overhead.py
+HE overhead ratios: encrypted vs. plaintext HNSW on the same graph
+
+PlainHNSW (float vectors, SIMD distances) builds the graph with the index
+parameters from config.yaml; the encrypted index adopts that graph, so the
+latency ratio measures the cost of CKKS alone and the same-graph recall
+shows how much CKKS error changes the results.
+"""
+import sys
+import json
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src.python.bench_runner import BenchmarkRunner
+
+
+def main():
+    print("="*60)
+    print("PP-RAG HE Benchmark - HE Overhead vs. Plaintext")
+    print("="*60)
+
+    runner = BenchmarkRunner("./config/config.yaml")
+    vectors = runner.load_data()
+    results = runner.benchmark_plain_baseline(vectors)
+
+    out = Path("./results/overhead_ratios.json")
+    out.parent.mkdir(parents=True, exist_ok=True)
+    with open(out, 'w', encoding='utf-8') as f:
+        json.dump([r.to_dict() for r in results], f, indent=2)
+    print(f"\nResults saved to {out}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""
+13_ingest_npy.py
+Streaming ingestion: memory-mapped .npy -> encrypted HNSW index
+
+Rows go read -> encode -> encrypt -> insert through the native pipeline with
+the stage worker counts of index.ingest, so the dataset is never loaded into
+Python. Reports throughput, per-stage busy time and the peak RSS of the run.
+
+Usage: 13_ingest_npy.py [path.npy] [num_rows]
+"""
+import sys
+import json
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src.python.bench_runner import BenchmarkRunner, _reset_peak_rss
+from src.python.ckks_wrapper import pprag_core
+
+
+def main():
+    print("="*60)
+    print("PP-RAG HE Benchmark - Streaming .npy Ingestion")
+    print("="*60)
+
+    runner = BenchmarkRunner("./config/config.yaml")
+    path = sys.argv[1] if len(sys.argv) > 1 else runner.config['dataset']['output_path']
+    rows, dim = pprag_core.npy_shape(path)
+    end = min(int(sys.argv[2]), rows) if len(sys.argv) > 2 else rows
+    print(f"[Ingest] {path}: {rows} x {dim}, ingesting rows [0, {end})")
+
+    per_phase = _reset_peak_rss()
+    pprag_core.reset_latency_histograms()
+    stats = runner.hnsw.ingest_npy(path, end=end)
+    runner.record_memory('ingest', per_phase)
+
+    busy = stats['busy_seconds']
+    for stage in ('read', 'encode', 'encrypt', 'insert'):
+        workers = stats['workers'][stage]
+        # Share of the stage's thread time spent working rather than waiting on a queue
+        utilization = busy[stage] / (workers * stats['seconds']) if stats['seconds'] > 0 else 0.0
+        print(f"      {stage:>7}: {workers:2d} workers, busy {busy[stage]:8.2f}s, utilization {utilization:6.1%}")
+    print(f"      merge: {stats['merge_seconds']:.2f}s")
+
+    report = {k: v for k, v in stats.items() if k != 'ids'}
+    report['latency'] = runner.latency_details('encode', 'encrypt', 'insert')
+    report['memory'] = runner.results.memory['ingest']
+    out = Path("./results/ingest.json")
+    out.parent.mkdir(parents=True, exist_ok=True)
+    with open(out, 'w', encoding='utf-8') as f:
+        json.dump(report, f, indent=2)
+    print(f"\nResults saved to {out}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+"""
+14_bench_load.py
+Retrieval latency under load: open-loop Poisson arrivals per target QPS
+
+Builds the index on the benchmark sample, then offers each rate of
+benchmark.load for duration_s and records the latency distribution from
+arrival to completion. The saturation throughput is the highest rate served
+with p99 inside latency_slo_ms; use it for capacity planning rather than the
+closed-loop averages of 03_bench_retrieve.py.
+"""
+import sys
+import json
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src.python.bench_runner import BenchmarkRunner
+
+
+def main():
+    print("="*60)
+    print("PP-RAG HE Benchmark - Open-Loop Retrieval Load")
+    print("="*60)
+
+    runner = BenchmarkRunner("./config/config.yaml")
+    vectors = runner.load_data()
+    runner.benchmark_setup(vectors)
+    results = runner.benchmark_load(vectors)
+
+    out = Path("./results/load_curve.json")
+    out.parent.mkdir(parents=True, exist_ok=True)
+    with open(out, 'w', encoding='utf-8') as f:
+        json.dump([r.to_dict() for r in results], f, indent=2)
+    print(f"\nResults saved to {out}")
+
+
+if __name__ == "__main__":
+    main()
@@ -10,7 +10,20 @@
 
 #include "seal_utils.cpp"
 #include "poly_softmin.cpp"
+#include "homo_norm.cpp"
+#include "projection.cpp"
 #include "secure_hnsw.cpp"
+#include "secure_pq.cpp"
+#include "plain_hnsw.cpp"
+#include "he_compare.cpp"
+#include "op_costs.cpp"
+#include "ingest_pipeline.cpp"
+
+// The simulator targets build this file again against sim_backend/seal/seal.h
+// under a different module name
+#ifndef PPRAG_MODULE_NAME
+#define PPRAG_MODULE_NAME pprag_core
+#endif
 
 namespace py = pybind11;
 using namespace pprag;
@@ -48,7 +61,7 @@ std::vector<std::vector<double>> numpy_to_matrix(py::array_t<double> arr) {
     return result;
 }
 
-PYBIND11_MODULE(pprag_core, m) {
+PYBIND11_MODULE(PPRAG_MODULE_NAME, m) {
     m.doc() = "PP-RAG HE Core Components (Real CKKS)";
     
     // Bind SEAL Ciphertext (Opaque handle)
@@ -57,17 +70,61 @@ PYBIND11_MODULE(pprag_core, m) {
 
     // Bind CKKSContext
     py::class_<CKKSContext>(m, "CKKSContext")
-        .def(py::init<size_t, double>(), 
+        .def(py::init<size_t, double, std::vector<int>>(), 
              py::arg("poly_modulus_degree") = 8192, 
-             py::arg("scale") = std::pow(2.0, 40))
+             py::arg("scale") = std::pow(2.0, 40),
+             py::arg("coeff_modulus_bits") = std::vector<int>{60, 40, 40, 60})
         .def("encrypt_vector", [](CKKSContext& self, py::array_t<double> vec) {
             return self.encrypt_vector(numpy_to_vector(vec));
         })
+        // Rows of a 2-D array, encrypted in parallel on the task scheduler
+        .def("encrypt_batch", [](CKKSContext& self, py::array_t<double> vectors) {
+            auto rows = numpy_to_matrix(vectors);
+            py::gil_scoped_release release;
+            return self.encrypt_batch(rows);
+        }, py::arg("vectors"))
         .def("decrypt_vector", [](CKKSContext& self, Ciphertext& ct) {
             auto vec = self.decrypt_vector(ct);
             return py::array_t<double>(vec.size(), vec.data());
         })
-        .def("slot_count", &CKKSContext::slot_count);
+        // Compressed wire format for shipping ciphertexts and keys between processes
+        .def("serialize", [](CKKSContext& self, const Ciphertext& ct) {
+            return py::bytes(self.serialize_ciphertext(ct));
+        })
+        .def("deserialize", [](CKKSContext& self, py::bytes data) {
+            return self.deserialize_ciphertext(data);
+        })
+        .def("export_keys", [](CKKSContext& self) {
+            return py::bytes(self.export_keys());
+        })
+        .def_static("import_keys", [](py::bytes blob) {
+            return CKKSContext::import_keys(blob);
+        })
+        .def("slot_count", &CKKSContext::slot_count)
+        .def("level", &CKKSContext::level)
+        .def("top_level", &CKKSContext::top_level)
+        .def("memory_usage", &CKKSContext::memory_usage)
+        .def("he_l2_distance_squared", &CKKSContext::he_l2_distance_squared,
+             py::arg("a"), py::arg("b"), py::arg("width") = 0)
+        // Precision diagnostics: decrypts intermediates, debugging only
+        .def("set_precision_tracking", &CKKSContext::set_precision_tracking, py::arg("enabled"))
+        .def("precision_tracking", &CKKSContext::precision_tracking)
+        .def("precision_report", &CKKSContext::precision_report)
+        .def("reset_precision_report", &CKKSContext::reset_precision_report);
+
+    // Bind PrecisionStats (one instrumented step of the precision report)
+    py::class_<PrecisionStats>(m, "PrecisionStats")
+        .def_readonly("count", &PrecisionStats::count)
+        .def_readonly("min_bits", &PrecisionStats::min_bits)
+        .def_readonly("mean_bits", &PrecisionStats::mean_bits)
+        .def_readonly("max_abs_error", &PrecisionStats::max_abs_error);
+
+    // Bind Metric (shared with pprag_core2)
+    py::enum_<Metric>(m, "Metric")
+        .value("L2", Metric::L2)
+        .value("IP", Metric::IP)
+        .value("COSINE", Metric::COSINE);
+    m.def("parse_metric", &parse_metric, py::arg("name"));
 
     // Bind PolySoftmin
     py::class_<PolySoftmin>(m, "PolySoftmin")
@@ -75,8 +132,136 @@ PYBIND11_MODULE(pprag_core, m) {
         .def("compute_plaintext", [](PolySoftmin& self, py::array_t<double> dists) {
             auto vec = self.compute_plaintext(numpy_to_vector(dists));
             return py::array_t<double>(vec.size(), vec.data());
+        })
+        .def("poly_eval_encrypted", &PolySoftmin::poly_eval_encrypted, py::arg("x"), py::arg("ctx"))
+        .def("memory_usage", &PolySoftmin::memory_usage);
+
+    // Bind SecureKMeans (memory sizing; fit_plaintext is driven through SecurePQIndex)
+    py::class_<SecureKMeans>(m, "SecureKMeans")
+        .def(py::init<int, int, double, int, bool>(),
+             py::arg("n_clusters") = 100, py::arg("max_iter") = 10, py::arg("temperature") = 1.0,
+             py::arg("softmin_degree") = 4, py::arg("normalize_centroids") = true)
+        .def("memory_usage", &SecureKMeans::memory_usage, py::arg("n") = 0, py::arg("dim") = 0);
+
+    // Bind Projection (client-side dimensionality reduction for traversal vectors)
+    py::class_<Projection>(m, "Projection")
+        .def(py::init([](py::array_t<double> matrix) { return Projection(numpy_to_matrix(matrix)); }),
+             py::arg("matrix"))
+        .def_static("random_orthogonal", &Projection::random_orthogonal,
+                    py::arg("in_dim"), py::arg("out_dim"), py::arg("seed") = 0)
+        .def_static("pca", [](py::array_t<double> data, int out_dim, int iterations, uint64_t seed) {
+            auto rows = numpy_to_matrix(data);
+            py::gil_scoped_release release;
+            return Projection::pca(rows, out_dim, iterations, seed);
+        }, py::arg("data"), py::arg("out_dim"), py::arg("iterations") = 30, py::arg("seed") = 0)
+        .def("apply", [](const Projection& self, py::array_t<double> vec) {
+            auto out = self.apply(numpy_to_vector(vec));
+            return py::array_t<double>(out.size(), out.data());
+        })
+        .def("apply_batch", [](const Projection& self, py::array_t<double> vectors) {
+            auto out = self.apply_batch(numpy_to_matrix(vectors));
+            py::array_t<double> result({out.size(), static_cast<size_t>(self.out_dim())});
+            auto view = result.mutable_unchecked<2>();
+            for (size_t i = 0; i < out.size(); ++i) {
+                for (size_t j = 0; j < out[i].size(); ++j) view(i, j) = out[i][j];
+            }
+            return result;
+        })
+        .def("matrix", [](const Projection& self) {
+            const auto& rows = self.matrix();
+            py::array_t<double> result({rows.size(), static_cast<size_t>(self.in_dim())});
+            auto view = result.mutable_unchecked<2>();
+            for (size_t i = 0; i < rows.size(); ++i) {
+                for (size_t j = 0; j < rows[i].size(); ++j) view(i, j) = rows[i][j];
+            }
+            return result;
+        })
+        .def("in_dim", &Projection::in_dim)
+        .def("out_dim", &Projection::out_dim);
+
+    // Bind HomoNorm (encrypted normalization needs depth() levels)
+    py::class_<HomoNorm>(m, "HomoNorm")
+        .def(py::init<int, double>(), py::arg("iterations") = 3, py::arg("initial_guess") = 1.0)
+        .def("depth", &HomoNorm::depth)
+        .def("normalize_plaintext", [](HomoNorm& self, py::array_t<double> vec) {
+            auto out = self.normalize_plaintext(numpy_to_vector(vec));
+            return py::array_t<double>(out.size(), out.data());
+        })
+        .def("normalize_encrypted", &HomoNorm::normalize_encrypted, py::arg("vec"), py::arg("ctx"));
+
+    // Bind HECompare (encrypted approximate comparison over packed distances)
+    py::class_<HECompare>(m, "HECompare")
+        .def(py::init<CKKSContext&, int, double, double>(),
+             py::arg("ctx"),
+             py::arg("block_size"),
+             py::arg("distance_bound") = 4.0,
+             py::arg("min_gap") = 0.05,
+             py::keep_alive<1, 2>())
+        .def("block_size", &HECompare::block_size)
+        .def("rank_depth", &HECompare::rank_depth)
+        .def("select_depth", &HECompare::select_depth)
+        .def("min_depth", &HECompare::min_depth)
+        .def("pack", &HECompare::pack)
+        .def("rank", &HECompare::rank)
+        .def("topk_mask", &HECompare::topk_mask, py::arg("packed"), py::arg("k"))
+        .def("argmin_mask", &HECompare::argmin_mask)
+        .def("min", &HECompare::min)
+        .def("sign_plaintext", [](HECompare& self, double x) {
+            return self.rank_plan().eval_plaintext(x);
         });
 
+    // Bind QueryHandle (per-query preprocessing reused across searches)
+    py::class_<QueryHandle>(m, "QueryHandle")
+        .def("ciphertext", &QueryHandle::ciphertext)
+        .def("level", &QueryHandle::level);
+
+    // Bind HNSWGraph (graph structure shared by the encrypted and plaintext indexes)
+    py::class_<HNSWGraph>(m, "HNSWGraph")
+        .def(py::init<>())
+        .def_readonly("entry", &HNSWGraph::entry)
+        .def_readonly("max_level", &HNSWGraph::max_level)
+        .def_readonly("levels", &HNSWGraph::levels)
+        .def_readonly("neighbors", &HNSWGraph::neighbors)
+        .def("size", &HNSWGraph::size);
+
+    // Bind PlainHNSW (plaintext baseline with the encrypted index's graph layout)
+    py::class_<PlainHNSW>(m, "PlainHNSW")
+        .def(py::init<int, int, int, int>(),
+             py::arg("dim"),
+             py::arg("M") = 16,
+             py::arg("ef_construction") = 200,
+             py::arg("ef_search") = 100)
+        .def("set_metric", &PlainHNSW::set_metric, py::arg("metric"))
+        .def("metric", &PlainHNSW::metric)
+        .def("reserve", &PlainHNSW::reserve, py::arg("n"))
+        .def("add_node", [](PlainHNSW& self, int id, py::array_t<double> vec, int level) {
+            self.add_node(id, numpy_to_vector(vec), level);
+        }, py::arg("id"), py::arg("vec"), py::arg("level"))
+        .def("insert", [](PlainHNSW& self, py::array_t<double> vec) {
+            return self.insert(numpy_to_vector(vec));
+        }, py::arg("vec"))
+        .def("build", [](PlainHNSW& self, py::array_t<double> vectors) {
+            auto rows = numpy_to_matrix(vectors);
+            py::gil_scoped_release release;
+            self.build(rows);
+        }, py::arg("vectors"))
+        .def("search", [](const PlainHNSW& self, py::array_t<double> query, int k) {
+            auto q = numpy_to_vector(query);
+            std::vector<int> results;
+            {
+                py::gil_scoped_release release;
+                results = self.search(q, k);
+            }
+            return py::array_t<int>(results.size(), results.data());
+        }, py::arg("query"), py::arg("k"))
+        .def("search_with_distances", [](const PlainHNSW& self, py::array_t<double> query, int k) {
+            return self.search_with_distances(numpy_to_vector(query), k);
+        }, py::arg("query"), py::arg("k"))
+        .def("remove", &PlainHNSW::remove, py::arg("id"))
+        .def("size", &PlainHNSW::size)
+        .def("export_graph", &PlainHNSW::export_graph)
+        .def("load_graph", &PlainHNSW::load_graph, py::arg("graph"));
+
     // Bind SecureHNSWEncrypted
     py::class_<SecureHNSWEncrypted>(m, "SecureHNSWEncrypted")
         .def(py::init<CKKSContext&, int, int, int>(),
@@ -84,9 +269,251 @@ PYBIND11_MODULE(pprag_core, m) {
              py::arg("M") = 16,
              py::arg("ef_construction") = 200,
              py::arg("ef_search") = 100)
-        .def("add_encrypted_node", &SecureHNSWEncrypted::add_encrypted_node)
+        .def("reserve", &SecureHNSWEncrypted::reserve, py::arg("n"))
+        .def("set_storage_level", &SecureHNSWEncrypted::set_storage_level, py::arg("level"))
+        .def("storage_level", &SecureHNSWEncrypted::storage_level)
+        .def("min_storage_level", &SecureHNSWEncrypted::min_storage_level)
+        .def("set_metric", &SecureHNSWEncrypted::set_metric, py::arg("metric"))
+        .def("set_dimension", &SecureHNSWEncrypted::set_dimension, py::arg("dim"))
+        .def("set_coarse_dimension", &SecureHNSWEncrypted::set_coarse_dimension, py::arg("dim"))
+        .def("metric", &SecureHNSWEncrypted::metric)
+        .def("add_encrypted_node",
+             py::overload_cast<int, const Ciphertext&, int>(&SecureHNSWEncrypted::add_encrypted_node))
+        // Writers release the GIL so Python reader threads keep searching
+        .def("insert", py::overload_cast<const Ciphertext&>(&SecureHNSWEncrypted::insert),
+             py::call_guard<py::gil_scoped_release>())
+        .def("insert", py::overload_cast<const Ciphertext&, const Ciphertext&>(&SecureHNSWEncrypted::insert),
+             py::arg("vec"), py::arg("coarse_vec"), py::call_guard<py::gil_scoped_release>())
+        // Two-stage search: coarse context drives traversal, index context reranks
+        .def("set_coarse_context", &SecureHNSWEncrypted::set_coarse_context, py::arg("coarse"),
+             py::keep_alive<1, 2>())
+        .def("two_stage", &SecureHNSWEncrypted::two_stage)
+        .def("add_coarse_vector", &SecureHNSWEncrypted::add_coarse_vector, py::arg("id"), py::arg("vec"))
+        .def("prepare_coarse_query", &SecureHNSWEncrypted::prepare_coarse_query, py::arg("coarse_query"),
+             py::keep_alive<0, 1>(), py::call_guard<py::gil_scoped_release>())
+        .def("search_two_stage", [](SecureHNSWEncrypted& self, const QueryHandle& query,
+                                    const QueryHandle& coarse_query, int k) {
+            std::vector<int> results;
+            {
+                py::gil_scoped_release release;
+                results = self.search_two_stage(query, coarse_query, k);
+            }
+            return py::array_t<int>(results.size(), results.data());
+        }, py::arg("query"), py::arg("coarse_query"), py::arg("k"))
+        .def("search_two_stage_with_distances", &SecureHNSWEncrypted::search_two_stage_with_distances,
+             py::arg("query"), py::arg("coarse_query"), py::arg("k"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("remove", &SecureHNSWEncrypted::remove, py::arg("id"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("repair", &SecureHNSWEncrypted::repair, py::arg("max_nodes") = -1,
+             py::call_guard<py::gil_scoped_release>())
+        .def("compact", &SecureHNSWEncrypted::compact,
+             py::call_guard<py::gil_scoped_release>())
+        .def("merge", &SecureHNSWEncrypted::merge,
+             py::arg("other"), py::arg("sample_fraction") = 0.1,
+             py::call_guard<py::gil_scoped_release>())
+        .def("start_maintenance", &SecureHNSWEncrypted::start_maintenance,
+             py::arg("interval_ms") = 100, py::arg("batch") = 32)
+        .def("stop_maintenance", &SecureHNSWEncrypted::stop_maintenance,
+             py::call_guard<py::gil_scoped_release>())
+        .def("export_graph", &SecureHNSWEncrypted::export_graph)
+        .def("load_graph", &SecureHNSWEncrypted::load_graph, py::arg("graph"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("size", &SecureHNSWEncrypted::size)
+        .def("num_deleted", &SecureHNSWEncrypted::num_deleted)
+        .def("pending_repairs", &SecureHNSWEncrypted::pending_repairs)
+        .def("memory_usage", &SecureHNSWEncrypted::memory_usage)
+        .def("is_deleted", &SecureHNSWEncrypted::is_deleted)
+        .def("prepare_query", &SecureHNSWEncrypted::prepare_query, py::arg("query"),
+             py::keep_alive<0, 1>(), py::call_guard<py::gil_scoped_release>())
+        .def("search", [](SecureHNSWEncrypted& self, const QueryHandle& query, int k) {
+            std::vector<int> results;
+            {
+                py::gil_scoped_release release;
+                results = self.search(query, k);
+            }
+            return py::array_t<int>(results.size(), results.data());
+        })
         .def("search", [](SecureHNSWEncrypted& self, Ciphertext& query, int k) {
-            auto results = self.search(query, k);
+            std::vector<int> results;
+            {
+                py::gil_scoped_release release;
+                results = self.search(query, k);
+            }
             return py::array_t<int>(results.size(), results.data());
-        });
+        })
+        .def("max_query_batch", &SecureHNSWEncrypted::max_query_batch, py::arg("dim"))
+        .def("search_batch", [](SecureHNSWEncrypted& self, const std::vector<QueryHandle>& queries, int k, int dim) {
+            std::vector<std::vector<int>> results;
+            {
+                py::gil_scoped_release release;
+                results = self.search_batch(queries, k, dim);
+            }
+            py::list out;
+            for (const auto& ids : results) out.append(py::array_t<int>(ids.size(), ids.data()));
+            return out;
+        }, py::arg("queries"), py::arg("k"), py::arg("dim"))
+        .def("search_parallel", [](SecureHNSWEncrypted& self, const std::vector<QueryHandle>& queries, int k) {
+            std::vector<std::vector<int>> results;
+            {
+                py::gil_scoped_release release;
+                results = self.search_parallel(queries, k);
+            }
+            py::list out;
+            for (const auto& ids : results) out.append(py::array_t<int>(ids.size(), ids.data()));
+            return out;
+        }, py::arg("queries"), py::arg("k"))
+        .def("batch_distance_counts", &SecureHNSWEncrypted::batch_distance_counts)
+        .def("reset_batch_distance_counts", &SecureHNSWEncrypted::reset_batch_distance_counts)
+        .def("search_with_distances",
+             py::overload_cast<const QueryHandle&, int>(&SecureHNSWEncrypted::search_with_distances),
+             py::arg("query"), py::arg("k"),
+             py::call_guard<py::gil_scoped_release>())
+        .def("search_with_distances",
+             py::overload_cast<const Ciphertext&, int>(&SecureHNSWEncrypted::search_with_distances),
+             py::arg("query"), py::arg("k"),
+             py::call_guard<py::gil_scoped_release>());
+
+    // Streaming ingestion of a memory-mapped .npy (see ingest_pipeline.cpp)
+    m.def("npy_shape", [](const std::string& path) {
+        NpyMatrix data(path);
+        return std::make_pair(data.rows(), data.cols());
+    }, py::arg("path"));
+    m.def("ingest_npy", [](SecureHNSWEncrypted& index, CKKSContext& ctx, const std::string& path,
+                           int read_workers, int encode_workers, int encrypt_workers, int insert_workers,
+                           size_t queue_capacity, bool normalize, size_t begin, long long end,
+                           double merge_sample_fraction) {
+        IngestOptions options;
+        options.read_workers = read_workers;
+        options.encode_workers = encode_workers;
+        options.encrypt_workers = encrypt_workers;
+        options.insert_workers = insert_workers;
+        options.queue_capacity = queue_capacity;
+        options.normalize = normalize;
+        options.begin = begin;
+        if (end >= 0) options.end = static_cast<size_t>(end);
+        options.merge_sample_fraction = merge_sample_fraction;
+        IngestStats stats;
+        {
+            py::gil_scoped_release release;
+            NpyMatrix data(path);
+            stats = IngestPipeline(ctx, index, options).run(data);
+        }
+        py::dict out;
+        out["rows"] = stats.rows;
+        out["seconds"] = stats.seconds;
+        out["merge_seconds"] = stats.merge_seconds;
+        out["rows_per_second"] = stats.seconds > 0 ? stats.rows / stats.seconds : 0.0;
+        out["workers"] = stats.workers;
+        out["busy_seconds"] = stats.busy_seconds;
+        out["ids"] = py::array_t<int>(stats.ids.size(), stats.ids.data());
+        return out;
+    }, py::arg("index"), py::arg("ctx"), py::arg("path"),
+       py::arg("read_workers") = 1, py::arg("encode_workers") = 1, py::arg("encrypt_workers") = 0,
+       py::arg("insert_workers") = 1, py::arg("queue_capacity") = 64, py::arg("normalize") = false,
+       py::arg("begin") = 0, py::arg("end") = -1, py::arg("merge_sample_fraction") = 0.1);
+
+    // Bind SecurePQIndex (plaintext PQ codes, encrypted query, packed ADC scan)
+    py::class_<SecurePQIndex>(m, "SecurePQIndex")
+        .def(py::init<CKKSContext&, int, int, int, int, double>(),
+             py::arg("ctx"), py::arg("dim"), py::arg("m") = 32, py::arg("ks") = 256,
+             py::arg("train_iters") = 10, py::arg("temperature") = 0.01,
+             py::keep_alive<1, 2>())
+        .def("train", [](SecurePQIndex& self, py::array_t<double> vectors) {
+            auto rows = numpy_to_matrix(vectors);
+            py::gil_scoped_release release;
+            self.train(rows);
+        }, py::arg("vectors"))
+        .def("trained", &SecurePQIndex::trained)
+        .def("encode", [](const SecurePQIndex& self, py::array_t<double> vectors) {
+            auto rows = numpy_to_matrix(vectors);
+            py::array_t<uint8_t> result({rows.size(), static_cast<size_t>(self.subspaces())});
+            auto view = result.mutable_unchecked<2>();
+            for (size_t i = 0; i < rows.size(); ++i) {
+                auto code = self.encode(rows[i]);
+                for (size_t j = 0; j < code.size(); ++j) view(i, j) = code[j];
+            }
+            return result;
+        }, py::arg("vectors"))
+        .def("add_codes", [](SecurePQIndex& self, py::array_t<uint8_t> codes) {
+            auto buf = codes.request();
+            if (buf.ndim != 2) throw std::invalid_argument("codes must be a 2-d uint8 array");
+            const uint8_t* ptr = static_cast<const uint8_t*>(buf.ptr);
+            std::vector<std::vector<uint8_t>> rows(buf.shape[0]);
+            for (size_t i = 0; i < rows.size(); ++i) {
+                rows[i].assign(ptr + i * buf.shape[1], ptr + (i + 1) * buf.shape[1]);
+            }
+            return self.add_codes(rows);
+        }, py::arg("codes"))
+        .def("add", [](SecurePQIndex& self, py::array_t<double> vectors) {
+            auto rows = numpy_to_matrix(vectors);
+            py::gil_scoped_release release;
+            return self.add(rows);
+        }, py::arg("vectors"))
+        .def("query_layout", [](const SecurePQIndex& self, py::array_t<double> vec) {
+            auto out = self.query_layout(numpy_to_vector(vec));
+            return py::array_t<double>(out.size(), out.data());
+        }, py::arg("query"))
+        .def("search", [](SecurePQIndex& self, const Ciphertext& query, int k, std::vector<int> candidates) {
+            std::vector<int> results;
+            {
+                py::gil_scoped_release release;
+                results = self.search(query, k, candidates);
+            }
+            return py::array_t<int>(results.size(), results.data());
+        }, py::arg("query"), py::arg("k"), py::arg("candidates") = std::vector<int>{})
+        .def("search_with_distances", &SecurePQIndex::search_with_distances,
+             py::arg("query"), py::arg("k"), py::arg("candidates") = std::vector<int>{},
+             py::call_guard<py::gil_scoped_release>())
+        .def("size", &SecurePQIndex::size)
+        .def("code_bytes", &SecurePQIndex::code_bytes)
+        .def("depth", &SecurePQIndex::depth)
+        .def("lanes", &SecurePQIndex::lanes)
+        .def("table_count", &SecurePQIndex::table_count);
+
+    // Chrome trace spans of this module (see trace.cpp)
+    m.def("set_tracing", [](bool enabled) { Tracer::instance().set_enabled(enabled); }, py::arg("enabled"));
+    m.def("tracing_enabled", []() { return Tracer::instance().enabled(); });
+    m.def("trace_event_count", []() { return Tracer::instance().event_count(); });
+    m.def("clear_trace", []() { Tracer::instance().clear(); });
+    m.def("write_chrome_trace", [](const std::string& path) { Tracer::instance().write_chrome_trace(path); },
+          py::arg("path"));
+
+    // Per-operation latency histograms of this module (see latency_histogram.cpp):
+    // op -> {count, min_ms, mean_ms, max_ms, p50_ms, p90_ms, p99_ms, p999_ms}
+    m.def("latency_histograms", []() {
+        std::map<std::string, std::map<std::string, double>> out;
+        for (const auto& [op, s] : LatencyRegistry::instance().summaries()) {
+            out[op] = {{"count", static_cast<double>(s.count)}, {"min_ms", s.min_ms}, {"mean_ms", s.mean_ms},
+                       {"max_ms", s.max_ms}, {"p50_ms", s.p50_ms}, {"p90_ms", s.p90_ms},
+                       {"p99_ms", s.p99_ms}, {"p999_ms", s.p999_ms}};
+        }
+        return out;
+    });
+    m.def("latency_percentile", [](const std::string& op, double q) {
+        return static_cast<double>(LatencyRegistry::instance().histogram(op).percentile(q)) / 1e6;
+    }, py::arg("op"), py::arg("q"));
+    m.def("reset_latency_histograms", []() { LatencyRegistry::instance().reset(); });
+
+    // Task scheduler shared by all native parallel work of this module (see thread_pool.cpp)
+    m.def("set_thread_pool", [](int threads, bool pin_threads) {
+        TaskScheduler::instance().configure(threads, pin_threads);
+    }, py::arg("threads") = 0, py::arg("pin_threads") = false, py::call_guard<py::gil_scoped_release>());
+    m.def("thread_pool_info", []() {
+        auto& pool = TaskScheduler::instance();
+        return std::map<std::string, double>{{"threads", static_cast<double>(pool.size())},
+                                             {"pinned", pool.pinned() ? 1.0 : 0.0},
+                                             {"tasks_executed", static_cast<double>(pool.executed())},
+                                             {"tasks_stolen", static_cast<double>(pool.stolen())}};
+    });
+
+#ifdef PPRAG_SIM_BACKEND
+    // Op accounting of the simulator backend: op name -> chain index -> calls
+    m.def("sim_op_counts", &seal::sim::op_counts);
+    m.def("reset_sim_op_counts", &seal::sim::reset_op_counts);
+#else
+    // Calibration only means something against real SEAL
+    m.def("measure_op_costs", &measure_op_costs, py::arg("ctx"), py::arg("reps") = 20,
+          py::call_guard<py::gil_scoped_release>());
+#endif
 }
@@ -14,6 +14,12 @@
 #include "secure_hnsw.cpp"
 #include "secure_hnsw2.cpp"
 
+// The simulator targets build this file again against sim_backend/seal/seal.h
+// under a different module name
+#ifndef PPRAG_MODULE_NAME
+#define PPRAG_MODULE_NAME pprag_core2
+#endif
+
 namespace py = pybind11;
 using namespace pprag;
 
@@ -50,7 +56,7 @@ std::vector<std::vector<double>> numpy_to_matrix(py::array_t<double> arr) {
     return result;
 }
 
-PYBIND11_MODULE(pprag_core2, m) {
+PYBIND11_MODULE(PPRAG_MODULE_NAME, m) {
     m.doc() = "PP-RAG HE Core Components - Variant 2 (Real CKKS with Client-Aided Decryption)";
     
     // Note: We don't redefine Ciphertext to avoid conflicts with pprag_core
@@ -64,11 +70,80 @@ PYBIND11_MODULE(pprag_core2, m) {
              py::arg("M") = 16,
              py::arg("ef_construction") = 200,
              py::arg("ef_search") = 100)
-        .def("add_encrypted_node", &SecureHNSWEncrypted2::add_encrypted_node)
+        .def("reserve", &SecureHNSWEncrypted2::reserve, py::arg("n"))
+        .def("set_storage_level", &SecureHNSWEncrypted2::set_storage_level, py::arg("level"))
+        .def("storage_level", &SecureHNSWEncrypted2::storage_level)
+        .def("min_storage_level", &SecureHNSWEncrypted2::min_storage_level)
+        .def("set_metric", &SecureHNSWEncrypted2::set_metric, py::arg("metric"))
+        .def("metric", &SecureHNSWEncrypted2::metric)
+        .def("add_encrypted_node",
+             py::overload_cast<int, const Ciphertext&, int>(&SecureHNSWEncrypted2::add_encrypted_node))
+        .def("insert", &SecureHNSWEncrypted2::insert)
+        .def("set_beam_width", &SecureHNSWEncrypted2::set_beam_width, py::arg("w"))
+        .def("beam_width", &SecureHNSWEncrypted2::beam_width)
         .def("search", [](SecureHNSWEncrypted2& self, Ciphertext& query, int k) {
             auto results = self.search(query, k);
             return py::array_t<int>(results.size(), results.data());
         })
+        .def("search_from", [](SecureHNSWEncrypted2& self, Ciphertext& query, int entry, int k) {
+            auto results = self.search_from(query, entry, k);
+            return py::array_t<int>(results.size(), results.data());
+        }, py::arg("query"), py::arg("entry"), py::arg("k"))
+        .def("entry_point", &SecureHNSWEncrypted2::entry_point)
+        .def("max_level", &SecureHNSWEncrypted2::max_level)
+        .def("node_level", &SecureHNSWEncrypted2::node_level)
+        .def("upper_layer_nodes", &SecureHNSWEncrypted2::upper_layer_nodes)
+        .def("get_neighbors", &SecureHNSWEncrypted2::get_neighbors, py::arg("id"), py::arg("level"))
+        .def("search_block_topk", &SecureHNSWEncrypted2::search_block_topk,
+             py::arg("query"), py::arg("candidate_ids"), py::arg("k"),
+             py::arg("distance_bound") = 4.0, py::arg("min_gap") = 0.2)
+        .def("search_block_client", &SecureHNSWEncrypted2::search_block_client,
+             py::arg("query"), py::arg("candidate_ids"), py::arg("k"))
         .def("get_communication_bytes", &SecureHNSWEncrypted2::get_communication_bytes)
+        .def("memory_usage", &SecureHNSWEncrypted2::memory_usage)
+        .def("get_rounds", &SecureHNSWEncrypted2::get_rounds)
+        .def("get_distance_evaluations", &SecureHNSWEncrypted2::get_distance_evaluations)
         .def("reset_communication_counter", &SecureHNSWEncrypted2::reset_communication_counter);
+
+    // Chrome trace spans of this module (see trace.cpp)
+    m.def("set_tracing", [](bool enabled) { Tracer::instance().set_enabled(enabled); }, py::arg("enabled"));
+    m.def("tracing_enabled", []() { return Tracer::instance().enabled(); });
+    m.def("trace_event_count", []() { return Tracer::instance().event_count(); });
+    m.def("clear_trace", []() { Tracer::instance().clear(); });
+    m.def("write_chrome_trace", [](const std::string& path) { Tracer::instance().write_chrome_trace(path); },
+          py::arg("path"));
+
+    // Per-operation latency histograms of this module (see latency_histogram.cpp):
+    // op -> {count, min_ms, mean_ms, max_ms, p50_ms, p90_ms, p99_ms, p999_ms}
+    m.def("latency_histograms", []() {
+        std::map<std::string, std::map<std::string, double>> out;
+        for (const auto& [op, s] : LatencyRegistry::instance().summaries()) {
+            out[op] = {{"count", static_cast<double>(s.count)}, {"min_ms", s.min_ms}, {"mean_ms", s.mean_ms},
+                       {"max_ms", s.max_ms}, {"p50_ms", s.p50_ms}, {"p90_ms", s.p90_ms},
+                       {"p99_ms", s.p99_ms}, {"p999_ms", s.p999_ms}};
+        }
+        return out;
+    });
+    m.def("latency_percentile", [](const std::string& op, double q) {
+        return static_cast<double>(LatencyRegistry::instance().histogram(op).percentile(q)) / 1e6;
+    }, py::arg("op"), py::arg("q"));
+    m.def("reset_latency_histograms", []() { LatencyRegistry::instance().reset(); });
+
+    // Task scheduler shared by all native parallel work of this module (see thread_pool.cpp)
+    m.def("set_thread_pool", [](int threads, bool pin_threads) {
+        TaskScheduler::instance().configure(threads, pin_threads);
+    }, py::arg("threads") = 0, py::arg("pin_threads") = false, py::call_guard<py::gil_scoped_release>());
+    m.def("thread_pool_info", []() {
+        auto& pool = TaskScheduler::instance();
+        return std::map<std::string, double>{{"threads", static_cast<double>(pool.size())},
+                                             {"pinned", pool.pinned() ? 1.0 : 0.0},
+                                             {"tasks_executed", static_cast<double>(pool.executed())},
+                                             {"tasks_stolen", static_cast<double>(pool.stolen())}};
+    });
+
+#ifdef PPRAG_SIM_BACKEND
+    // Op accounting of the simulator backend: op name -> chain index -> calls
+    m.def("sim_op_counts", &seal::sim::op_counts);
+    m.def("reset_sim_op_counts", &seal::sim::reset_op_counts);
+#endif
 }
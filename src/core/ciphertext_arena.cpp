@@ -0,0 +1,179 @@
+/**
+ * ciphertext_arena.cpp
+ * Chunked, stable-address storage for encrypted node vectors
+ *
+ * Ciphertexts are kept in fixed-size chunks that are never relocated, so
+ * growing the index never moves or copies already stored vectors and a
+ * reference to a stored ciphertext stays valid for the arena's lifetime.
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "seal_utils.cpp"
+
+namespace pprag {
+
+/**
+ * Chunked array with a fixed-size chunk directory
+ *
+ * The directory is allocated once, so a single writer can append chunks
+ * while readers index already published elements without any locking.
+ */
+template <typename T>
+class StableChunks {
+public:
+    static constexpr size_t CHUNK_BITS = 10;
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS; // 1024 elements per chunk
+    static constexpr size_t MAX_CHUNKS = size_t(1) << 16;         // 64M elements
+
+    StableChunks() : dir_(new std::atomic<T*>[MAX_CHUNKS]), num_chunks_(0) {
+        for (size_t i = 0; i < MAX_CHUNKS; ++i) dir_[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~StableChunks() {
+        for (size_t i = 0; i < num_chunks_; ++i) delete[] dir_[i].load(std::memory_order_relaxed);
+    }
+
+    StableChunks(const StableChunks&) = delete;
+    StableChunks& operator=(const StableChunks&) = delete;
+
+    /**
+     * Allocate chunks covering indices [0, n); init runs once per new element
+     */
+    template <typename Init>
+    void reserve(size_t n, Init init) {
+        size_t needed = (n + CHUNK_SIZE - 1) >> CHUNK_BITS;
+        if (needed > MAX_CHUNKS) {
+            throw std::length_error("StableChunks: capacity exceeds " + std::to_string(MAX_CHUNKS * CHUNK_SIZE));
+        }
+        while (num_chunks_ < needed) {
+            T* chunk = new T[CHUNK_SIZE];
+            for (size_t i = 0; i < CHUNK_SIZE; ++i) init(chunk[i]);
+            dir_[num_chunks_].store(chunk, std::memory_order_release);
+            ++num_chunks_;
+        }
+    }
+
+    void reserve(size_t n) {
+        reserve(n, [](T&) {});
+    }
+
+    T& operator[](size_t i) const {
+        return dir_[i >> CHUNK_BITS].load(std::memory_order_acquire)[i & (CHUNK_SIZE - 1)];
+    }
+
+    size_t capacity() const { return num_chunks_ * CHUNK_SIZE; }
+
+    // Chunk directory plus allocated element slots (not memory the elements own)
+    size_t footprint_bytes() const {
+        return MAX_CHUNKS * sizeof(std::atomic<T*>) + capacity() * sizeof(T);
+    }
+
+private:
+    std::unique_ptr<std::atomic<T*>[]> dir_;
+    size_t num_chunks_;
+};
+
+#ifdef USE_SEAL
+
+/**
+ * Chunked ciphertext arena indexed by node ID
+ *
+ * Polynomial data of copied-in ciphertexts is allocated from a dedicated
+ * SEAL memory pool. The pool carves same-sized allocations out of large
+ * contiguous blocks, so 100k+ node vectors do not fragment the global heap.
+ * Moved-in ciphertexts keep their existing buffer (no allocation, no copy).
+ */
+class CiphertextArena {
+public:
+    explicit CiphertextArena(MemoryPoolHandle pool = MemoryManager::GetPool(mm_prof_opt::mm_force_new))
+        : pool_(std::move(pool)), size_(0) {}
+
+    /**
+     * Pre-allocate chunks so that IDs [0, n) can be stored without growing
+     */
+    void reserve(size_t n) {
+        chunks_.reserve(n, [this](Ciphertext& slot) { slot = Ciphertext(pool_); });
+    }
+
+    /**
+     * Store a copy of ct at id (polynomial data lands in the arena pool)
+     */
+    Ciphertext& put(size_t id, const Ciphertext& ct) {
+        Ciphertext& slot = grow_to(id);
+        slot = ct;
+        return slot;
+    }
+
+    /**
+     * Move ct into id, adopting its buffer
+     */
+    Ciphertext& put(size_t id, Ciphertext&& ct) {
+        Ciphertext& slot = grow_to(id);
+        slot = std::move(ct);
+        return slot;
+    }
+
+    /**
+     * Reallocate the ciphertext at id from the pool at its current size.
+     * SEAL switches modulus in place without shrinking the buffer, so a
+     * ciphertext switched down after being stored keeps its top-level
+     * allocation until it is refitted.
+     */
+    void shrink_to_fit(size_t id) {
+        Ciphertext& slot = (*this)[id];
+        Ciphertext fitted(pool_);
+        fitted = slot;
+        slot = std::move(fitted);
+    }
+
+    /**
+     * Count IDs [0, n) as stored; slots nothing was put into stay empty
+     */
+    void resize(size_t n) {
+        if (n > size_) grow_to(n - 1);
+    }
+
+    /**
+     * Drop the ciphertext at id, returning its buffer to the pool
+     */
+    void release(size_t id) {
+        (*this)[id] = Ciphertext(pool_);
+    }
+
+    Ciphertext& operator[](size_t id) { return chunks_[id]; }
+
+    const Ciphertext& operator[](size_t id) const { return chunks_[id]; }
+
+    // One past the highest ID stored so far
+    size_t size() const { return size_; }
+
+    size_t capacity() const { return chunks_.capacity(); }
+
+    // Slot bookkeeping only; stored polynomial data is counted with ciphertext_bytes()
+    size_t footprint_bytes() const { return chunks_.footprint_bytes(); }
+
+private:
+    Ciphertext& grow_to(size_t id) {
+        if (id >= capacity()) {
+            // Chunks never move, so growing only appends to the directory
+            reserve(std::max(id + 1, capacity() * 2));
+        }
+        if (id >= size_) size_ = id + 1;
+        return (*this)[id];
+    }
+
+    MemoryPoolHandle pool_;
+    StableChunks<Ciphertext> chunks_;
+    size_t size_;
+};
+
+#endif  // USE_SEAL
+
+} // namespace pprag
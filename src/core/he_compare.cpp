@@ -0,0 +1,342 @@
+/**
+ * he_compare.cpp
+ * Encrypted approximate comparison
+ *
+ * sign(x) on [-1, 1] is approximated by composing two odd cubics:
+ *   g(x) = (2126 x - 1359 x^3) / 1024   grows small inputs quickly
+ *   f(x) = (3 x - x^3) / 2              converges to +-1 quadratically
+ * Each composition step costs two levels. On top of the sign function the
+ * server can rank a slot-packed block of encrypted distances and reduce it
+ * to an encrypted top-k / argmin mask or to the minimum itself, without
+ * decrypting anything.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "seal_utils.cpp"
+
+namespace pprag {
+
+/**
+ * Composite polynomial plan for one comparison
+ */
+struct SignPlan {
+    int g_iters = 0;
+    int f_iters = 0;
+    double input_bound = 1.0; // inputs lie in [-input_bound, input_bound]
+
+    static constexpr double G_A = 2126.0 / 1024.0, G_B = -1359.0 / 1024.0;
+    static constexpr double F_A = 1.5, F_B = -0.5;
+    static constexpr int MAX_ITERS = 24;
+
+    // Levels consumed by sign()
+    int depth() const { return 2 * (g_iters + f_iters); }
+
+    /**
+     * Fewest compositions such that every |x| >= min_gap ends up within
+     * 2^-precision_bits of sign(x)
+     */
+    static SignPlan make(double input_bound, double min_gap, int precision_bits) {
+        if (min_gap <= 0.0 || min_gap >= input_bound) {
+            throw std::invalid_argument("SignPlan: min_gap must be in (0, input_bound)");
+        }
+        double eps = min_gap / input_bound;
+        double tol = std::ldexp(1.0, -precision_bits);
+
+        // Log-spaced probe points over [eps, 1]
+        std::vector<double> probes;
+        for (int i = 0; i <= 128; ++i) {
+            probes.push_back(std::exp(std::log(eps) * (1.0 - i / 128.0)));
+        }
+
+        SignPlan best;
+        int best_total = -1;
+        for (int g = 0; g <= MAX_ITERS; ++g) {
+            for (int f = (g == 0 ? 1 : 0); g + f <= MAX_ITERS; ++f) {
+                if (best_total >= 0 && g + f >= best_total) break;
+                SignPlan plan{g, f, 1.0};
+                bool ok = std::all_of(probes.begin(), probes.end(), [&](double x) {
+                    return std::abs(1.0 - plan.eval_plaintext(x)) <= tol;
+                });
+                if (ok) {
+                    best = plan;
+                    best_total = g + f;
+                    break;
+                }
+            }
+        }
+        if (best_total < 0) {
+            throw std::invalid_argument("SignPlan: no composite polynomial within " +
+                                        std::to_string(MAX_ITERS) + " iterations for this gap");
+        }
+        best.input_bound = input_bound;
+        return best;
+    }
+
+    /**
+     * Plaintext version (for validation and planning)
+     */
+    double eval_plaintext(double x) const {
+        x /= input_bound;
+        for (int i = 0; i < g_iters; ++i) x = G_A * x + G_B * x * x * x;
+        for (int i = 0; i < f_iters; ++i) x = F_A * x + F_B * x * x * x;
+        return x;
+    }
+};
+
+#ifdef USE_SEAL
+
+/**
+ * Server-side selection over a packed block of encrypted distances
+ *
+ * pack() puts distance i into every slot j with j % block_size == i, so the
+ * slot vector is periodic and any rotation acts cyclically on the block.
+ * rank() compares the block against all of its rotations (constant depth,
+ * block_size - 1 sign evaluations) instead of a log-depth tournament of
+ * sequential comparisons, which would not fit a leveled modulus chain.
+ */
+class HECompare {
+public:
+    /**
+     * block_size:     distances per block (rounded up to a power of two)
+     * distance_bound: upper bound on any distance in the block
+     * min_gap:        distances closer than this may be ordered either way
+     */
+    HECompare(CKKSContext& ctx, int block_size, double distance_bound = 4.0, double min_gap = 0.05)
+        : ctx_(ctx), distance_bound_(distance_bound) {
+        block_ = 2;
+        while (block_ < block_size) block_ *= 2;
+        if (static_cast<size_t>(block_) > ctx_.slot_count()) {
+            throw std::invalid_argument("HECompare: block size exceeds slot count");
+        }
+        // Rank sums block_-1 step outputs; keep their total error well below 0.5
+        int rank_bits = static_cast<int>(std::ceil(std::log2(block_))) + 2;
+        rank_plan_ = SignPlan::make(distance_bound, min_gap, rank_bits);
+        // Threshold halfway between integer ranks, minus the rank error; a coarse result suffices
+        double rank_error = (block_ - 1) * std::ldexp(1.0, -rank_bits);
+        select_plan_ = SignPlan::make(block_, 0.5 - rank_error, 3);
+    }
+
+    int block_size() const { return block_; }
+
+    // ==================== Depth planning ====================
+
+    // Levels needed on an encrypted distance for each operation (pack included)
+    int rank_depth() const { return 1 + rank_plan_.depth(); }
+    int select_depth() const { return rank_depth() + select_plan_.depth(); }
+    int min_depth() const { return select_depth() + 1; }
+
+    const SignPlan& rank_plan() const { return rank_plan_; }
+    const SignPlan& select_plan() const { return select_plan_; }
+
+    /**
+     * Throw if ct does not have enough levels left for an operation
+     */
+    void check_depth(const Ciphertext& ct, int needed, const char* op) const {
+        int available = static_cast<int>(ctx_.level(ct));
+        if (available < needed) {
+            throw std::invalid_argument(
+                std::string("HECompare::") + op + ": needs " + std::to_string(needed) +
+                " levels, ciphertext has " + std::to_string(available) +
+                "; use a longer coeff_modulus chain or a larger min_gap");
+        }
+    }
+
+    // ==================== Block operations ====================
+
+    /**
+     * Pack distances (value replicated in every slot, as returned by
+     * he_l2_distance_squared) into one periodic block. Unused block
+     * positions hold distance_bound so they never rank among the top.
+     */
+    Ciphertext pack(const std::vector<Ciphertext>& distances) {
+        if (distances.empty() || static_cast<int>(distances.size()) > block_) {
+            throw std::invalid_argument("HECompare::pack: expected 1.." + std::to_string(block_) + " distances");
+        }
+        check_depth(distances[0], rank_depth(), "pack");
+        auto ev = ctx_.evaluator();
+        size_t slots = ctx_.slot_count();
+
+        Ciphertext packed;
+        for (size_t i = 0; i < distances.size(); ++i) {
+            std::vector<double> onehot(slots, 0.0);
+            for (size_t j = i; j < slots; j += block_) onehot[j] = 1.0;
+            Plaintext mask;
+            ctx_.encoder()->encode(onehot, distances[i].parms_id(), distances[i].scale(), mask);
+
+            Ciphertext term;
+            ev->multiply_plain(distances[i], mask, term);
+            if (i == 0) {
+                packed = term;
+            } else {
+                ev->add_inplace(packed, term);
+            }
+        }
+        ev->rescale_to_next_inplace(packed);
+
+        if (static_cast<int>(distances.size()) < block_) {
+            std::vector<double> pad(slots, 0.0);
+            for (size_t j = 0; j < slots; ++j) {
+                if (static_cast<int>(j % block_) >= static_cast<int>(distances.size())) pad[j] = distance_bound_;
+            }
+            Plaintext p;
+            ctx_.encoder()->encode(pad, packed.parms_id(), packed.scale(), p);
+            ev->add_plain_inplace(packed, p);
+        }
+        return packed;
+    }
+
+    /**
+     * Slot i: number of block entries smaller than entry i (approximately integer)
+     */
+    Ciphertext rank(const Ciphertext& packed) {
+        check_depth(packed, rank_plan_.depth(), "rank");
+        Ciphertext total;
+        for (int s = 1; s < block_; ++s) {
+            // d_i - d_{i+s}; step() is ~1 where the rotated entry is smaller
+            Ciphertext diff = ctx_.he_subtract(packed, ctx_.he_rotate(packed, s));
+            Ciphertext st = step(diff, rank_plan_);
+            if (s == 1) {
+                total = st;
+            } else {
+                ctx_.evaluator()->add_inplace(total, st);
+            }
+        }
+        return total;
+    }
+
+    /**
+     * Slot i: ~1 if entry i is among the k smallest, ~0 otherwise
+     */
+    Ciphertext topk_mask(const Ciphertext& packed, int k) {
+        check_depth(packed, rank_plan_.depth() + select_plan_.depth(), "topk_mask");
+        Ciphertext r = rank(packed);
+
+        // (k - 0.5) - rank > 0  <=>  rank < k
+        ctx_.evaluator()->negate_inplace(r);
+        Plaintext threshold;
+        ctx_.encoder()->encode(k - 0.5, r.parms_id(), r.scale(), threshold);
+        ctx_.evaluator()->add_plain_inplace(r, threshold);
+        return step(r, select_plan_);
+    }
+
+    Ciphertext argmin_mask(const Ciphertext& packed) {
+        return topk_mask(packed, 1);
+    }
+
+    /**
+     * Minimum of the block, replicated in every slot
+     */
+    Ciphertext min(const Ciphertext& packed) {
+        check_depth(packed, rank_plan_.depth() + select_plan_.depth() + 1, "min");
+        auto ev = ctx_.evaluator();
+        Ciphertext mask = argmin_mask(packed);
+
+        Ciphertext values = packed;
+        ev->mod_switch_to_inplace(values, mask.parms_id());
+        ev->multiply_inplace(mask, values);
+        ev->relinearize_inplace(mask, ctx_.relin_keys());
+        ev->rescale_to_next_inplace(mask);
+
+        // The block is periodic, so a log-step rotate-and-sum covers it exactly
+        for (int s = 1; s < block_; s *= 2) {
+            ev->add_inplace(mask, ctx_.he_rotate(mask, s));
+        }
+        return mask;
+    }
+
+    // ==================== Sign evaluation ====================
+
+    /**
+     * Composite sign(x) for x in [-plan.input_bound, plan.input_bound];
+     * with half, returns sign(x) / 2 at no extra depth
+     */
+    Ciphertext sign(const Ciphertext& x, const SignPlan& plan, bool half = false) {
+        check_depth(x, plan.depth(), "sign");
+        int total = plan.g_iters + plan.f_iters;
+        Ciphertext y = x;
+        for (int i = 0; i < total; ++i) {
+            bool is_g = i < plan.g_iters;
+            double a = is_g ? SignPlan::G_A : SignPlan::F_A;
+            double b = is_g ? SignPlan::G_B : SignPlan::F_B;
+            if (i == 0) {
+                // Fold the input normalization into the first polynomial
+                a /= plan.input_bound;
+                b /= plan.input_bound * plan.input_bound * plan.input_bound;
+            }
+            if (half && i == total - 1) {
+                a *= 0.5;
+                b *= 0.5;
+            }
+            y = odd_cubic(y, a, b);
+        }
+        return y;
+    }
+
+    /**
+     * (1 + sign(x)) / 2: ~1 for x > 0, ~0 for x < 0
+     */
+    Ciphertext step(const Ciphertext& x, const SignPlan& plan) {
+        Ciphertext y = sign(x, plan, true);
+        Plaintext half;
+        ctx_.encoder()->encode(0.5, y.parms_id(), y.scale(), half);
+        ctx_.evaluator()->add_plain_inplace(y, half);
+        return y;
+    }
+
+private:
+    /**
+     * a*x + b*x^3 in two levels. Plaintext constants are encoded at scales
+     * that make both terms land on the same level with identical scales,
+     * so no scale is patched by hand.
+     */
+    Ciphertext odd_cubic(const Ciphertext& x, double a, double b) {
+        auto ev = ctx_.evaluator();
+
+        Ciphertext x2;
+        ev->square(x, x2);
+        ev->relinearize_inplace(x2, ctx_.relin_keys());
+        ev->rescale_to_next_inplace(x2);
+
+        Ciphertext bx3 = mul_const(x, b, x.scale());
+        ev->multiply_inplace(bx3, x2);
+        ev->relinearize_inplace(bx3, ctx_.relin_keys());
+        ev->rescale_to_next_inplace(bx3);
+
+        Ciphertext ax = x;
+        ev->mod_switch_to_next_inplace(ax);
+        ax = mul_const(ax, a, bx3.scale() * last_prime(ax) / ax.scale());
+        ev->add_inplace(bx3, ax);
+        return bx3;
+    }
+
+    Ciphertext mul_const(const Ciphertext& ct, double c, double plain_scale) {
+        Plaintext p;
+        ctx_.encoder()->encode(c, ct.parms_id(), plain_scale, p);
+        Ciphertext result;
+        ctx_.evaluator()->multiply_plain(ct, p, result);
+        ctx_.evaluator()->rescale_to_next_inplace(result);
+        return result;
+    }
+
+    // Prime dropped by the next rescale of ct
+    double last_prime(const Ciphertext& ct) {
+        auto ctx_data = ctx_.context()->get_context_data(ct.parms_id());
+        return static_cast<double>(ctx_data->parms().coeff_modulus().back().value());
+    }
+
+    CKKSContext& ctx_;
+    int block_;
+    double distance_bound_;
+    SignPlan rank_plan_;
+    SignPlan select_plan_;
+};
+
+#endif  // USE_SEAL
+
+} // namespace pprag
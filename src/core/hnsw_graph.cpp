@@ -0,0 +1,58 @@
+/**
+ * hnsw_graph.cpp
+ * Plain snapshot of an HNSW graph: node levels, per-layer adjacency, entry point
+ *
+ * Exchanged between SecureHNSWEncrypted and PlainHNSW so that both search
+ * the same graph; overhead ratios then measure the cost of HE alone, not
+ * the difference between two randomly built graphs.
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+namespace pprag {
+
+struct HNSWGraph {
+    int entry = -1;                                        // -1 = empty graph
+    int max_level = 0;
+    std::vector<int> levels;                               // per ID, -1 = unused
+    std::vector<char> deleted;                             // tombstones (traversed, never returned)
+    std::vector<std::vector<std::vector<int>>> neighbors;  // [id][layer] -> neighbor IDs
+
+    size_t size() const { return levels.size(); }
+
+    /**
+     * Throw unless every list has level + 1 layers and links only to used IDs
+     */
+    void validate() const {
+        if (deleted.size() != levels.size() || neighbors.size() != levels.size()) {
+            throw std::invalid_argument("HNSWGraph: levels, deleted and neighbors differ in size");
+        }
+        const int n = static_cast<int>(levels.size());
+        if (entry >= n || (entry >= 0 && levels[entry] != max_level)) {
+            throw std::invalid_argument("HNSWGraph: entry point is not a top-level node");
+        }
+        for (int id = 0; id < n; ++id) {
+            int layers = levels[id] + 1;
+            if (static_cast<int>(neighbors[id].size()) != layers) {
+                throw std::invalid_argument("HNSWGraph: node " + std::to_string(id) + " has " +
+                                            std::to_string(neighbors[id].size()) + " layers, expected " +
+                                            std::to_string(layers));
+            }
+            for (int l = 0; l < layers; ++l) {
+                for (int nb : neighbors[id][l]) {
+                    if (nb < 0 || nb >= n || levels[nb] < l) {
+                        throw std::invalid_argument("HNSWGraph: node " + std::to_string(id) +
+                                                    " links to " + std::to_string(nb) + " on layer " +
+                                                    std::to_string(l));
+                    }
+                }
+            }
+        }
+    }
+};
+
+} // namespace pprag
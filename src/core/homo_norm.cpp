@@ -9,6 +9,9 @@
 
 #include <vector>
 #include <cmath>
+#include <stdexcept>
+#include <string>
+#include "seal_utils.cpp"
 
 namespace pprag {
 
@@ -18,7 +21,12 @@ namespace pprag {
  */
 class HomoNorm {
 public:
-    HomoNorm(int iterations = 3) : iterations_(iterations) {}
+    /**
+     * initial_guess seeds the encrypted iteration, which cannot start from an
+     * exact 1/sqrt(x): it converges for squared norms in (0, 3 / initial_guess^2)
+     */
+    HomoNorm(int iterations = 3, double initial_guess = 1.0)
+        : iterations_(iterations), initial_guess_(initial_guess) {}
     
     /**
      * Goldschmidt iteration for 1/sqrt(x)
@@ -59,22 +67,89 @@ public:
     }
     
     /**
-     * HE version normalization framework
-     * A real implementation would require:
-     * 1. Homomorphic inner product (sum of squares)
-     * 2. Homomorphic Goldschmidt iteration
-     * 3. Homomorphic vector-scalar multiplication
+     * Levels consumed by normalize_encrypted: inner product, the first
+     * (affine) iteration, three per further iteration, final product
+     */
+    int depth() const { return 3 * iterations_; }
+    
+    #ifdef USE_SEAL
+    /**
+     * HE version normalization
+     * 1. Homomorphic inner product (||v||^2 in every slot)
+     * 2. Homomorphic Goldschmidt iteration from initial_guess
+     * 3. Homomorphic vector-scalar multiplication v * y
      */
-    template<typename Ciphertext>
-    Ciphertext normalize_encrypted(const Ciphertext& encrypted_vec) {
-        // Placeholder - requires real SEAL implementation
-        return encrypted_vec;
+    Ciphertext normalize_encrypted(const Ciphertext& encrypted_vec, CKKSContext& ctx) {
+        if (ctx.level(encrypted_vec) < static_cast<size_t>(depth())) {
+            throw std::invalid_argument("normalize_encrypted: needs " + std::to_string(depth()) +
+                                        " levels, ciphertext has " + std::to_string(ctx.level(encrypted_vec)) +
+                                        " (lengthen coeff_modulus_bits or use fewer iterations)");
+        }
+        
+        // Plaintext shadow of the same iteration (precision diagnostics only)
+        std::vector<double> shadow_v;
+        double shadow_x = 0.0, shadow_y = initial_guess_;
+        if (ctx.precision_tracking()) {
+            shadow_v = ctx.decrypt_vector(encrypted_vec);
+            for (double v : shadow_v) shadow_x += v * v;
+        }
+        auto track = [&](const std::string& op, const Ciphertext& ct, double expected) {
+            if (ctx.precision_tracking()) ctx.track_precision(op, ct, std::vector<double>(shadow_v.size(), expected));
+        };
+        
+        Ciphertext x = ctx.he_inner_product(encrypted_vec, encrypted_vec);
+        track("homo_norm.norm_sq", x, shadow_x);
+        
+        // y1 = y0 * (3 - x * y0^2) / 2 is affine in x: one plain multiply
+        double y0 = initial_guess_;
+        Ciphertext y = ctx.he_multiply_plain(x, -0.5 * y0 * y0 * y0);
+        add_constant_inplace(y, 1.5 * y0, ctx);
+        shadow_y = y0 * (3.0 - shadow_x * y0 * y0) / 2.0;
+        track("homo_norm.inv_sqrt", y, shadow_y);
+        
+        // y <- y * (1.5 - (x / 2) * y^2)
+        Ciphertext half_x = ctx.he_multiply_plain(x, 0.5);
+        for (int i = 1; i < iterations_; ++i) {
+            Ciphertext y2 = ctx.he_square(y);
+            Ciphertext t = multiply_at_common_level(half_x, y2, ctx);
+            ctx.evaluator()->negate_inplace(t);
+            add_constant_inplace(t, 1.5, ctx);
+            y = multiply_at_common_level(y, t, ctx);
+            shadow_y = shadow_y * (3.0 - shadow_x * shadow_y * shadow_y) / 2.0;
+            track("homo_norm.inv_sqrt", y, shadow_y);
+        }
+        
+        Ciphertext result = multiply_at_common_level(encrypted_vec, y, ctx);
+        if (ctx.precision_tracking()) {
+            for (auto& v : shadow_v) v *= shadow_y;
+            ctx.track_precision("homo_norm.output", result, shadow_v);
+        }
+        return result;
     }
+    #endif
     
     int iterations() const { return iterations_; }
+    double initial_guess() const { return initial_guess_; }
     
 private:
+    #ifdef USE_SEAL
+    static Ciphertext multiply_at_common_level(const Ciphertext& a, const Ciphertext& b, CKKSContext& ctx) {
+        Ciphertext lhs = a, rhs = b;
+        size_t level = std::min(ctx.level(lhs), ctx.level(rhs));
+        ctx.mod_switch_to_level_inplace(lhs, level);
+        ctx.mod_switch_to_level_inplace(rhs, level);
+        return ctx.he_multiply(lhs, rhs);
+    }
+    
+    static void add_constant_inplace(Ciphertext& ct, double value, CKKSContext& ctx) {
+        Plaintext plain;
+        ctx.encoder()->encode(value, ct.parms_id(), ct.scale(), plain);
+        ctx.evaluator()->add_plain_inplace(ct, plain);
+    }
+    #endif
+    
     int iterations_;
+    double initial_guess_;
 };
 
 } // namespace pprag
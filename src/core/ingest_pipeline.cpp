@@ -0,0 +1,358 @@
+/**
+ * ingest_pipeline.cpp
+ * Streaming .npy -> encrypted HNSW ingestion
+ *
+ * Rows of a memory-mapped .npy (NpyMatrix) flow through four stages joined
+ * by bounded lock-free queues, each stage with its own worker count:
+ *
+ *   read + normalize -> encode -> encrypt -> insert
+ *
+ * At most queue_capacity items wait between two stages, so memory stays
+ * bounded whatever the dataset size and the dataset never passes through
+ * Python. A row is converted from the mapping straight into the buffer that
+ * is encoded. Inserts into one graph serialize on its writer lock, so each
+ * insert worker builds its own partial graph (empty_like) and the partial
+ * graphs are merged into the target index at the end, as pprag_bench does
+ * with parallel_build_parts.
+ *
+ * Inserts score neighbors with parallel_for on the shared TaskScheduler, so
+ * the stage threads are budgeted against its size(): while the pipeline
+ * runs, one pool worker per stage thread beyond the first is held back, and
+ * inserts fan out only onto whatever the stages leave free.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "npy_file.cpp"
+#include "secure_hnsw.cpp"
+#include "thread_pool.cpp"
+
+namespace pprag {
+
+/**
+ * Bounded multi-producer multi-consumer ring (Vyukov): every cell carries a
+ * sequence number telling whether it is free for the producer of ticket pos
+ * or filled for its consumer, so push and pop are one CAS on the shared
+ * cursor and no lock. Capacity is rounded up to a power of two.
+ *
+ * push/pop wait with backoff; close() ends the stream: pop then drains the
+ * remaining items and returns false, push returns false straight away.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask_ = cap - 1;
+        cells_ = std::make_unique<Cell[]>(cap);
+        for (size_t i = 0; i < cap; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    bool try_push(T& value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T& value) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool push(T value) {
+        for (int spins = 0; !try_push(value); ++spins) {
+            if (closed()) return false;
+            backoff(spins);
+        }
+        return true;
+    }
+
+    bool pop(T& value) {
+        for (int spins = 0; !try_pop(value); ++spins) {
+            // Pushes that completed before close() are visible to this try_pop
+            if (closed()) return try_pop(value);
+            backoff(spins);
+        }
+        return true;
+    }
+
+    void close() { closed_.store(true, std::memory_order_release); }
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq{0};
+        T value{};
+    };
+
+    // HE stages take milliseconds per item: spin briefly, then sleep instead
+    // of taking CPU from the workers of the slow stage
+    static void backoff(int spins) {
+        if (spins < 64) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(spins < 256 ? 50 : 200));
+    }
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<bool> closed_{false};
+};
+
+#ifdef USE_SEAL
+
+struct IngestOptions {
+    int read_workers = 1;     // mmap row -> double (+ normalization)
+    int encode_workers = 1;   // CKKS encoding
+    int encrypt_workers = 0;  // public-key encryption, 0 = rest of TaskScheduler::size()
+    int insert_workers = 1;   // partial graphs built in parallel and merged
+    size_t queue_capacity = 64;
+    bool normalize = false;   // L2-normalize rows (cosine metric)
+    size_t begin = 0;         // row range [begin, end) of the matrix
+    size_t end = std::numeric_limits<size_t>::max();
+    double merge_sample_fraction = 0.1;
+};
+
+struct IngestStats {
+    size_t rows = 0;
+    double seconds = 0.0;        // wall time including the merge
+    double merge_seconds = 0.0;
+    std::map<std::string, int> workers;          // per stage
+    std::map<std::string, double> busy_seconds;  // per stage, summed over its workers
+    std::vector<int> ids;        // ids[i] = index ID of row begin + i
+};
+
+class IngestPipeline {
+public:
+    IngestPipeline(CKKSContext& ctx, SecureHNSWEncrypted& index, IngestOptions options = {})
+        : ctx_(ctx), index_(index), options_(options) {
+        if (index.two_stage()) {
+            throw std::invalid_argument("IngestPipeline: two-stage indexes need coarse vectors, use insert()");
+        }
+        auto at_least_one = [](int n) { return std::max(1, n); };
+        options_.read_workers = at_least_one(options_.read_workers);
+        options_.encode_workers = at_least_one(options_.encode_workers);
+        options_.insert_workers = at_least_one(options_.insert_workers);
+        if (options_.encrypt_workers <= 0) {
+            int threads = TaskScheduler::instance().size();
+            options_.encrypt_workers =
+                at_least_one(threads - options_.read_workers - options_.encode_workers - options_.insert_workers);
+        }
+        options_.queue_capacity = std::max<size_t>(options_.queue_capacity, 2);
+    }
+
+    const IngestOptions& options() const { return options_; }
+
+    IngestStats run(const NpyMatrix& data) {
+        PPRAG_TRACE_SCOPE("ingest.run");
+        if (data.cols() > ctx_.slot_count()) {
+            throw std::invalid_argument("IngestPipeline: " + std::to_string(data.cols()) +
+                                        " columns do not fit in " + std::to_string(ctx_.slot_count()) + " slots");
+        }
+        const size_t begin = std::min(options_.begin, data.rows());
+        const size_t end = std::min(options_.end, data.rows());
+        const size_t n = end > begin ? end - begin : 0;
+
+        IngestStats stats;
+        stats.workers = {{"read", options_.read_workers}, {"encode", options_.encode_workers},
+                         {"encrypt", options_.encrypt_workers}, {"insert", options_.insert_workers}};
+        stats.busy_seconds = {{"read", 0.0}, {"encode", 0.0}, {"encrypt", 0.0}, {"insert", 0.0}};
+        stats.ids.assign(n, -1);
+        if (n == 0) return stats;
+        auto t0 = std::chrono::steady_clock::now();
+
+        const int parts = static_cast<int>(std::min<size_t>(options_.insert_workers, n));
+        std::vector<std::unique_ptr<SecureHNSWEncrypted>> graphs(parts);
+        std::vector<SecureHNSWEncrypted*> targets{&index_};
+        for (int p = 1; p < parts; ++p) {
+            graphs[p] = index_.empty_like();
+            targets.push_back(graphs[p].get());
+        }
+        index_.reserve(index_.size() + n);
+        std::vector<int> part_of(n, 0);
+
+        BoundedQueue<RowItem> rows_q(options_.queue_capacity);
+        BoundedQueue<PlainItem> plain_q(options_.queue_capacity);
+        BoundedQueue<CipherItem> cipher_q(options_.queue_capacity);
+        std::atomic<size_t> next_row{begin};
+        abort_ = false;
+        error_ = nullptr;
+        // Closing every queue releases workers blocked on push or pop
+        auto close_all = [&]() {
+            rows_q.close();
+            plain_q.close();
+            cipher_q.close();
+        };
+
+        // Stage threads take the place of pool workers, so parallel_for in
+        // the inserts only reaches the workers they leave over
+        const int stage_threads = options_.read_workers + options_.encode_workers + options_.encrypt_workers + parts;
+        TaskScheduler::Hold hold(TaskScheduler::instance(), stage_threads - 1);
+
+        std::vector<std::thread> threads;
+        auto stage = [&](const char* name, int workers, auto* out, auto body) {
+            auto remaining = std::make_shared<std::atomic<int>>(workers);
+            for (int w = 0; w < workers; ++w) {
+                threads.emplace_back([&, name, out, body, remaining, w]() {
+                    double busy = 0.0;
+                    try {
+                        body(w, busy);
+                    } catch (...) {
+                        record_error(std::current_exception());
+                        close_all();
+                    }
+                    add_busy(stats, name, busy);
+                    // The last worker of a stage ends its output stream
+                    if (remaining->fetch_sub(1) == 1 && out) out->close();
+                });
+            }
+        };
+
+        stage("read", options_.read_workers, &rows_q, [&](int, double& busy) {
+            for (size_t row; !abort_ && (row = next_row.fetch_add(1)) < end;) {
+                auto ts = std::chrono::steady_clock::now();
+                RowItem item{row, std::vector<double>(data.cols())};
+                data.row_into(row, item.values.data());
+                if (options_.normalize) normalize(item.values);
+                busy += seconds_since(ts);
+                if (!rows_q.push(std::move(item))) break;
+            }
+        });
+        stage("encode", options_.encode_workers, &plain_q, [&](int, double& busy) {
+            for (RowItem item; !abort_ && rows_q.pop(item);) {
+                auto ts = std::chrono::steady_clock::now();
+                PlainItem out{item.row, ctx_.encode_vector(item.values)};
+                busy += seconds_since(ts);
+                if (!plain_q.push(std::move(out))) break;
+            }
+        });
+        stage("encrypt", options_.encrypt_workers, &cipher_q, [&](int, double& busy) {
+            for (PlainItem item; !abort_ && plain_q.pop(item);) {
+                auto ts = std::chrono::steady_clock::now();
+                CipherItem out{item.row, ctx_.encrypt_plaintext(item.plain)};
+                busy += seconds_since(ts);
+                if (!cipher_q.push(std::move(out))) break;
+            }
+        });
+        stage("insert", parts, static_cast<BoundedQueue<CipherItem>*>(nullptr), [&](int w, double& busy) {
+            for (CipherItem item; !abort_ && cipher_q.pop(item);) {
+                auto ts = std::chrono::steady_clock::now();
+                size_t i = item.row - begin;
+                stats.ids[i] = targets[w]->insert(std::move(item.ct));
+                part_of[i] = w;
+                busy += seconds_since(ts);
+            }
+        });
+        for (auto& t : threads) t.join();
+        if (error_) std::rethrow_exception(error_);
+
+        auto tm = std::chrono::steady_clock::now();
+        std::vector<int> offsets(parts, 0);
+        for (int p = 1; p < parts; ++p) offsets[p] = index_.merge(*graphs[p], options_.merge_sample_fraction);
+        for (size_t i = 0; i < n; ++i) stats.ids[i] += offsets[part_of[i]];
+        stats.merge_seconds = seconds_since(tm);
+
+        stats.rows = n;
+        stats.seconds = seconds_since(t0);
+        return stats;
+    }
+
+private:
+    struct RowItem {
+        size_t row = 0;
+        std::vector<double> values;
+    };
+    struct PlainItem {
+        size_t row = 0;
+        Plaintext plain;
+    };
+    struct CipherItem {
+        size_t row = 0;
+        Ciphertext ct;
+    };
+
+    static double seconds_since(std::chrono::steady_clock::time_point t0) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    static void normalize(std::vector<double>& v) {
+        double norm = 0.0;
+        for (double x : v) norm += x * x;
+        norm = std::max(std::sqrt(norm), 1e-10);
+        for (double& x : v) x /= norm;
+    }
+
+    // First error wins and stops every stage
+    void record_error(std::exception_ptr error) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) error_ = error;
+        abort_ = true;
+    }
+
+    void add_busy(IngestStats& stats, const std::string& stage, double seconds) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.busy_seconds[stage] += seconds;
+    }
+
+    CKKSContext& ctx_;
+    SecureHNSWEncrypted& index_;
+    IngestOptions options_;
+    std::mutex mutex_;
+    std::atomic<bool> abort_{false};
+    std::exception_ptr error_;
+};
+
+#endif
+
+} // namespace pprag
@@ -0,0 +1,49 @@
+/**
+ * memory_usage.cpp
+ * Byte accounting behind the memory_usage() reports
+ *
+ * A report maps component -> bytes and always carries a "total" entry.
+ * Ciphertexts and keys are counted by their polynomial data (8 bytes per
+ * coefficient per prime), which dominates every index; allocator headers
+ * and padding are not included. A ciphertext counts its allocated buffer,
+ * which keeps its old size after an in-place switch to a lower level.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef USE_SEAL
+#include "seal/seal.h"
+#endif
+
+namespace pprag {
+
+using MemoryUsage = std::map<std::string, size_t>;
+
+/**
+ * Set "total" to the sum of the other entries
+ */
+inline MemoryUsage& add_total(MemoryUsage& usage) {
+    usage.erase("total");
+    size_t total = 0;
+    for (const auto& [name, bytes] : usage) total += bytes;
+    usage["total"] = total;
+    return usage;
+}
+
+template <typename T>
+size_t vector_bytes(const std::vector<T>& v) {
+    return v.capacity() * sizeof(T);
+}
+
+#ifdef USE_SEAL
+inline size_t ciphertext_bytes(const seal::Ciphertext& ct) {
+    return ct.dyn_array().capacity() * sizeof(uint64_t);
+}
+#endif
+
+} // namespace pprag
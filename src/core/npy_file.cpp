@@ -0,0 +1,185 @@
+/**
+ * npy_file.cpp
+ * Read-only memory-mapped 2-D .npy matrix (as written by np.save)
+ *
+ * Accepts little-endian float32 / float64 in C order. Rows are converted to
+ * double on access, so a 1M x 256 float32 dataset costs no load time and
+ * only the pages that are actually read.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace pprag {
+
+class NpyMatrix {
+public:
+    explicit NpyMatrix(const std::string& path) : path_(path) {
+        map_file();
+        try {
+            parse_header();
+        } catch (...) {
+            unmap_file();
+            throw;
+        }
+    }
+
+    ~NpyMatrix() { unmap_file(); }
+
+    NpyMatrix(const NpyMatrix&) = delete;
+    NpyMatrix& operator=(const NpyMatrix&) = delete;
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+
+    std::vector<double> row(size_t i) const {
+        std::vector<double> out(cols_);
+        row_into(i, out.data());
+        return out;
+    }
+
+    // Row i converted straight into out[0, cols), no intermediate copy
+    void row_into(size_t i, double* out) const {
+        if (i >= rows_) throw std::out_of_range("NpyMatrix: row " + std::to_string(i) + " of " + std::to_string(rows_));
+        const unsigned char* p = data_ + i * cols_ * item_size_;
+        if (item_size_ == sizeof(float)) {
+            for (size_t j = 0; j < cols_; ++j) {
+                float v;
+                std::memcpy(&v, p + j * sizeof(float), sizeof(float));
+                out[j] = v;
+            }
+        } else {
+            std::memcpy(out, p, cols_ * sizeof(double));
+        }
+    }
+
+private:
+    void map_file() {
+#ifdef _WIN32
+        file_ = CreateFileA(path_.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) throw std::runtime_error("cannot open " + path_);
+        LARGE_INTEGER size;
+        GetFileSizeEx(file_, &size);
+        size_ = static_cast<size_t>(size.QuadPart);
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        base_ = mapping_ ? static_cast<const unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        if (!base_) {
+            unmap_file();
+            throw std::runtime_error("cannot map " + path_);
+        }
+#else
+        int fd = ::open(path_.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("cannot open " + path_);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("cannot stat " + path_);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);  // the mapping keeps the file referenced
+        if (p == MAP_FAILED) throw std::runtime_error("cannot map " + path_);
+        base_ = static_cast<const unsigned char*>(p);
+#endif
+    }
+
+    void unmap_file() {
+#ifdef _WIN32
+        if (base_) UnmapViewOfFile(base_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (base_) ::munmap(const_cast<unsigned char*>(base_), size_);
+#endif
+        base_ = nullptr;
+    }
+
+    // Header: "\x93NUMPY", version, header length, then a Python dict literal
+    void parse_header() {
+        if (size_ < 10 || std::memcmp(base_, "\x93NUMPY", 6) != 0) throw std::runtime_error(path_ + ": not a .npy file");
+        int major = base_[6];
+        size_t header_len, offset;
+        if (major == 1) {
+            header_len = base_[8] | (base_[9] << 8);
+            offset = 10;
+        } else {
+            if (size_ < 12) throw std::runtime_error(path_ + ": truncated .npy header");
+            header_len = base_[8] | (base_[9] << 8) | (base_[10] << 16) | (static_cast<size_t>(base_[11]) << 24);
+            offset = 12;
+        }
+        if (offset + header_len > size_) throw std::runtime_error(path_ + ": truncated .npy header");
+        std::string header(reinterpret_cast<const char*>(base_ + offset), header_len);
+
+        std::string descr = field(header, "descr");
+        if (descr == "'<f4'") item_size_ = 4;
+        else if (descr == "'<f8'") item_size_ = 8;
+        else throw std::runtime_error(path_ + ": unsupported dtype " + descr + " (expected <f4 or <f8)");
+        if (field(header, "fortran_order") != "False") throw std::runtime_error(path_ + ": Fortran order is not supported");
+
+        std::string shape = field(header, "shape");
+        size_t comma = shape.find(',');
+        if (shape.size() < 2 || shape.front() != '(' || comma == std::string::npos) {
+            throw std::runtime_error(path_ + ": expected a 2-D array, shape " + shape);
+        }
+        rows_ = std::stoull(shape.substr(1, comma - 1));
+        std::string second = shape.substr(comma + 1, shape.size() - comma - 2);
+        if (second.find_first_of("0123456789") == std::string::npos || second.find(',') != std::string::npos) {
+            throw std::runtime_error(path_ + ": expected a 2-D array, shape " + shape);
+        }
+        cols_ = std::stoull(second);
+
+        data_ = base_ + offset + header_len;
+        if (offset + header_len + rows_ * cols_ * item_size_ > size_) throw std::runtime_error(path_ + ": truncated data");
+    }
+
+    // Value text of 'key': up to the next top-level comma of the dict literal
+    static std::string field(const std::string& header, const std::string& key) {
+        size_t k = header.find("'" + key + "'");
+        if (k == std::string::npos) throw std::runtime_error("npy header has no '" + key + "'");
+        size_t b = header.find(':', k) + 1;
+        while (b < header.size() && header[b] == ' ') ++b;
+        size_t e = b;
+        int depth = 0;
+        for (; e < header.size(); ++e) {
+            char c = header[e];
+            if (c == '(') ++depth;
+            else if (c == ')') --depth;
+            else if ((c == ',' || c == '}') && depth == 0) break;
+        }
+        std::string v = header.substr(b, e - b);
+        v.erase(v.find_last_not_of(' ') + 1);
+        return v;
+    }
+
+    std::string path_;
+    const unsigned char* base_ = nullptr;
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t rows_ = 0, cols_ = 0, item_size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+};
+
+} // namespace pprag
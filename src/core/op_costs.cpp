@@ -0,0 +1,96 @@
+/**
+ * op_costs.cpp
+ * Per-primitive CKKS cost calibration
+ *
+ * Times every SEAL primitive the simulator backend counts (same op names)
+ * at every chain index it can run at. The resulting table, saved as
+ * config/op_costs.json, turns simulated op counts into predicted wall time:
+ *   predicted seconds = sum over (op, level) of count * cost
+ * Costs depend on the machine and the CKKS parameters, so recalibrate when
+ * either changes.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include "seal_utils.cpp"
+
+namespace pprag {
+
+#ifdef USE_SEAL
+
+/**
+ * Mean seconds per call, as op name -> chain index -> seconds
+ */
+inline std::map<std::string, std::map<int, double>> measure_op_costs(CKKSContext& ctx, int reps = 20) {
+    using clock = std::chrono::steady_clock;
+    std::map<std::string, std::map<int, double>> costs;
+    auto evaluator = ctx.evaluator();
+    auto encoder = ctx.encoder();
+    auto encryptor = ctx.encryptor();
+    auto decryptor = ctx.decryptor();
+    auto context = ctx.context();
+
+    auto time = [&](const std::string& op, int level, auto&& body) {
+        body();  // warm-up (pools, NTT tables)
+        auto start = clock::now();
+        for (int r = 0; r < reps; ++r) body();
+        costs[op][level] = std::chrono::duration<double>(clock::now() - start).count() / reps;
+    };
+
+    std::vector<double> values(ctx.slot_count());
+    for (size_t i = 0; i < values.size(); ++i) values[i] = 0.5 + 0.001 * static_cast<double>(i % 97);
+
+    int top = static_cast<int>(ctx.top_level());
+    Plaintext fresh_pt;
+    time("encode", top, [&] { encoder->encode(values, ctx.scale(), fresh_pt); });
+    // Raw encrypt/decrypt: encode and decode have rows of their own
+    Ciphertext fresh_ct;
+    time("encrypt", top, [&] { encryptor->encrypt(fresh_pt, fresh_ct); });
+
+    for (int level = top; level >= 0; --level) {
+        Ciphertext a = ctx.encrypt_vector(values);
+        Ciphertext b = ctx.encrypt_vector(values);
+        ctx.mod_switch_to_level_inplace(a, static_cast<size_t>(level));
+        ctx.mod_switch_to_level_inplace(b, static_cast<size_t>(level));
+        auto parms_id = a.parms_id();
+        Plaintext pt;
+        encoder->encode(values, parms_id, a.scale(), pt);
+        Ciphertext out;
+
+        time("add", level, [&] { evaluator->add(a, b, out); });
+        time("sub", level, [&] { evaluator->sub(a, b, out); });
+        time("negate", level, [&] { evaluator->negate(a, out); });
+        time("add_plain", level, [&] { evaluator->add_plain(a, pt, out); });
+        time("sub_plain", level, [&] { evaluator->sub_plain(a, pt, out); });
+        time("rotate", level, [&] { evaluator->rotate_vector(a, 1, ctx.galois_keys(), out); });
+        Plaintext decrypted;
+        time("decrypt", level, [&] { decryptor->decrypt(a, decrypted); });
+        time("decode", level, [&] {
+            std::vector<double> decoded;
+            encoder->decode(pt, decoded);
+        });
+
+        if (level == 0) break;  // no prime left to rescale a product away
+
+        Ciphertext product;
+        evaluator->multiply(a, b, product);
+        time("multiply", level, [&] { evaluator->multiply(a, b, out); });
+        time("square", level, [&] { evaluator->square(a, out); });
+        time("multiply_plain", level, [&] { evaluator->multiply_plain(a, pt, out); });
+        time("relinearize", level, [&] { evaluator->relinearize(product, ctx.relin_keys(), out); });
+        evaluator->relinearize_inplace(product, ctx.relin_keys());
+        time("rescale", level, [&] { evaluator->rescale_to_next(product, out); });
+
+        auto next = context->get_context_data(parms_id)->next_context_data()->parms_id();
+        time("mod_switch", level, [&] { evaluator->mod_switch_to(a, next, out); });
+    }
+    return costs;
+}
+
+#endif  // USE_SEAL
+
+} // namespace pprag
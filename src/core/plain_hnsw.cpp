@@ -0,0 +1,373 @@
+/**
+ * plain_hnsw.cpp
+ * Plaintext HNSW baseline for HE overhead ratios
+ *
+ * Same parameters, graph layout and algorithms as SecureHNSWEncrypted
+ * (level draw, ef_construction search with closest-M selection, 2M links
+ * on layer 0, shrink-to-closest on overflow, tombstones traversed but not
+ * returned), with float vectors and SIMD distances in place of ciphertexts.
+ * export_graph() / load_graph() move graphs between the two, so both can
+ * search exactly the same graph.
+ *
+ * Searches are const and may run concurrently; writers must not overlap
+ * with anything else (no reader/writer protocol, unlike the encrypted index).
+ */
+
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <random>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include "seal_utils.cpp"
+#include "hnsw_graph.cpp"
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+namespace pprag {
+
+namespace simd {
+
+#if defined(__AVX2__) && defined(__FMA__)
+inline float horizontal_sum(__m256 v) {
+    __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 0x55));
+    return _mm_cvtss_f32(lo);
+}
+#endif
+
+inline float l2_squared(const float* a, const float* b, size_t n) {
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(__AVX2__) && defined(__FMA__)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        acc = _mm256_fmadd_ps(d, d, acc);
+    }
+    sum = horizontal_sum(acc);
+#endif
+    for (; i < n; ++i) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+inline float inner_product(const float* a, const float* b, size_t n) {
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(__AVX2__) && defined(__FMA__)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc);
+    }
+    sum = horizontal_sum(acc);
+#endif
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+} // namespace simd
+
+class PlainHNSW {
+public:
+    PlainHNSW(int dim, int M = 16, int ef_construction = 200, int ef_search = 100)
+        : dim_(dim), M_(M), ef_construction_(ef_construction), ef_search_(ef_search) {
+        if (dim <= 0) throw std::invalid_argument("PlainHNSW: dimension must be positive");
+        level_mult_ = 1.0 / std::log(M_);
+    }
+
+    /**
+     * Similarity metric; fixed once the index holds nodes. For COSINE the
+     * caller normalizes vectors and queries, as for the encrypted index.
+     */
+    void set_metric(Metric metric) {
+        if (metric != metric_ && size() > 0) throw std::logic_error("set_metric: index already holds nodes");
+        metric_ = metric;
+    }
+
+    Metric metric() const { return metric_; }
+    int dim() const { return dim_; }
+
+    void reserve(size_t n) {
+        data_.reserve(n * dim_);
+        levels_.reserve(n);
+        neighbors_.reserve(n);
+    }
+
+    /**
+     * Store a vector under id at the given level without linking it
+     * (counterpart of add_encrypted_node)
+     */
+    void add_node(int id, const std::vector<double>& vec, int level) {
+        if (id < 0) throw std::invalid_argument("add_node: negative ID");
+        if (id >= static_cast<int>(levels_.size())) resize(id + 1);
+        store(id, vec, level);
+        if (entry_ < 0) {
+            entry_ = id;
+            max_level_ = level;
+        }
+    }
+
+    /**
+     * Append and link a vector; returns its ID
+     */
+    int insert(const std::vector<double>& vec) {
+        int id = static_cast<int>(levels_.size());
+        resize(id + 1);
+        int level = random_level();
+        store(id, vec, level);
+        link_node(id);
+        return id;
+    }
+
+    void build(const std::vector<std::vector<double>>& vectors) {
+        reserve(levels_.size() + vectors.size());
+        for (const auto& v : vectors) insert(v);
+    }
+
+    std::vector<int> search(const std::vector<double>& query, int k) const {
+        std::vector<int> ids;
+        for (const auto& [dist, id] : search_with_distances(query, k)) ids.push_back(id);
+        return ids;
+    }
+
+    /**
+     * Top-k as ascending (distance, id) pairs, same ordering as the encrypted index
+     */
+    std::vector<std::pair<double, int>> search_with_distances(const std::vector<double>& query, int k) const {
+        if (entry_ < 0) return {};
+        std::vector<float> q = to_float(query);
+
+        int curr = entry_;
+        for (int l = max_level_; l >= 1; --l) {
+            curr = search_layer(q.data(), curr, 1, l, false)[0].second;
+        }
+        auto candidates = search_layer(q.data(), curr, ef_search_, 0, true);
+        if (candidates.size() > static_cast<size_t>(k)) candidates.resize(k);
+        return candidates;
+    }
+
+    /**
+     * Tombstone a node: traversed, never returned
+     */
+    void remove(int id) {
+        if (!is_live(id)) throw std::invalid_argument("remove: ID " + std::to_string(id) + " is not live");
+        deleted_[id] = 1;
+    }
+
+    // Number of live (non-tombstoned) nodes
+    size_t size() const {
+        size_t n = 0;
+        for (size_t id = 0; id < levels_.size(); ++id) {
+            if (levels_[id] >= 0 && !deleted_[id]) ++n;
+        }
+        return n;
+    }
+
+    HNSWGraph export_graph() const {
+        HNSWGraph graph;
+        graph.entry = entry_;
+        graph.max_level = entry_ < 0 ? 0 : max_level_;
+        graph.levels = levels_;
+        graph.deleted = deleted_;
+        graph.neighbors = neighbors_;
+        return graph;
+    }
+
+    /**
+     * Adopt a graph built elsewhere; every used ID must already hold its
+     * vector (add_node)
+     */
+    void load_graph(const HNSWGraph& graph) {
+        graph.validate();
+        if (graph.size() != levels_.size()) {
+            throw std::invalid_argument("load_graph: graph has " + std::to_string(graph.size()) +
+                                        " IDs, index has " + std::to_string(levels_.size()));
+        }
+        for (size_t id = 0; id < levels_.size(); ++id) {
+            if ((graph.levels[id] >= 0) != (levels_[id] >= 0)) {
+                throw std::invalid_argument("load_graph: ID " + std::to_string(id) + " is used in only one of graph and index");
+            }
+        }
+        levels_ = graph.levels;
+        deleted_ = graph.deleted;
+        neighbors_ = graph.neighbors;
+        entry_ = graph.entry;
+        max_level_ = graph.entry < 0 ? 0 : graph.max_level;
+    }
+
+private:
+    static constexpr int MAX_LEVEL = 16;
+
+    static std::vector<float> to_float(const std::vector<double>& vec) {
+        return std::vector<float>(vec.begin(), vec.end());
+    }
+
+    void resize(size_t n) {
+        data_.resize(n * dim_, 0.0f);
+        levels_.resize(n, -1);
+        deleted_.resize(n, 0);
+        neighbors_.resize(n);
+    }
+
+    void store(int id, const std::vector<double>& vec, int level) {
+        if (vec.size() != static_cast<size_t>(dim_)) {
+            throw std::invalid_argument("PlainHNSW expects " + std::to_string(dim_) + "-d vectors, got " +
+                                        std::to_string(vec.size()));
+        }
+        std::copy(vec.begin(), vec.end(), data_.begin() + static_cast<size_t>(id) * dim_);
+        levels_[id] = level;
+        deleted_[id] = 0;
+        neighbors_[id].assign(level + 1, {});
+    }
+
+    const float* vector_of(int id) const { return data_.data() + static_cast<size_t>(id) * dim_; }
+
+    bool is_live(int id) const {
+        return id >= 0 && id < static_cast<int>(levels_.size()) && levels_[id] >= 0 && !deleted_[id];
+    }
+
+    int max_neighbors(int level) const {
+        return level == 0 ? 2 * M_ : M_;
+    }
+
+    // Ascending distance, as score_to_distance maps the decrypted score
+    double distance(const float* query, int id) const {
+        if (metric_ == Metric::L2) return simd::l2_squared(query, vector_of(id), dim_);
+        return score_to_distance(metric_, simd::inner_product(query, vector_of(id), dim_));
+    }
+
+    int random_level() {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        double r = -std::log(std::max(uniform(rng_), 1e-12)) * level_mult_;
+        return std::min(static_cast<int>(r), MAX_LEVEL);
+    }
+
+    /**
+     * Layer search as in SecureHNSWEncrypted::search_layer: up to ef
+     * (distance, id) pairs in ascending order
+     */
+    std::vector<std::pair<double, int>> search_layer(const float* query, int entry, int ef, int level,
+                                                     bool live_only) const {
+        std::unordered_set<int> visited;
+        std::priority_queue<std::pair<double, int>> candidates; // max-heap on -dist (closest first)
+        std::priority_queue<std::pair<double, int>> results;    // max-heap on dist (worst on top)
+
+        double d = distance(query, entry);
+        candidates.push({-d, entry});
+        if (!live_only || !deleted_[entry]) results.push({d, entry});
+        visited.insert(entry);
+
+        while (!candidates.empty()) {
+            auto [neg_dist, curr] = candidates.top();
+            candidates.pop();
+
+            if (static_cast<int>(results.size()) >= ef && -neg_dist > results.top().first) break;
+
+            for (int neighbor : neighbors_[curr][level]) {
+                if (!visited.insert(neighbor).second) continue;
+
+                double dist = distance(query, neighbor);
+                if (static_cast<int>(results.size()) < ef || dist < results.top().first) {
+                    candidates.push({-dist, neighbor});
+                    if (live_only && deleted_[neighbor]) continue;
+                    results.push({dist, neighbor});
+                    if (static_cast<int>(results.size()) > ef) results.pop();
+                }
+            }
+        }
+
+        std::vector<std::pair<double, int>> res_vec;
+        while (!results.empty()) {
+            res_vec.push_back(results.top());
+            results.pop();
+        }
+        std::reverse(res_vec.begin(), res_vec.end());
+        return res_vec;
+    }
+
+    void link_node(int id) {
+        if (entry_ < 0) {
+            entry_ = id;
+            max_level_ = levels_[id];
+            return;
+        }
+
+        const float* vec = vector_of(id);
+        int level = levels_[id];
+        int curr = entry_;
+
+        for (int l = max_level_; l > level; --l) {
+            curr = search_layer(vec, curr, 1, l, false)[0].second;
+        }
+
+        for (int l = std::min(level, max_level_); l >= 0; --l) {
+            auto found = search_layer(vec, curr, ef_construction_, l, true);
+
+            std::vector<int> links;
+            for (const auto& [dist, n] : found) {
+                if (n == id) continue;
+                links.push_back(n);
+                if (static_cast<int>(links.size()) >= M_) break;
+            }
+            neighbors_[id][l] = links;
+            for (int n : links) add_link(n, id, l);
+
+            if (!found.empty()) curr = found[0].second;
+        }
+
+        if (level > max_level_) {
+            entry_ = id;
+            max_level_ = level;
+        }
+    }
+
+    void add_link(int from, int to, int level) {
+        std::vector<int>& links = neighbors_[from][level];
+        if (std::find(links.begin(), links.end(), to) != links.end()) return;
+        links.push_back(to);
+        if (static_cast<int>(links.size()) > max_neighbors(level)) {
+            links = closest_neighbors(from, links, max_neighbors(level));
+        }
+    }
+
+    std::vector<int> closest_neighbors(int id, const std::vector<int>& pool, int limit) const {
+        std::vector<std::pair<double, int>> scored;
+        scored.reserve(pool.size());
+        for (int n : pool) scored.push_back({distance(vector_of(id), n), n});
+        std::sort(scored.begin(), scored.end());
+
+        std::vector<int> kept;
+        for (const auto& [dist, n] : scored) {
+            if (static_cast<int>(kept.size()) >= limit) break;
+            kept.push_back(n);
+        }
+        return kept;
+    }
+
+    int dim_;
+    int M_, ef_construction_, ef_search_;
+    double level_mult_;
+    Metric metric_ = Metric::L2;
+    int entry_ = -1;
+    int max_level_ = 0;
+
+    std::vector<float> data_;                              // row-major, dim_ floats per ID
+    std::vector<int> levels_;                              // -1 = unused ID
+    std::vector<char> deleted_;
+    std::vector<std::vector<std::vector<int>>> neighbors_; // [id][layer]
+
+    std::mt19937 rng_{std::random_device{}()};
+};
+
+} // namespace pprag
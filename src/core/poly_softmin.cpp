@@ -9,6 +9,7 @@
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <string>
 #include "seal_utils.cpp"
 
 namespace pprag {
@@ -65,16 +66,24 @@ public:
      * Uses Horner's method for efficiency
      */
     Ciphertext poly_eval_encrypted(const Ciphertext& x, CKKSContext& ctx) {
+        PPRAG_TRACE_SCOPE("softmin.poly_eval", "degree", degree_);
         // x is already scaled by 1/temperature if handled outside or here
         // We assume input x is distance d. We need to evaluate Poly(d/tau)
         
+        // Plaintext shadow of the same Horner steps (precision diagnostics only)
+        std::vector<double> shadow_x, shadow;
+        if (ctx.precision_tracking()) {
+            shadow_x = ctx.decrypt_vector(x);
+            for (auto& v : shadow_x) v /= temperature_;
+            shadow.assign(shadow_x.size(), coeffs_[degree_]);
+        }
+        
         // 1. Scale input by 1/tau if tau != 1
         Ciphertext scaled_x = x;
         if (std::abs(temperature_ - 1.0) > 1e-6) {
-            Ciphertext inv_tau = ctx.encrypt_vector(std::vector<double>(ctx.slot_count(), 1.0/temperature_));
-            ctx.evaluator()->multiply_inplace(scaled_x, inv_tau);
-            ctx.evaluator()->relinearize_inplace(scaled_x, ctx.relin_keys());
-            ctx.evaluator()->rescale_to_next_inplace(scaled_x);
+            // Plain scalar: works at any input level, unlike a freshly encrypted 1/tau
+            scaled_x = ctx.he_multiply_plain(x, 1.0 / temperature_);
+            ctx.track_precision("softmin.scale", scaled_x, shadow_x);
         }
 
         // 2. Evaluate polynomial using Horner's method: c0 + x(c1 + x(c2 + ...))
@@ -84,7 +93,10 @@ public:
         Ciphertext result = ctx.encrypt_vector(std::vector<double>(ctx.slot_count(), coeffs_[degree_]));
         
         for (int i = degree_ - 1; i >= 0; --i) {
-            // result = result * x
+            // result = result * x (both brought to the lower of their levels first)
+            size_t level = std::min(ctx.level(result), ctx.level(scaled_x));
+            ctx.mod_switch_to_level_inplace(result, level);
+            ctx.mod_switch_to_level_inplace(scaled_x, level);
             ctx.evaluator()->multiply_inplace(result, scaled_x);
             ctx.evaluator()->relinearize_inplace(result, ctx.relin_keys());
             ctx.evaluator()->rescale_to_next_inplace(result);
@@ -107,6 +119,9 @@ public:
             ctx.encoder()->encode(std::vector<double>(ctx.slot_count(), coeffs_[i]), result.parms_id(), result.scale(), p_coeff);
             
             ctx.evaluator()->add_plain_inplace(result, p_coeff);
+            
+            for (size_t j = 0; j < shadow.size(); ++j) shadow[j] = shadow[j] * shadow_x[j] + coeffs_[i];
+            ctx.track_precision("softmin.horner" + std::to_string(degree_ - i), result, shadow);
         }
         
         return result;
@@ -119,6 +134,7 @@ public:
     std::vector<Ciphertext> compute_encrypted(
         const std::vector<Ciphertext>& encrypted_distances,
         CKKSContext& ctx) {
+        PPRAG_TRACE_SCOPE("softmin.compute", "distances", static_cast<int64_t>(encrypted_distances.size()));
         
         std::vector<Ciphertext> exps;
         exps.reserve(encrypted_distances.size());
@@ -162,6 +178,14 @@ public:
     int degree() const { return degree_; }
     double temperature() const { return temperature_; }
     
+    // Coefficient table and the object itself; no ciphertexts are kept between calls
+    MemoryUsage memory_usage() const {
+        MemoryUsage usage;
+        usage["object"] = sizeof(*this);
+        usage["coefficients"] = vector_bytes(coeffs_);
+        return add_total(usage);
+    }
+    
 private:
     int degree_;
     double temperature_;
@@ -0,0 +1,461 @@
+/**
+ * pprag_bench.cpp
+ * Native benchmark driver: the setup, retrieve and update phases of
+ * bench_runner.py without Python or per-vector binding calls in the timed loops
+ *
+ * Reads the dataset, encryption, index and benchmark sections of
+ * config/config.yaml, memory-maps the .npy dataset and writes the
+ * results/timings.json schema of BenchmarkRunner, so 06_visualize.py reads
+ * either. Encryption, query preparation and searches run as parallel loops
+ * on the task scheduler (thread_pool.cpp), sized by benchmark.num_workers and
+ * pinned with benchmark.pin_threads; the graph is built as
+ * parallel_build_parts partial graphs in parallel and merged, since inserts
+ * into one graph serialize on its writer lock. Searches and inserts score
+ * neighbors in parallel on the same pool. Searches run concurrently, so search rows
+ * report wall time as total_time and mean per-query latency as
+ * avg_time_per_item. Two-stage search and query batching are Python-only.
+ *
+ * Usage: pprag_bench [config.yaml] [timings.json]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "yaml_config.cpp"
+#include "npy_file.cpp"
+#include "secure_hnsw.cpp"
+
+#ifdef USE_SEAL
+using namespace pprag;
+
+namespace {
+
+using Details = std::vector<std::pair<std::string, double>>;
+
+// One TimingResult of bench_runner.py
+struct TimingRow {
+    std::string component;
+    std::string operation;
+    double total_time;
+    size_t num_items;
+    double avg_time_per_item;
+    Details details;
+};
+
+double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+std::vector<double> normalized(std::vector<double> v) {
+    double norm = 0.0;
+    for (double x : v) norm += x * x;
+    norm = std::max(std::sqrt(norm), 1e-10);
+    for (double& x : v) x /= norm;
+    return v;
+}
+
+// Peak RSS window (Linux VmHWM); see bench_runner.py
+bool reset_peak_rss() {
+    std::ofstream f("/proc/self/clear_refs");
+    return static_cast<bool>(f << "5" << std::flush);
+}
+
+double peak_rss_bytes() {
+    std::ifstream f("/proc/self/status");
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) return std::stod(line.substr(6)) * 1024.0;
+    }
+    return 0.0;
+}
+
+std::string timestamp() {
+    auto now = std::chrono::system_clock::now();
+    std::time_t t = std::chrono::system_clock::to_time_t(now);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count() % 1000000;
+    char buf[64];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", std::localtime(&t));
+    char frac[16];
+    std::snprintf(frac, sizeof(frac), ".%06lld", static_cast<long long>(us));
+    return std::string(buf) + frac;
+}
+
+std::string json_number(double v) {
+    if (!std::isfinite(v)) return "null";
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.12g", v);
+    std::string s = buf;
+    // Keep floats recognisable as floats, like Python's json
+    if (s.find_first_of(".eE") == std::string::npos) s += ".0";
+    return s;
+}
+
+std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+std::string details_json(const Details& details, const std::string& pad) {
+    if (details.empty()) return "{}";
+    std::string out = "{\n";
+    for (size_t i = 0; i < details.size(); ++i) {
+        out += pad + "  " + json_string(details[i].first) + ": " + json_number(details[i].second) +
+               (i + 1 < details.size() ? ",\n" : "\n");
+    }
+    return out + pad + "}";
+}
+
+class NativeBench {
+public:
+    explicit NativeBench(const ConfigNode& config)
+        : config_(config), index_cfg_(config["index"]), bench_cfg_(config["benchmark"]),
+          rng_(std::random_device{}()) {
+        const ConfigNode& enc = config["encryption"];
+        std::cout << "\n[Init] Initializing CKKS Context..." << std::endl;
+        ctx_ = std::make_unique<CKKSContext>(
+            static_cast<size_t>(enc["poly_modulus_degree"].as_int(8192)),
+            std::pow(2.0, enc["scale_power"].as_double(40)),
+            enc["coeff_modulus_bits"].as_int_list({60, 40, 40, 60}));
+        std::cout << "[HE] Initialized CKKS Context (slots=" << ctx_->slot_count() << ")" << std::endl;
+
+        metric_name_ = index_cfg_["metric"].as_string("l2");
+        unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+        workers_ = std::max(1, bench_cfg_["num_workers"].as_int(static_cast<int>(hw)));
+        TaskScheduler::instance().configure(workers_, bench_cfg_["pin_threads"].as_bool(false));
+        for (const char* key : {"two_stage", "query_batching"}) {
+            if (index_cfg_[key].as_bool(false)) {
+                std::cout << "[Init] index." << key << " is not supported natively; ignored" << std::endl;
+            }
+        }
+        if (bench_cfg_["trace"].as_bool(false)) Tracer::instance().set_enabled(true);
+    }
+
+    void load_data() {
+        const ConfigNode& dataset = config_["dataset"];
+        std::string path = dataset["output_path"].as_string();
+        data_ = std::make_unique<NpyMatrix>(path);
+        ids_.resize(data_->rows());
+        for (size_t i = 0; i < ids_.size(); ++i) ids_[i] = i;
+        if (bench_cfg_["use_sample"].as_bool(false)) {
+            size_t sample = static_cast<size_t>(dataset["sample_size"].as_int(1000));
+            if (sample < ids_.size()) {
+                std::shuffle(ids_.begin(), ids_.end(), rng_);
+                ids_.resize(sample);
+            }
+            std::cout << "[BenchmarkRunner] Using sample mode: " << ids_.size() << " vectors" << std::endl;
+        } else {
+            std::cout << "[BenchmarkRunner] Using full dataset: " << ids_.size() << " vectors" << std::endl;
+        }
+        dim_ = static_cast<int>(data_->cols());
+    }
+
+    // ==================== Setup Phase ====================
+
+    void benchmark_setup() {
+        reset_phase();
+        size_t n = ids_.size();
+        banner("[Setup Benchmark] Testing with " + std::to_string(n) + " vectors");
+
+        std::cout << "\n[1/2] Encrypting " << n << " vectors on " << workers_ << " threads..." << std::endl;
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<Ciphertext> cts(n);
+        parallel_for(0, n, [&](size_t i) { cts[i] = ctx_->encrypt_vector(to_metric_space(data_->row(ids_[i]))); });
+        double enc_time = seconds_since(t0);
+        setup_.push_back({"encryption", "encrypt_batch", enc_time, n, enc_time / n,
+                          with(latency_details({"encrypt"}), {{"threads", static_cast<double>(workers_)}})});
+        std::cout << "      Avg Encrypt: " << enc_time / n * 1000 << "ms/vector (wall)" << std::endl;
+
+        int parts = std::max(1, std::min(bench_cfg_["parallel_build_parts"].as_int(2), static_cast<int>(n)));
+        std::cout << "\n[2/2] Building Encrypted HNSW Index (" << parts << " parts)..." << std::endl;
+        LatencyRegistry::instance().reset();
+        t0 = std::chrono::steady_clock::now();
+        std::vector<std::unique_ptr<SecureHNSWEncrypted>> graphs;
+        for (int p = 0; p < parts; ++p) graphs.push_back(make_index());
+        parallel_for(0, static_cast<size_t>(parts), [&](size_t p) {
+            size_t begin = n * p / parts, end = n * (p + 1) / parts;
+            graphs[p]->reserve(end - begin);
+            for (size_t i = begin; i < end; ++i) graphs[p]->insert(std::move(cts[i]));
+        });
+        double link_time = seconds_since(t0);
+        auto tm = std::chrono::steady_clock::now();
+        double sample_fraction = index_cfg_["merge_sample_fraction"].as_double(0.1);
+        for (int p = 1; p < parts; ++p) graphs[0]->merge(*graphs[p], sample_fraction);
+        double merge_time = seconds_since(tm);
+        index_ = std::move(graphs[0]);
+        double build_time = enc_time + link_time + merge_time;
+        setup_.push_back({"secure_hnsw", "build_index_e2e", build_time, n, build_time / n,
+                          with(latency_details({"insert", "distance"}),
+                               {{"parts", static_cast<double>(parts)}, {"link_time", link_time}, {"merge_time", merge_time}})});
+        std::cout << "      Total Build Time: " << build_time << "s (link " << link_time << "s, merge "
+                  << merge_time << "s)" << std::endl;
+        record_memory("setup");
+    }
+
+    // ==================== Retrieve Phase ====================
+
+    void benchmark_retrieve() {
+        reset_phase();
+        size_t num_queries = std::min(static_cast<size_t>(bench_cfg_["num_test_queries"].as_int(50)), ids_.size());
+        std::vector<int> top_k = bench_cfg_["retrieval_top_k"].as_int_list({1, 5, 10});
+        banner("[Retrieve Benchmark] Testing " + std::to_string(num_queries) + " queries");
+
+        // Dataset vectors plus 0.1 Gaussian noise, renormalized (generate_query_vectors)
+        std::vector<size_t> picks = ids_;
+        std::shuffle(picks.begin(), picks.end(), rng_);
+        std::normal_distribution<double> noise(0.0, 0.1);
+        std::vector<std::vector<double>> queries;
+        for (size_t q = 0; q < num_queries; ++q) {
+            auto v = data_->row(picks[q]);
+            for (double& x : v) x += noise(rng_);
+            queries.push_back(to_metric_space(normalized(std::move(v))));
+        }
+
+        std::cout << "\n[1/2] Benchmarking Query Encryption..." << std::endl;
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<Ciphertext> cts(num_queries);
+        parallel_for(0, num_queries, [&](size_t i) { cts[i] = ctx_->encrypt_vector(queries[i]); });
+        double enc_time = seconds_since(t0);
+        retrieve_.push_back({"encryption", "encrypt_query", enc_time, num_queries, enc_time / num_queries,
+                             latency_details({"encrypt"})});
+        std::cout << "      Total: " << enc_time << "s" << std::endl;
+
+        t0 = std::chrono::steady_clock::now();
+        std::vector<std::optional<QueryHandle>> handles(num_queries);
+        parallel_for(0, num_queries, [&](size_t i) { handles[i].emplace(index_->prepare_query(cts[i])); });
+        double prep_time = seconds_since(t0);
+        retrieve_.push_back({"secure_hnsw", "prepare_query", prep_time, num_queries, prep_time / num_queries, {}});
+
+        std::cout << "\n[2/2] Benchmarking Secure Search on " << workers_ << " threads..." << std::endl;
+        for (int k : top_k) {
+            std::cout << "\n      Testing top_k=" << k << "..." << std::endl;
+            LatencyRegistry::instance().reset();
+            t0 = std::chrono::steady_clock::now();
+            parallel_for(0, num_queries, [&](size_t i) { index_->search(*handles[i], k); });
+            double wall = seconds_since(t0);
+            double mean_latency = LatencyRegistry::instance().histogram("search").summary().mean_ms / 1000.0;
+            retrieve_.push_back({"secure_hnsw", "search_top" + std::to_string(k), wall, num_queries, mean_latency,
+                                 with(latency_details({"search", "distance", "decrypt"}),
+                                      {{"threads", static_cast<double>(workers_)}, {"qps", wall > 0 ? num_queries / wall : 0.0}})});
+            std::cout << "      Total: " << wall << "s, mean latency " << mean_latency * 1000 << "ms" << std::endl;
+        }
+        record_memory("retrieve");
+    }
+
+    // ==================== Update Phase ====================
+
+    void benchmark_update() {
+        reset_phase();
+        std::vector<int> batch_sizes = bench_cfg_["update_batch_sizes"].as_int_list({1, 10, 100});
+        banner("[Update Benchmark] Testing batch sizes: " + std::to_string(batch_sizes.size()) + " sizes");
+
+        std::normal_distribution<double> gauss(0.0, 1.0);
+        for (int batch : batch_sizes) {
+            std::cout << "\n--- Batch size: " << batch << " ---" << std::endl;
+            std::vector<std::vector<double>> vectors(batch, std::vector<double>(dim_));
+            for (auto& v : vectors) {
+                for (double& x : v) x = gauss(rng_);
+                v = to_metric_space(normalized(std::move(v)));
+            }
+
+            // Encryption is part of an insert, as in SecureHNSWWrapper.insert
+            LatencyRegistry::instance().reset();
+            auto t0 = std::chrono::steady_clock::now();
+            std::vector<Ciphertext> cts(batch);
+            parallel_for(0, static_cast<size_t>(batch), [&](size_t i) { cts[i] = ctx_->encrypt_vector(vectors[i]); });
+            std::vector<int> new_ids;
+            for (auto& ct : cts) new_ids.push_back(index_->insert(std::move(ct)));
+            double insert_time = seconds_since(t0);
+            update_.push_back({"secure_hnsw", "insert_batch" + std::to_string(batch), insert_time,
+                               static_cast<size_t>(batch), insert_time / batch, latency_details({"insert", "distance"})});
+            std::cout << "      Insert Total: " << insert_time << "s" << std::endl;
+
+            t0 = std::chrono::steady_clock::now();
+            for (int id : new_ids) index_->remove(id);
+            double delete_time = seconds_since(t0);
+            update_.push_back({"secure_hnsw", "delete_batch" + std::to_string(batch), delete_time,
+                               static_cast<size_t>(batch), delete_time / batch, {}});
+            std::cout << "      Delete Total: " << delete_time << "s" << std::endl;
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        int reclaimed = index_->compact();
+        double compact_time = seconds_since(t0);
+        update_.push_back({"secure_hnsw", "compact", compact_time, static_cast<size_t>(reclaimed),
+                           compact_time / std::max(reclaimed, 1), {}});
+        std::cout << "\n      Compact: " << reclaimed << " nodes reclaimed in " << compact_time << "s" << std::endl;
+        record_memory("update");
+    }
+
+    /**
+     * BenchmarkResult.to_dict() layout
+     */
+    void save(const std::string& path) const {
+        std::filesystem::path out(path);
+        if (out.has_parent_path()) std::filesystem::create_directories(out.parent_path());
+        std::ofstream f(path);
+        if (!f) throw std::runtime_error("cannot write " + path);
+        f << "{\n  \"timestamp\": " << json_string(timestamp()) << ",\n  \"config\": " << config_.to_json(2);
+        for (const auto& [name, rows] : {std::make_pair("setup", &setup_), std::make_pair("retrieve", &retrieve_),
+                                         std::make_pair("update", &update_)}) {
+            f << ",\n  \"" << name << "\": [";
+            for (size_t i = 0; i < rows->size(); ++i) {
+                const TimingRow& r = (*rows)[i];
+                f << (i ? ",\n" : "\n") << "    {\n"
+                  << "      \"component\": " << json_string(r.component) << ",\n"
+                  << "      \"operation\": " << json_string(r.operation) << ",\n"
+                  << "      \"total_time\": " << json_number(r.total_time) << ",\n"
+                  << "      \"num_items\": " << r.num_items << ",\n"
+                  << "      \"avg_time_per_item\": " << json_number(r.avg_time_per_item) << ",\n"
+                  << "      \"details\": " << details_json(r.details, "      ") << "\n    }";
+            }
+            f << (rows->empty() ? "]" : "\n  ]");
+        }
+        f << ",\n  \"memory\": {";
+        for (size_t i = 0; i < memory_.size(); ++i) {
+            f << (i ? ",\n" : "\n") << "    " << json_string(memory_[i].first) << ": "
+              << details_json(memory_[i].second, "    ");
+        }
+        f << (memory_.empty() ? "}" : "\n  }") << "\n}\n";
+        std::cout << "[BenchmarkRunner] Results saved to " << path << std::endl;
+
+        if (bench_cfg_["trace"].as_bool(false)) {
+            std::string trace_path = bench_cfg_["trace_path"].as_string("./results/trace.json");
+            Tracer::instance().write_chrome_trace(trace_path);
+            std::cout << "[BenchmarkRunner] " << Tracer::instance().event_count() << " trace spans saved to "
+                      << trace_path << std::endl;
+        }
+    }
+
+private:
+    std::unique_ptr<SecureHNSWEncrypted> make_index() const {
+        auto index = std::make_unique<SecureHNSWEncrypted>(*ctx_, index_cfg_["hnsw_m"].as_int(16),
+                                                           index_cfg_["hnsw_ef_construction"].as_int(200),
+                                                           index_cfg_["hnsw_ef_search"].as_int(100));
+        index->set_metric(parse_metric(metric_name_));
+        index->set_dimension(dim_);
+        const ConfigNode& storage = index_cfg_["storage_level"];
+        if (!storage.is_null()) {
+            std::string level = storage.as_string();
+            index->set_storage_level(level == "min" ? index->min_storage_level() : std::stoi(level));
+        }
+        return index;
+    }
+
+    // Cosine compares unit vectors, so they are normalized before encryption
+    std::vector<double> to_metric_space(std::vector<double> v) const {
+        return metric_name_ == "cosine" ? normalized(std::move(v)) : v;
+    }
+
+    static Details with(Details details, const Details& extra) {
+        details.insert(details.end(), extra.begin(), extra.end());
+        return details;
+    }
+
+    // Same keys as BenchmarkRunner.latency_details
+    static Details latency_details(std::initializer_list<const char*> ops) {
+        Details details;
+        auto summaries = LatencyRegistry::instance().summaries();
+        for (const char* op : ops) {
+            auto it = summaries.find(op);
+            if (it == summaries.end()) continue;
+            const LatencySummary& s = it->second;
+            details.insert(details.end(), {{std::string(op) + "_p50_ms", s.p50_ms}, {std::string(op) + "_p90_ms", s.p90_ms},
+                                           {std::string(op) + "_p99_ms", s.p99_ms}, {std::string(op) + "_p999_ms", s.p999_ms}});
+        }
+        return details;
+    }
+
+    void reset_phase() {
+        peak_per_phase_ = reset_peak_rss();
+        LatencyRegistry::instance().reset();
+    }
+
+    // Same figures as BenchmarkRunner.record_memory
+    void record_memory(const std::string& phase) {
+        const double mb = 1024.0 * 1024.0;
+        MemoryUsage index = index_->memory_usage();
+        double ciphertexts = 0.0;
+        for (const auto& [name, bytes] : index) {
+            if (name.find("ciphertexts_level_") != std::string::npos) ciphertexts += bytes;
+        }
+        Details m = {{"peak_rss_mb", peak_rss_bytes() / mb},
+                     {"peak_rss_per_phase", peak_per_phase_ ? 1.0 : 0.0},
+                     {"keys_mb", ctx_->memory_usage().at("total") / mb},
+                     {"index_mb", index.at("total") / mb},
+                     {"index_ciphertexts_mb", ciphertexts / mb},
+                     {"index_adjacency_mb", index.at("adjacency") / mb},
+                     {"index_overhead_mb", index.at("overhead") / mb},
+                     {"index_nodes", static_cast<double>(index_->size())}};
+        std::cout << "      [Memory] " << phase << ": peak RSS " << m[0].second << " MB (keys " << m[2].second
+                  << " MB, index " << m[3].second << " MB)" << std::endl;
+        memory_.emplace_back(phase, std::move(m));
+    }
+
+    static void banner(const std::string& title) {
+        std::string rule(60, '=');
+        std::cout << "\n" << rule << "\n" << title << "\n" << rule << std::endl;
+    }
+
+    const ConfigNode& config_;
+    const ConfigNode& index_cfg_;
+    const ConfigNode& bench_cfg_;
+    std::unique_ptr<CKKSContext> ctx_;
+    std::unique_ptr<SecureHNSWEncrypted> index_;
+    std::unique_ptr<NpyMatrix> data_;
+    std::vector<size_t> ids_;  // dataset rows in use (sample mode: a random subset)
+    std::string metric_name_;
+    int dim_ = 0;
+    int workers_ = 1;
+    bool peak_per_phase_ = false;
+    std::mt19937 rng_;
+    std::vector<TimingRow> setup_, retrieve_, update_;
+    std::vector<std::pair<std::string, Details>> memory_;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string config_path = argc > 1 ? argv[1] : "./config/config.yaml";
+    std::string output_path = argc > 2 ? argv[2] : "./results/timings.json";
+    try {
+        ConfigNode config = ConfigNode::load_file(config_path);
+        std::cout << std::string(70, '=') << "\nPP-RAG Native CKKS Benchmark Suite\n" << std::string(70, '=') << std::endl;
+        NativeBench bench(config);
+        bench.load_data();
+        bench.benchmark_setup();
+        bench.benchmark_retrieve();
+        bench.benchmark_update();
+        bench.save(output_path);
+        std::cout << "\nBenchmark Complete!" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "[pprag_bench] " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+#else
+int main() {
+    std::cerr << "SEAL not available (USE_SEAL not defined)" << std::endl;
+    return 1;
+}
+#endif
@@ -0,0 +1,82 @@
+/**
+ * precision_tracker.cpp
+ * CKKS precision diagnostics
+ *
+ * CKKS has no noise budget to query: every rescale and rotation adds error to
+ * the low bits of the message, and the only way to see how much precision
+ * survives is to decrypt and compare against the exact result. With tracking
+ * enabled, the instrumented circuits (squared distance, PolySoftmin, HomoNorm)
+ * decrypt each intermediate and compare it with a shadow plaintext computation
+ * started from the decrypted inputs. Bits are reported per step:
+ *
+ *   bits = -log2(max |decrypted - expected| / max(1, max |expected|))
+ *
+ * i.e. absolute precision for values below 1 and relative precision above.
+ * Decrypting needs the secret key and costs far more than the circuit itself,
+ * so this is a debugging mode for choosing scale_power and the modulus chain,
+ * never for benchmarks.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace pprag {
+
+/**
+ * Precision observed for one instrumented step
+ */
+struct PrecisionStats {
+    size_t count = 0;
+    double min_bits = std::numeric_limits<double>::infinity();
+    double mean_bits = 0.0;
+    double max_abs_error = 0.0;
+};
+
+class PrecisionTracker {
+public:
+    // Reported when decryption matches the shadow exactly
+    static constexpr double MAX_BITS = 64.0;
+
+    /**
+     * Compare decrypted slots against the shadow values (first expected.size() slots)
+     */
+    void record(const std::string& op, const std::vector<double>& decrypted, const std::vector<double>& expected) {
+        double err = 0.0, magnitude = 1.0;
+        size_t n = std::min(decrypted.size(), expected.size());
+        for (size_t i = 0; i < n; ++i) {
+            err = std::max(err, std::abs(decrypted[i] - expected[i]));
+            magnitude = std::max(magnitude, std::abs(expected[i]));
+        }
+        double bits = err > 0.0 ? std::min(MAX_BITS, -std::log2(err / magnitude)) : MAX_BITS;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        PrecisionStats& s = stats_[op];
+        s.count++;
+        s.min_bits = std::min(s.min_bits, bits);
+        s.mean_bits += (bits - s.mean_bits) / static_cast<double>(s.count);
+        s.max_abs_error = std::max(s.max_abs_error, err);
+    }
+
+    std::map<std::string, PrecisionStats> report() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.clear();
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, PrecisionStats> stats_;
+};
+
+} // namespace pprag
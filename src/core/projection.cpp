@@ -0,0 +1,148 @@
+/**
+ * projection.cpp
+ * Client-side dimensionality reduction for traversal ciphertexts
+ *
+ * Maps embeddings (768 / 384 / 256-d) to 64-128 dimensions before they are
+ * encrypted for graph traversal. Fewer dimensions mean fewer rotations in
+ * the distance reduction and more vectors per ciphertext; full-dimension
+ * ciphertexts are kept for the final rerank (two-stage search). Rows of the
+ * projection are orthonormal, so distances shrink by roughly out/in but
+ * their order is what traversal needs.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <cstdint>
+
+namespace pprag {
+
+class Projection {
+public:
+    Projection() = default;
+
+    /**
+     * Use the given out_dim x in_dim matrix as is
+     */
+    explicit Projection(std::vector<std::vector<double>> rows) : rows_(std::move(rows)) {
+        for (const auto& row : rows_) {
+            if (row.size() != rows_[0].size()) throw std::invalid_argument("projection rows differ in length");
+        }
+    }
+
+    /**
+     * Seeded random projection with orthonormal rows (Gaussian matrix, then Gram-Schmidt)
+     */
+    static Projection random_orthogonal(int in_dim, int out_dim, uint64_t seed = 0) {
+        check_dims(in_dim, out_dim);
+        std::mt19937_64 rng(seed);
+        std::normal_distribution<double> normal;
+        std::vector<std::vector<double>> rows(out_dim, std::vector<double>(in_dim));
+        for (auto& row : rows) {
+            for (auto& v : row) v = normal(rng);
+        }
+        orthonormalize(rows);
+        return Projection(std::move(rows));
+    }
+
+    /**
+     * PCA: the out_dim leading principal directions of data, found by
+     * subspace iteration on the covariance matrix. Fit on a sample of the
+     * collection; the covariance costs rows * in_dim^2.
+     */
+    static Projection pca(const std::vector<std::vector<double>>& data, int out_dim,
+                          int iterations = 30, uint64_t seed = 0) {
+        if (data.empty()) throw std::invalid_argument("pca: no data");
+        const int d = static_cast<int>(data[0].size());
+        check_dims(d, out_dim);
+        const double n = static_cast<double>(data.size());
+
+        std::vector<double> mean(d, 0.0);
+        for (const auto& x : data) {
+            for (int i = 0; i < d; ++i) mean[i] += x[i] / n;
+        }
+        std::vector<std::vector<double>> cov(d, std::vector<double>(d, 0.0));
+        std::vector<double> centered(d);
+        for (const auto& x : data) {
+            for (int i = 0; i < d; ++i) centered[i] = x[i] - mean[i];
+            for (int i = 0; i < d; ++i) {
+                for (int j = i; j < d; ++j) cov[i][j] += centered[i] * centered[j] / n;
+            }
+        }
+        for (int i = 0; i < d; ++i) {
+            for (int j = 0; j < i; ++j) cov[i][j] = cov[j][i];
+        }
+
+        // Rows of basis span the iterated subspace: basis <- orth(basis * cov)
+        Projection start = random_orthogonal(d, out_dim, seed);
+        std::vector<std::vector<double>> basis = start.rows_;
+        for (int it = 0; it < iterations; ++it) {
+            for (auto& row : basis) {
+                std::vector<double> next(d, 0.0);
+                for (int i = 0; i < d; ++i) {
+                    if (row[i] == 0.0) continue;
+                    for (int j = 0; j < d; ++j) next[j] += row[i] * cov[i][j];
+                }
+                row = std::move(next);
+            }
+            orthonormalize(basis);
+        }
+        return Projection(std::move(basis));
+    }
+
+    std::vector<double> apply(const std::vector<double>& vec) const {
+        if (vec.size() != static_cast<size_t>(in_dim())) {
+            throw std::invalid_argument("projection expects " + std::to_string(in_dim()) +
+                                        "-d vectors, got " + std::to_string(vec.size()));
+        }
+        std::vector<double> out(rows_.size(), 0.0);
+        for (size_t r = 0; r < rows_.size(); ++r) {
+            for (size_t i = 0; i < vec.size(); ++i) out[r] += rows_[r][i] * vec[i];
+        }
+        return out;
+    }
+
+    std::vector<std::vector<double>> apply_batch(const std::vector<std::vector<double>>& vectors) const {
+        std::vector<std::vector<double>> out;
+        out.reserve(vectors.size());
+        for (const auto& v : vectors) out.push_back(apply(v));
+        return out;
+    }
+
+    int in_dim() const { return rows_.empty() ? 0 : static_cast<int>(rows_[0].size()); }
+    int out_dim() const { return static_cast<int>(rows_.size()); }
+
+    // out_dim x in_dim matrix (kept by the client next to its keys)
+    const std::vector<std::vector<double>>& matrix() const { return rows_; }
+
+private:
+    static void check_dims(int in_dim, int out_dim) {
+        if (out_dim <= 0 || out_dim > in_dim) {
+            throw std::invalid_argument("projection dimension must be in [1, " + std::to_string(in_dim) + "]");
+        }
+    }
+
+    // Modified Gram-Schmidt over the rows
+    static void orthonormalize(std::vector<std::vector<double>>& rows) {
+        for (size_t r = 0; r < rows.size(); ++r) {
+            for (size_t p = 0; p < r; ++p) {
+                double dot = 0.0;
+                for (size_t i = 0; i < rows[r].size(); ++i) dot += rows[r][i] * rows[p][i];
+                for (size_t i = 0; i < rows[r].size(); ++i) rows[r][i] -= dot * rows[p][i];
+            }
+            double norm = 0.0;
+            for (double v : rows[r]) norm += v * v;
+            norm = std::sqrt(norm);
+            if (norm < 1e-12) throw std::runtime_error("projection: rank-deficient basis");
+            for (double& v : rows[r]) v /= norm;
+        }
+    }
+
+    std::vector<std::vector<double>> rows_;
+};
+
+} // namespace pprag
@@ -0,0 +1,79 @@
+/**
+ * query_handle.cpp
+ * Per-query preprocessing shared across searches
+ *
+ * A QueryHandle is created once per encrypted query and reused for every
+ * search issued with it (several top-k values, reranking, repeated probes).
+ * It keeps the query switched down to the index storage level and caches
+ * lower-level copies the first time a search asks for them.
+ */
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include "seal_utils.cpp"
+
+namespace pprag {
+
+#ifdef USE_SEAL
+
+/**
+ * Encrypted query plus its cached lower-level copies
+ *
+ * Safe to share between threads: the copies are built under a
+ * mutex and never change once published.
+ */
+class QueryHandle {
+public:
+    /**
+     * Take ownership of query and switch it to storage_level once
+     * (-1 = keep the encryption level)
+     */
+    QueryHandle(CKKSContext& ctx, Ciphertext query, int storage_level = -1)
+        : ctx_(&ctx), cache_(std::make_shared<Cache>()) {
+        if (storage_level >= 0) {
+            ctx.mod_switch_to_level_inplace(query, static_cast<size_t>(storage_level));
+        }
+        base_level_ = ctx.level(query);
+        query_ = std::move(query);
+    }
+
+    // Query at the level it was prepared for
+    const Ciphertext& ciphertext() const { return query_; }
+
+    size_t level() const { return base_level_; }
+
+    /**
+     * Query switched down to the given chain index. Switching only drops
+     * primes, so each lower level is derived once and then served from the
+     * cache. Levels at or above the prepared one return the query itself.
+     */
+    const Ciphertext& at_level(int level) const {
+        if (level < 0 || static_cast<size_t>(level) >= base_level_) return query_;
+        std::lock_guard<std::mutex> lock(cache_->mutex);
+        auto it = cache_->levels.find(level);
+        if (it == cache_->levels.end()) {
+            Ciphertext switched = query_;
+            ctx_->mod_switch_to_level_inplace(switched, static_cast<size_t>(level));
+            it = cache_->levels.emplace(level, std::move(switched)).first;
+        }
+        return it->second;
+    }
+
+private:
+    struct Cache {
+        std::mutex mutex;
+        std::map<int, Ciphertext> levels;   // node references stay valid on insert
+    };
+
+    CKKSContext* ctx_;
+    Ciphertext query_;
+    size_t base_level_;
+    std::shared_ptr<Cache> cache_;   // shared so handles stay copyable for the bindings
+};
+
+#endif  // USE_SEAL
+
+} // namespace pprag
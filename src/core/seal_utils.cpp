@@ -12,6 +12,15 @@
 #include <memory>
 #include <stdexcept>
 #include <cmath>
+#include <algorithm>
+#include <string>
+#include <map>
+#include <sstream>
+#include "precision_tracker.cpp"
+#include "trace.cpp"
+#include "thread_pool.cpp"
+#include "latency_histogram.cpp"
+#include "memory_usage.cpp"
 
 #ifdef USE_SEAL
 #include "seal/seal.h"
@@ -20,6 +29,31 @@ using namespace seal;
 
 namespace pprag {
 
+/**
+ * Similarity metric of an index. COSINE expects vectors normalized by the
+ * client before encryption and is then scored as an inner product.
+ */
+enum class Metric { L2, IP, COSINE };
+
+inline Metric parse_metric(const std::string& name) {
+    if (name == "l2") return Metric::L2;
+    if (name == "ip") return Metric::IP;
+    if (name == "cosine") return Metric::COSINE;
+    throw std::invalid_argument("unknown metric '" + name + "' (expected l2, ip or cosine)");
+}
+
+/**
+ * Decrypted metric score to an ascending distance: L2 is already squared
+ * distance, IP is negated, COSINE becomes 1 - cos
+ */
+inline double score_to_distance(Metric metric, double score) {
+    switch (metric) {
+        case Metric::IP: return -score;
+        case Metric::COSINE: return 1.0 - score;
+        default: return score;
+    }
+}
+
 /**
  * CKKS encryption context manager
  */
@@ -70,6 +104,8 @@ public:
      * Encrypt a single vector
      */
     Ciphertext encrypt_vector(const std::vector<double>& vec) {
+        PPRAG_TRACE_SCOPE("ckks.encrypt");
+        PPRAG_LATENCY_SCOPE("encrypt");
         Plaintext plain;
         encoder_->encode(vec, scale_, plain);
         
@@ -79,15 +115,33 @@ public:
     }
     
     /**
-     * Batch encrypt multiple vectors (each vector packed into one ciphertext)
+     * The two halves of encrypt_vector, for pipelines that run encoding
+     * and encryption on separate threads
+     */
+    Plaintext encode_vector(const std::vector<double>& vec) {
+        PPRAG_TRACE_SCOPE("ckks.encode");
+        PPRAG_LATENCY_SCOPE("encode");
+        Plaintext plain;
+        encoder_->encode(vec, scale_, plain);
+        return plain;
+    }
+    
+    Ciphertext encrypt_plaintext(const Plaintext& plain) {
+        PPRAG_TRACE_SCOPE("ckks.encrypt");
+        PPRAG_LATENCY_SCOPE("encrypt");
+        Ciphertext encrypted;
+        encryptor_->encrypt(plain, encrypted);
+        return encrypted;
+    }
+    
+    /**
+     * Batch encrypt multiple vectors (each vector packed into one ciphertext),
+     * in parallel on the module's task scheduler
      */
     std::vector<Ciphertext> encrypt_batch(const std::vector<std::vector<double>>& vectors) {
-        std::vector<Ciphertext> result;
-        result.reserve(vectors.size());
-        
-        for (const auto& vec : vectors) {
-            result.push_back(encrypt_vector(vec));
-        }
+        PPRAG_TRACE_SCOPE("ckks.encrypt_batch", "vectors", static_cast<int64_t>(vectors.size()));
+        std::vector<Ciphertext> result(vectors.size());
+        parallel_for(0, vectors.size(), [&](size_t i) { result[i] = encrypt_vector(vectors[i]); });
         return result;
     }
     
@@ -95,6 +149,8 @@ public:
      * Decrypt to a vector
      */
     std::vector<double> decrypt_vector(const Ciphertext& ct, size_t length = 0) {
+        PPRAG_TRACE_SCOPE("ckks.decrypt");
+        PPRAG_LATENCY_SCOPE("decrypt");
         Plaintext plain;
         decryptor_->decrypt(ct, plain);
         
@@ -107,6 +163,125 @@ public:
         return result;
     }
     
+    // ==================== Serialization ====================
+    
+    /**
+     * Serialize a ciphertext, compressed with SEAL's default codec
+     * (zstd when SEAL was built with it, zlib otherwise)
+     */
+    std::string serialize_ciphertext(const Ciphertext& ct) const {
+        std::ostringstream os(std::ios::binary);
+        ct.save(os, Serialization::compr_mode_default);
+        return os.str();
+    }
+    
+    Ciphertext deserialize_ciphertext(const std::string& data) const {
+        std::istringstream is(data, std::ios::binary);
+        Ciphertext ct;
+        ct.load(*context_, is);
+        return ct;
+    }
+    
+    /**
+     * Export parameters and all keys so another process can rebuild an
+     * equivalent context with import_keys(). The secret key is included
+     * because index traversal decrypts distances (leaky-distance model).
+     */
+    std::string export_keys() const {
+        std::ostringstream os(std::ios::binary);
+        auto compr = Serialization::compr_mode_default;
+        os.write(reinterpret_cast<const char*>(&scale_), sizeof(scale_));
+        context_->key_context_data()->parms().save(os, compr);
+        secret_key_.save(os, compr);
+        public_key_.save(os, compr);
+        relin_keys_.save(os, compr);
+        galois_keys_.save(os, compr);
+        return os.str();
+    }
+    
+    /**
+     * Rebuild a context from export_keys() output without generating new keys
+     */
+    static CKKSContext import_keys(const std::string& blob) {
+        std::istringstream is(blob, std::ios::binary);
+        CKKSContext ctx{ImportTag{}};
+        is.read(reinterpret_cast<char*>(&ctx.scale_), sizeof(ctx.scale_));
+        
+        EncryptionParameters parms;
+        parms.load(is);
+        ctx.poly_degree_ = parms.poly_modulus_degree();
+        ctx.context_ = std::make_shared<SEALContext>(parms);
+        
+        ctx.secret_key_.load(*ctx.context_, is);
+        ctx.public_key_.load(*ctx.context_, is);
+        ctx.relin_keys_.load(*ctx.context_, is);
+        ctx.galois_keys_.load(*ctx.context_, is);
+        if (!is) {
+            throw std::runtime_error("import_keys: truncated key blob");
+        }
+        
+        ctx.encryptor_ = std::make_shared<Encryptor>(*ctx.context_, ctx.public_key_);
+        ctx.decryptor_ = std::make_shared<Decryptor>(*ctx.context_, ctx.secret_key_);
+        ctx.evaluator_ = std::make_shared<Evaluator>(*ctx.context_);
+        ctx.encoder_ = std::make_shared<CKKSEncoder>(*ctx.context_);
+        return ctx;
+    }
+    
+    /**
+     * Key material in bytes, from the parameters: every key polynomial spans
+     * the full key modulus, a switching key holds one (b, a) pair per data
+     * prime, and the default Galois set has 2 log2(N) - 1 keys (rotations by
+     * +-2^i plus conjugation). The Galois keys dominate.
+     */
+    MemoryUsage memory_usage() const {
+        const auto& parms = context_->key_context_data()->parms();
+        size_t n = parms.poly_modulus_degree();
+        size_t primes = parms.coeff_modulus().size();
+        size_t poly = n * primes * sizeof(uint64_t);
+        size_t switching_key = (primes - 1) * 2 * poly;
+        size_t log_n = 0;
+        while ((size_t(1) << log_n) < n) ++log_n;
+        
+        MemoryUsage usage;
+        usage["secret_key"] = poly;
+        usage["public_key"] = 2 * poly;
+        usage["relin_keys"] = switching_key;
+        usage["galois_keys"] = (2 * log_n - 1) * switching_key;
+        return add_total(usage);
+    }
+    
+    // ==================== Modulus chain levels ====================
+    
+    /**
+     * Chain index of the ciphertext's current parameters
+     * (0 = last level; each level above it holds one more data prime)
+     */
+    size_t level(const Ciphertext& ct) const {
+        return context_->get_context_data(ct.parms_id())->chain_index();
+    }
+    
+    /**
+     * Chain index of freshly encrypted ciphertexts
+     */
+    size_t top_level() const {
+        return context_->first_context_data()->chain_index();
+    }
+    
+    /**
+     * Drop primes until ct sits at the given chain index (no-op if already at
+     * or below it). Returns whether ct was switched; its buffer keeps the
+     * capacity of the original level.
+     */
+    bool mod_switch_to_level_inplace(Ciphertext& ct, size_t target_level) {
+        auto ctx_data = context_->get_context_data(ct.parms_id());
+        while (ctx_data->chain_index() > target_level) {
+            ctx_data = ctx_data->next_context_data();
+        }
+        if (ctx_data->parms_id() == ct.parms_id()) return false;
+        evaluator_->mod_switch_to_inplace(ct, ctx_data->parms_id());
+        return true;
+    }
+    
     // ==================== Homomorphic operations ====================
     
     /**
@@ -126,6 +301,7 @@ public:
      * Homomorphic multiplication (requires relinearize and rescale)
      */
     Ciphertext he_multiply(const Ciphertext& ct1, const Ciphertext& ct2) {
+        PPRAG_TRACE_SCOPE("ckks.multiply");
         Ciphertext result;
         evaluator_->multiply(ct1, ct2, result);
         evaluator_->relinearize_inplace(result, relin_keys_);
@@ -146,6 +322,31 @@ public:
         return result;
     }
     
+    /**
+     * Multiply slot-wise by a plaintext vector (masks, packed tables)
+     */
+    Ciphertext he_multiply_plain_vector(const Ciphertext& ct, const std::vector<double>& values) {
+        Plaintext plain;
+        encoder_->encode(values, ct.parms_id(), ct.scale(), plain);
+
+        Ciphertext result;
+        evaluator_->multiply_plain(ct, plain, result);
+        evaluator_->rescale_to_next_inplace(result);
+        return result;
+    }
+
+    /**
+     * Subtract a plaintext vector (no level consumed)
+     */
+    Ciphertext he_subtract_plain_vector(const Ciphertext& ct, const std::vector<double>& values) {
+        Plaintext plain;
+        encoder_->encode(values, ct.parms_id(), ct.scale(), plain);
+
+        Ciphertext result;
+        evaluator_->sub_plain(ct, plain, result);
+        return result;
+    }
+
     /**
      * Homomorphic subtraction
      */
@@ -159,6 +360,7 @@ public:
      * Homomorphic squaring
      */
     Ciphertext he_square(const Ciphertext& ct) {
+        PPRAG_TRACE_SCOPE("ckks.square");
         Ciphertext result;
         evaluator_->square(ct, result);
         evaluator_->relinearize_inplace(result, relin_keys_);
@@ -170,6 +372,7 @@ public:
      * Vector rotation
      */
     Ciphertext he_rotate(const Ciphertext& ct, int steps) {
+        PPRAG_TRACE_SCOPE("ckks.rotate", "steps", steps);
         Ciphertext result;
         evaluator_->rotate_vector(ct, steps, galois_keys_, result);
         return result;
@@ -180,13 +383,27 @@ public:
     /**
      * Homomorphic inner product computation
      * Uses multiply + rotate-and-sum pattern
+     *
+     * width (a power of two, 0 = all slots) limits the sum to vectors that
+     * are zero past `width` slots: log2(width) rotations instead of
+     * log2(slots), with the result in slot 0 only
      */
-    Ciphertext he_inner_product(const Ciphertext& ct1, const Ciphertext& ct2) {
+    Ciphertext he_inner_product(const Ciphertext& ct1, const Ciphertext& ct2, size_t width = 0) {
+        PPRAG_TRACE_SCOPE("ckks.inner_product");
+        // Operands stored at different levels: bring the higher one down first
+        if (ct1.parms_id() != ct2.parms_id()) {
+            Ciphertext a = ct1, b = ct2;
+            size_t target = std::min(level(a), level(b));
+            mod_switch_to_level_inplace(a, target);
+            mod_switch_to_level_inplace(b, target);
+            return he_inner_product(a, b, width);
+        }
+        
         // Element-wise multiplication
         Ciphertext result = he_multiply(ct1, ct2);
         
         // Rotate and sum to get inner product
-        size_t slots = slot_count();
+        size_t slots = width > 0 ? std::min(width, slot_count()) : slot_count();
         for (size_t i = 1; i < slots; i *= 2) {
             Ciphertext rotated = he_rotate(result, static_cast<int>(i));
             // Align scales and add
@@ -198,23 +415,80 @@ public:
     
     /**
      * Compute squared L2 distance: ||a - b||^2
+     * (width as in he_inner_product)
      */
-    Ciphertext he_l2_distance_squared(const Ciphertext& ct1, const Ciphertext& ct2) {
+    Ciphertext he_l2_distance_squared(const Ciphertext& ct1, const Ciphertext& ct2, size_t width = 0) {
+        PPRAG_TRACE_SCOPE("ckks.l2_distance_sq");
+        // Operands stored at different levels: bring the higher one down first
+        if (ct1.parms_id() != ct2.parms_id()) {
+            Ciphertext a = ct1, b = ct2;
+            size_t target = std::min(level(a), level(b));
+            mod_switch_to_level_inplace(a, target);
+            mod_switch_to_level_inplace(b, target);
+            return he_l2_distance_squared(a, b, width);
+        }
+        size_t slots = width > 0 ? std::min(width, slot_count()) : slot_count();
+        
+        // Plaintext shadow of each step (precision diagnostics only)
+        std::vector<double> shadow_diff, shadow_sq, shadow_sum;
+        if (precision_) {
+            shadow_diff = decrypt_vector(ct1);
+            auto b = decrypt_vector(ct2);
+            for (size_t i = 0; i < shadow_diff.size(); ++i) {
+                shadow_diff[i] -= b[i];
+                shadow_sq.push_back(shadow_diff[i] * shadow_diff[i]);
+            }
+            // Slot j of the rotate-and-sum holds slots j .. j + slots - 1 (cyclic)
+            size_t n = shadow_sq.size();
+            shadow_sum.assign(n, 0.0);
+            for (size_t j = 0; j < n; ++j) {
+                for (size_t t = 0; t < slots; ++t) shadow_sum[j] += shadow_sq[(j + t) % n];
+            }
+        }
+        
         // diff = ct1 - ct2
         Ciphertext diff = he_subtract(ct1, ct2);
+        track_precision("l2_distance.sub", diff, shadow_diff);
         // diff^2
         Ciphertext diff_sq = he_square(diff);
+        track_precision("l2_distance.square", diff_sq, shadow_sq);
         
-        // sum all slots
-        size_t slots = slot_count();
+        // sum all slots (or the first `width`)
         for (size_t i = 1; i < slots; i *= 2) {
             Ciphertext rotated = he_rotate(diff_sq, static_cast<int>(i));
             match_scale_and_add_inplace(diff_sq, rotated);
         }
+        track_precision("l2_distance.sum", diff_sq, shadow_sum);
         
         return diff_sq;
     }
     
+    // ==================== Block layouts ====================
+    
+    /**
+     * Repeat the first `stride` slots of ct `copies` times (copies a power
+     * of two, slots past stride assumed zero): log2(copies) rotations
+     */
+    Ciphertext he_replicate(const Ciphertext& ct, size_t stride, size_t copies) {
+        Ciphertext result = ct;
+        for (size_t span = stride; span < stride * copies; span *= 2) {
+            Ciphertext rotated = he_rotate(result, -static_cast<int>(span));
+            evaluator_->add_inplace(result, rotated);
+        }
+        return result;
+    }
+    
+    /**
+     * Sum every block of `stride` slots (stride a power of two) into the
+     * block's first slot: log2(stride) rotations instead of log2(slots)
+     */
+    void he_block_sum_inplace(Ciphertext& ct, size_t stride) {
+        for (size_t i = 1; i < stride; i *= 2) {
+            Ciphertext rotated = he_rotate(ct, static_cast<int>(i));
+            evaluator_->add_inplace(ct, rotated);
+        }
+    }
+    
     // ==================== Helper functions ====================
     
     /**
@@ -241,23 +515,52 @@ public:
         evaluator_->add_inplace(ct1, ct2);
     }
     
+    // ==================== Precision diagnostics ====================
+    
+    /**
+     * Decrypt the intermediates of the instrumented circuits and compare them
+     * with a plaintext shadow (see precision_tracker.cpp). CKKS has no noise
+     * budget; this is how much precision a parameter set actually keeps.
+     * Debugging only: set before running circuits, never while they run.
+     */
+    void set_precision_tracking(bool enabled) {
+        precision_ = enabled ? std::make_shared<PrecisionTracker>() : nullptr;
+    }
+    
+    bool precision_tracking() const { return precision_ != nullptr; }
+    
+    // Bits of precision per instrumented step since tracking was enabled
+    std::map<std::string, PrecisionStats> precision_report() const {
+        return precision_ ? precision_->report() : std::map<std::string, PrecisionStats>{};
+    }
+    
+    void reset_precision_report() {
+        if (precision_) precision_->reset();
+    }
+    
     /**
-     * Get ciphertext noise budget (for debugging)
+     * Record one step against its shadow values (no-op unless tracking)
      */
-    int noise_budget(const Ciphertext& ct) {
-        return decryptor_->invariant_noise_budget(ct);
+    void track_precision(const std::string& op, const Ciphertext& ct, const std::vector<double>& expected) {
+        if (precision_) precision_->record(op, decrypt_vector(ct), expected);
     }
     
     // Public accessors (for other modules)
     std::shared_ptr<SEALContext> context() { return context_; }
     std::shared_ptr<Evaluator> evaluator() { return evaluator_; }
     std::shared_ptr<CKKSEncoder> encoder() { return encoder_; }
+    std::shared_ptr<Encryptor> encryptor() { return encryptor_; }
+    std::shared_ptr<Decryptor> decryptor() { return decryptor_; }
     const RelinKeys& relin_keys() { return relin_keys_; }
     const GaloisKeys& galois_keys() { return galois_keys_; }
     
     #endif  // USE_SEAL
     
 private:
+    // Empty context filled in by import_keys()
+    struct ImportTag {};
+    explicit CKKSContext(ImportTag) : scale_(0.0), poly_degree_(0) {}
+    
     #ifdef USE_SEAL
     std::shared_ptr<SEALContext> context_;
     std::shared_ptr<KeyGenerator> keygen_;
@@ -269,6 +572,7 @@ private:
     std::shared_ptr<Decryptor> decryptor_;
     std::shared_ptr<Evaluator> evaluator_;
     std::shared_ptr<CKKSEncoder> encoder_;
+    std::shared_ptr<PrecisionTracker> precision_;   // null unless diagnostics are on
     #endif
     
     double scale_;
@@ -281,7 +585,15 @@ private:
 #ifdef USE_SEAL
 namespace pprag {
     Ciphertext he_squared_distance(const Ciphertext& a, const Ciphertext& b, CKKSContext& ctx) {
+        PPRAG_LATENCY_SCOPE("distance");
         return ctx.he_l2_distance_squared(a, b);
     }
+    
+    // Encrypted metric score (one multiplication either way); see score_to_distance
+    Ciphertext he_metric_score(const Ciphertext& a, const Ciphertext& b, CKKSContext& ctx, Metric metric,
+                               size_t width = 0) {
+        PPRAG_LATENCY_SCOPE("distance");
+        return metric == Metric::L2 ? ctx.he_l2_distance_squared(a, b, width) : ctx.he_inner_product(a, b, width);
+    }
 }
 #endif
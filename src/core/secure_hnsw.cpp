@@ -7,12 +7,27 @@
 
 #include <vector>
 #include <queue>
+#include <deque>
 #include <random>
 #include <unordered_set>
+#include <unordered_map>
 #include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <tuple>
+#include <type_traits>
 #include "seal_utils.cpp"
 #include "poly_softmin.cpp"
+#include "ciphertext_arena.cpp"
+#include "query_handle.cpp"
+#include "hnsw_graph.cpp"
 
 namespace pprag {
 
@@ -30,39 +45,554 @@ struct HNSWNode {
 
 /**
  * Encrypted HNSW Index
+ *
+ * Concurrency: any number of search() calls may run while one writer
+ * (insert / remove / repair / compact) updates the graph. Writers are
+ * serialized by a mutex and never block readers. Each node's per-layer
+ * neighbor list is an immutable version swapped in atomically, so a reader
+ * always sees a consistent list for every node it expands. Memory of
+ * reclaimed nodes is only freed after all readers that could still reach
+ * them have left (two-epoch grace period).
  */
 class SecureHNSWEncrypted {
 public:
     SecureHNSWEncrypted(CKKSContext& ctx, int M = 16, int ef_construction = 200, int ef_search = 100)
         : ctx_(ctx), M_(M), ef_construction_(ef_construction), ef_search_(ef_search),
-          max_level_(0), entry_point_(-1), softmin_(4, 1.0) {
+          entry_(pack_entry(-1, 0)), storage_level_(-1), softmin_(4, 1.0) {
         level_mult_ = 1.0 / std::log(M_);
     }
     
+    ~SecureHNSWEncrypted() {
+        stop_maintenance();
+    }
+    
+    // Squared L2 distance and inner product each need one ciphertext-ciphertext multiplication
+    static constexpr int DISTANCE_DEPTH = 1;
+    
+    /**
+     * Keep stored vectors at the given chain index (-1 = encryption level).
+     * Lower levels carry fewer primes, so each node costs less memory and
+     * every NTT / key switch in the distance circuit touches fewer limbs.
+     * Nodes already in the index are switched down as well, so call this
+     * before serving searches.
+     */
+    void set_storage_level(int level) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (level >= 0 && (level < DISTANCE_DEPTH || level > static_cast<int>(ctx_.top_level()))) {
+            throw std::invalid_argument(
+                "storage level must be -1 or in [" + std::to_string(DISTANCE_DEPTH) + ", " +
+                std::to_string(ctx_.top_level()) + "]");
+        }
+        storage_level_ = level;
+        for (size_t id = 0; id < node_vectors_.size(); ++id) {
+            if (node_vectors_[id].size() > 0) apply_storage_level(id);
+        }
+    }
+    
+    int storage_level() const { return storage_level_; }
+    
+    /**
+     * Similarity metric; fixed once the index holds nodes. For COSINE the
+     * caller normalizes vectors and queries before encrypting them.
+     */
+    void set_metric(Metric metric) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (metric != metric_ && num_nodes_.load() > 0) {
+            throw std::logic_error("set_metric: index already holds nodes");
+        }
+        metric_ = metric;
+    }
+    
+    Metric metric() const { return metric_; }
+    
+    // Lowest level that still leaves room for the distance circuit
+    int min_storage_level() const { return DISTANCE_DEPTH; }
+    
+    /**
+     * Dimension of stored vectors and queries (0 = unknown). Once set, the
+     * distance reduction only sums the first dim slots rounded up to a power
+     * of two: log2(dim) rotations per hop instead of log2(slots). Vectors
+     * must then be encrypted zero-padded, as encrypt_vector does. Set it
+     * before serving searches.
+     */
+    void set_dimension(int dim) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        width_ = dim > 0 ? block_stride(dim) : 0;
+    }
+    
+    // Same for the coarse (traversal) vectors of two-stage search, e.g. after projection
+    void set_coarse_dimension(int dim) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        coarse_width_ = dim > 0 ? block_stride(dim) : 0;
+    }
+    
+    /**
+     * Reserve storage for n nodes so ingestion never reallocates
+     */
+    void reserve(size_t n) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        node_vectors_.reserve(n);
+        nodes_.reserve(n);
+    }
+    
+    /**
+     * Empty index with the same context, parameters, metric, storage level
+     * and dimension, e.g. a partial graph to build on another thread and
+     * merge() back. Two-stage settings are not copied.
+     */
+    std::unique_ptr<SecureHNSWEncrypted> empty_like() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        auto other = std::make_unique<SecureHNSWEncrypted>(ctx_, M_, ef_construction_, ef_search_);
+        other->metric_ = metric_;
+        other->storage_level_ = storage_level_;
+        other->width_ = width_;
+        return other;
+    }
+    
     // Store encrypted vectors. In memory.
     void add_encrypted_node(int id, const Ciphertext& vec, int level) {
-         if (id >= node_vectors_.size()) {
-             node_vectors_.resize(id + 1);
-             nodes_.resize(id + 1);
-         }
-         node_vectors_[id] = vec; // Copy ciphertext
-         
-         nodes_[id].id = id;
-         nodes_[id].level = level;
-         nodes_[id].neighbors.resize(level + 1);
-         
-         if (entry_point_ < 0) {
-             entry_point_ = id;
-             max_level_ = level;
-         }
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        store_node(id, vec, level);
+    }
+    
+    void add_encrypted_node(int id, Ciphertext&& vec, int level) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        store_node(id, std::move(vec), level);
+    }
+    
+    // ==================== Two-stage search ====================
+    
+    /**
+     * Enable two-stage search: graph traversal scores nodes with a second,
+     * small and fast context (e.g. poly degree 4096 with a ~25-bit scale)
+     * and only the final ef candidates are reranked under the index
+     * context. A different ring degree cannot be reached by mod switching,
+     * so every node also carries a coarse ciphertext encrypted under the
+     * coarse keys (add_coarse_vector / two-ciphertext insert). Coarse
+     * vectors are kept at the lowest level the distance circuit allows.
+     */
+    void set_coarse_context(CKKSContext& coarse) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (coarse.top_level() < static_cast<size_t>(DISTANCE_DEPTH)) {
+            throw std::invalid_argument("coarse context needs at least " +
+                                        std::to_string(DISTANCE_DEPTH) + " level for the distance circuit");
+        }
+        coarse_ctx_ = &coarse;
+    }
+    
+    bool two_stage() const { return coarse_ctx_ != nullptr; }
+    
+    /**
+     * Coarse ciphertext of an existing node (set before it can be reached
+     * by a two-stage search)
+     */
+    void add_coarse_vector(int id, const Ciphertext& vec) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        store_coarse(id, vec);
+    }
+    
+    /**
+     * Insert with both ciphertexts; the coarse one is in place before the
+     * node is linked, so concurrent two-stage searches can always score it
+     */
+    int insert(Ciphertext&& vec, Ciphertext&& coarse_vec) {
+        return insert_node(std::move(vec), &coarse_vec);
+    }
+    
+    int insert(const Ciphertext& vec, const Ciphertext& coarse_vec) {
+        return insert_node(vec, &coarse_vec);
+    }
+    
+    /**
+     * Query encrypted under the coarse keys, switched to the coarse storage level
+     */
+    QueryHandle prepare_coarse_query(const Ciphertext& coarse_query) const {
+        if (!coarse_ctx_) throw std::logic_error("prepare_coarse_query: no coarse context set");
+        return QueryHandle(*coarse_ctx_, coarse_query, DISTANCE_DEPTH);
+    }
+    
+    std::vector<int> search_two_stage(const QueryHandle& query, const QueryHandle& coarse_query, int k) {
+        std::vector<int> ids;
+        for (const auto& [dist, id] : search_two_stage_with_distances(query, coarse_query, k)) {
+            ids.push_back(id);
+        }
+        return ids;
+    }
+    
+    /**
+     * Traverse on coarse distances, then rerank the ef_search candidates by
+     * precise distance. Returned distances are the precise ones, so results
+     * merge with search_with_distances() of other shards.
+     */
+    std::vector<std::pair<double, int>> search_two_stage_with_distances(
+            const QueryHandle& query, const QueryHandle& coarse_query, int k) {
+        PPRAG_TRACE_SCOPE("hnsw.search_two_stage", "k", k);
+        PPRAG_LATENCY_SCOPE("search");
+        if (!coarse_ctx_) throw std::logic_error("search_two_stage: no coarse context set");
+        ReadGuard guard(*this);
+        
+        auto [entry, top_level] = load_entry();
+        if (entry < 0) return {};
+        if (coarse_vectors_.size() < static_cast<size_t>(num_nodes_.load())) {
+            throw std::logic_error("search_two_stage: some nodes have no coarse vector");
+        }
+        
+        const Ciphertext& cq = coarse_query.ciphertext();
+        int curr = entry;
+        for (int l = top_level; l >= 1; --l) {
+            curr = greedy_search_layer(cq, curr, 1, l, false, true)[0];
+        }
+        auto candidates = search_layer(cq, curr, ef_search_, 0, true, true);
+        
+        const Ciphertext& q = query.at_level(storage_level_);
+        for (auto& [dist, id] : candidates) {
+            dist = decrypt_and_get_dist(q, id);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        if (candidates.size() > static_cast<size_t>(k)) candidates.resize(k);
+        return candidates;
+    }
+    
+    // ==================== Incremental updates ====================
+    
+    /**
+     * Insert a new vector: allocate an ID, draw a random level and link the
+     * node into every layer it belongs to. Returns the assigned ID.
+     * IDs freed by compact() are reused before new ones are handed out.
+     */
+    int insert(Ciphertext&& vec) {
+        return insert_node(std::move(vec));
+    }
+    
+    int insert(const Ciphertext& vec) {
+        return insert_node(vec);
+    }
+    
+    /**
+     * Merge a separately built index into this one (both must use the same
+     * CKKSContext, i.e. the same keys). Nodes of other get IDs shifted by
+     * the returned offset; their ciphertexts and adjacency are copied, and
+     * tombstones are dropped. The graphs are then cross-linked by running
+     * insert-style neighbor selection into the opposite graph for every
+     * upper-layer node plus a sample_fraction of the layer-0 nodes of
+     * each side. The higher of the two entry points is kept.
+     */
+    int merge(const SecureHNSWEncrypted& other, double sample_fraction = 0.1) {
+        if (&other == this) {
+            throw std::invalid_argument("merge: cannot merge an index into itself");
+        }
+        std::scoped_lock lock(write_mutex_, other.write_mutex_);
+        // Distances are only meaningful between ciphertexts under the same keys
+        if (&other.ctx_ != &ctx_ || other.coarse_ctx_ != coarse_ctx_) {
+            throw std::invalid_argument("merge: indexes use different CKKS contexts");
+        }
+        if (other.metric_ != metric_) {
+            throw std::invalid_argument("merge: indexes use different metrics");
+        }
+        if (other.storage_level_ != storage_level_) {
+            throw std::invalid_argument("merge: storage level " + std::to_string(other.storage_level_) +
+                                        " does not match " + std::to_string(storage_level_));
+        }
+        if (other.width_ != width_) {
+            throw std::invalid_argument("merge: indexes use different dimensions");
+        }
+        if (coarse_ctx_ && other.coarse_width_ != coarse_width_) {
+            throw std::invalid_argument("merge: indexes use different coarse dimensions");
+        }
+        
+        const int offset = num_nodes_.load();
+        const int other_count = other.num_nodes_.load();
+        auto [own_entry, own_top] = load_entry();
+        auto [other_entry, other_top] = other.load_entry();
+        if (other_entry < 0) return offset;
+        
+        nodes_.reserve(offset + other_count);
+        node_vectors_.reserve(offset + other_count);
+        
+        // Copy nodes first so every remapped link points at an initialised node
+        std::vector<int> own_ids, merged_ids;
+        for (int id = 0; id < offset; ++id) {
+            if (is_live(id)) own_ids.push_back(id);
+        }
+        for (int id = 0; id < other_count; ++id) {
+            if (!other.is_live(id)) {
+                // Holes and tombstones of other stay free in the merged ID space
+                if (offset + id >= num_nodes_) num_nodes_.store(offset + id + 1);
+                free_ids_.push_back(offset + id);
+                continue;
+            }
+            if (coarse_ctx_) store_coarse(offset + id, other.coarse_vectors_[id]);
+            store_node(offset + id, other.node_vectors_[id], other.nodes_[id].level);
+            merged_ids.push_back(offset + id);
+        }
+        // Holes get empty coarse slots, so every merged ID is covered
+        if (coarse_ctx_) coarse_vectors_.resize(num_nodes_.load());
+        for (int id : merged_ids) {
+            NodeInfo& node = nodes_[id];
+            for (int l = 0; l <= node.level; ++l) {
+                std::vector<int> links;
+                for (int n : *load_links(other.nodes_[id - offset].neighbors[l])) {
+                    if (other.is_live(n)) links.push_back(n + offset);
+                }
+                set_links(id, l, std::move(links));
+            }
+        }
+        
+        if (own_entry < 0) {
+            // This index was empty: the merged graph is just other's graph
+            store_entry(other_entry + offset, other_top);
+            return offset;
+        }
+        
+        // Each side searches the other graph from that graph's own entry point
+        std::vector<int> own_sample = boundary_sample(own_ids, sample_fraction);
+        std::vector<int> merged_sample = boundary_sample(merged_ids, sample_fraction);
+        for (int id : merged_sample) cross_link(id, own_entry, own_top);
+        for (int id : own_sample) cross_link(id, other_entry + offset, other_top);
+        
+        if (other_top > own_top) store_entry(other_entry + offset, other_top);
+        return offset;
+    }
+    
+    /**
+     * Copy of the graph structure (levels, adjacency, tombstones, entry),
+     * e.g. for PlainHNSW to search the same graph in plaintext
+     */
+    HNSWGraph export_graph() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        HNSWGraph graph;
+        std::tie(graph.entry, graph.max_level) = load_entry();
+        const int n = num_nodes_.load();
+        graph.levels.resize(n);
+        graph.deleted.resize(n);
+        graph.neighbors.resize(n);
+        for (int id = 0; id < n; ++id) {
+            graph.levels[id] = nodes_[id].level;
+            graph.deleted[id] = nodes_[id].deleted.load();
+            for (int l = 0; l <= nodes_[id].level; ++l) {
+                graph.neighbors[id].push_back(*load_links(nodes_[id].neighbors[l]));
+            }
+        }
+        if (graph.entry < 0) graph.max_level = 0;
+        return graph;
+    }
+
+    /**
+     * Adopt a graph built elsewhere (e.g. by PlainHNSW on the same vectors).
+     * Every used ID must already hold its ciphertext (add_encrypted_node);
+     * levels and links are replaced by the graph's. Call before serving searches.
+     */
+    void load_graph(const HNSWGraph& graph) {
+        graph.validate();
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        const int n = static_cast<int>(graph.size());
+        if (n != num_nodes_.load()) {
+            throw std::invalid_argument("load_graph: graph has " + std::to_string(n) + " IDs, index has " +
+                                        std::to_string(num_nodes_.load()));
+        }
+        for (int id = 0; id < n; ++id) {
+            if ((graph.levels[id] >= 0) != (nodes_[id].level >= 0)) {
+                throw std::invalid_argument("load_graph: ID " + std::to_string(id) + " is used in only one of graph and index");
+            }
+        }
+
+        free_ids_.clear();
+        repair_queue_.clear();
+        in_links_.assign(n, {});
+        num_deleted_ = 0;
+        num_live_ = 0;
+        for (int id = 0; id < n; ++id) {
+            NodeInfo& node = nodes_[id];
+            if (graph.levels[id] < 0) {
+                free_ids_.push_back(id);
+                continue;
+            }
+            node.level = graph.levels[id];
+            node.neighbors.clear();
+            for (const auto& links : graph.neighbors[id]) {
+                node.neighbors.push_back(std::make_shared<const std::vector<int>>(links));
+                for (int to : links) in_links_[to].push_back(id);
+            }
+            node.deleted.store(graph.deleted[id] != 0);
+            if (graph.deleted[id]) ++num_deleted_;
+            else ++num_live_;
+        }
+        store_entry(graph.entry, graph.entry < 0 ? 0 : graph.max_level);
+    }
+
+    /**
+     * Tombstone a node. Search no longer returns it, but traversal still
+     * passes through it until the nodes linking to it are repaired and
+     * compact() runs.
+     */
+    void remove(int id) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (!is_live(id)) {
+            throw std::invalid_argument("remove: no live node with id " + std::to_string(id));
+        }
+        nodes_[id].deleted.store(true);
+        ++num_deleted_;
+        --num_live_;
+        
+        // add_link prunes full lists, so links can be one-way: the nodes to
+        // repair are the tombstone's in-links, not its own neighbors
+        std::vector<int> sources = in_links_[id];
+        std::sort(sources.begin(), sources.end());
+        sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+        repair_queue_.insert(repair_queue_.end(), sources.begin(), sources.end());
+        
+        if (id == entry_id()) choose_new_entry_point();
+    }
+    
+    /**
+     * Repair up to max_nodes queued nodes (-1 = all): replace tombstoned
+     * neighbors with the closest live nodes from the 2-hop neighborhood.
+     * Returns the number of nodes repaired.
+     */
+    int repair(int max_nodes = -1) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return repair_locked(max_nodes);
     }
     
     /**
-     * Distance between query (encrypted) and node (encrypted)
-     * Returns encrypted distance^2
+     * Drain pending repairs, drop every remaining edge to a tombstone, free
+     * the tombstoned ciphertexts and recycle their IDs.
+     * Returns the number of nodes reclaimed.
      */
-    Ciphertext encrypted_distance_sq(const Ciphertext& query, int node_id) {
-        return he_squared_distance(query, node_vectors_[node_id], ctx_);
+    int compact() {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        repair_locked(-1);
+        
+        // Unlink tombstones from every live node by publishing filtered lists
+        for (int id = 0; id < num_nodes_; ++id) {
+            NodeInfo& node = nodes_[id];
+            if (node.level < 0 || node.deleted.load()) continue;
+            for (int l = 0; l < static_cast<int>(node.neighbors.size()); ++l) {
+                auto links = load_links(node.neighbors[l]);
+                bool dirty = std::any_of(links->begin(), links->end(),
+                                         [this](int n) { return nodes_[n].deleted.load(); });
+                if (!dirty) continue;
+                
+                std::vector<int> kept;
+                for (int n : *links) {
+                    if (!nodes_[n].deleted.load()) kept.push_back(n);
+                }
+                set_links(id, l, std::move(kept));
+            }
+        }
+        
+        // Readers that started before the unlink may still hold tombstones
+        wait_for_readers();
+        
+        int reclaimed = 0;
+        for (int id = 0; id < num_nodes_; ++id) {
+            NodeInfo& node = nodes_[id];
+            if (node.level < 0 || !node.deleted.load()) continue;
+            node_vectors_.release(id);
+            if (static_cast<size_t>(id) < coarse_vectors_.size()) coarse_vectors_.release(id);
+            for (int l = 0; l < static_cast<int>(node.neighbors.size()); ++l) {
+                for (int n : *load_links(node.neighbors[l])) drop_in_link(n, id);
+            }
+            in_links_[id].clear();
+            node.reset();
+            free_ids_.push_back(id);
+            ++reclaimed;
+        }
+        num_deleted_ = 0;
+        return reclaimed;
+    }
+    
+    /**
+     * Run neighbor repair on a background thread: every interval_ms, repair
+     * up to batch queued nodes. Searches keep running while it works.
+     */
+    void start_maintenance(int interval_ms = 100, int batch = 32) {
+        stop_maintenance();
+        std::lock_guard<std::mutex> lock(maintenance_mutex_);
+        stop_maintenance_ = false;
+        maintenance_thread_ = std::thread([this, interval_ms, batch] {
+            std::unique_lock<std::mutex> lk(maintenance_mutex_);
+            while (!maintenance_cv_.wait_for(lk, std::chrono::milliseconds(interval_ms),
+                                             [this] { return stop_maintenance_; })) {
+                lk.unlock();
+                repair(batch);
+                lk.lock();
+            }
+        });
+    }
+    
+    void stop_maintenance() {
+        {
+            std::lock_guard<std::mutex> lock(maintenance_mutex_);
+            stop_maintenance_ = true;
+        }
+        maintenance_cv_.notify_all();
+        if (maintenance_thread_.joinable()) maintenance_thread_.join();
+    }
+    
+    // Number of live (non-tombstoned) nodes
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return num_live_;
+    }
+    
+    size_t num_deleted() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return num_deleted_;
+    }
+    
+    size_t pending_repairs() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return repair_queue_.size();
+    }
+    
+    /**
+     * Bytes held by the index: stored ciphertexts by chain index
+     * ("ciphertexts_level_<i>", "coarse_ciphertexts_level_<i>"), neighbor
+     * lists ("adjacency") and node table, arena slots, reverse links, ID
+     * bookkeeping and softmin ("overhead"). Tombstoned nodes count until
+     * compact() frees them. Keys are reported by CKKSContext::memory_usage().
+     */
+    MemoryUsage memory_usage() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        MemoryUsage usage;
+        size_t adjacency = 0;
+        size_t overhead = nodes_.footprint_bytes() + node_vectors_.footprint_bytes() +
+                          coarse_vectors_.footprint_bytes() + vector_bytes(free_ids_) +
+                          repair_queue_.size() * sizeof(int) + softmin_.memory_usage().at("total") +
+                          vector_bytes(in_links_);
+        for (const auto& sources : in_links_) overhead += vector_bytes(sources);
+        for (int id = 0; id < num_nodes_.load(); ++id) {
+            const NodeInfo& node = nodes_[id];
+            if (node.level < 0) continue;
+            const Ciphertext& ct = node_vectors_[id];
+            if (ct.size() > 0) usage["ciphertexts_level_" + std::to_string(ctx_.level(ct))] += ciphertext_bytes(ct);
+            if (coarse_ctx_ && static_cast<size_t>(id) < coarse_vectors_.size() && coarse_vectors_[id].size() > 0) {
+                const Ciphertext& coarse = coarse_vectors_[id];
+                usage["coarse_ciphertexts_level_" + std::to_string(coarse_ctx_->level(coarse))] += ciphertext_bytes(coarse);
+            }
+            overhead += vector_bytes(node.neighbors);
+            for (int l = 0; l <= node.level; ++l) {
+                // make_shared block: control block + vector header + elements
+                adjacency += 2 * sizeof(void*) + sizeof(std::vector<int>) +
+                             load_links(node.neighbors[l])->capacity() * sizeof(int);
+            }
+        }
+        usage["adjacency"] = adjacency;
+        usage["overhead"] = overhead;
+        return add_total(usage);
+    }
+    
+    bool is_deleted(int id) const {
+        return id >= 0 && id < num_nodes_.load() && nodes_[id].deleted.load();
+    }
+    
+    /**
+     * Encrypted metric score between query and node: squared distance for
+     * L2, inner product for IP and COSINE
+     */
+    Ciphertext encrypted_score(const Ciphertext& query, int node_id) {
+        return he_metric_score(query, node_vectors_[node_id], ctx_, metric_, width_);
     }
     
     /**
@@ -91,17 +621,55 @@ public:
         double score; // decrypted score/distance
     };
     
+    /**
+     * Prepare a query once for any number of searches: it is switched to
+     * the storage level here instead of on every call
+     */
+    QueryHandle prepare_query(const Ciphertext& query) const {
+        return QueryHandle(ctx_, query, storage_level_);
+    }
+    
     std::vector<int> search(const Ciphertext& query, int k) {
-        if (entry_point_ < 0) return {};
+        return search(prepare_query(query), k);
+    }
+    
+    std::vector<int> search(const QueryHandle& query, int k) {
+        std::vector<int> ids;
+        for (const auto& [dist, id] : search_with_distances(query, k)) {
+            ids.push_back(id);
+        }
+        return ids;
+    }
+    
+    std::vector<std::pair<double, int>> search_with_distances(const Ciphertext& query, int k) {
+        return search_with_distances(prepare_query(query), k);
+    }
+    
+    /**
+     * Top-k as ascending (distance, id) pairs, so that results of several
+     * index shards can be merged by distance
+     */
+    std::vector<std::pair<double, int>> search_with_distances(const QueryHandle& query, int k) {
+        PPRAG_TRACE_SCOPE("hnsw.search", "k", k);
+        PPRAG_LATENCY_SCOPE("search");
+        ReadGuard guard(*this);
+        
+        // Snapshot the entry point; the graph below it is read version by version
+        auto [entry, top_level] = load_entry();
+        if (entry < 0) return {};
+        
+        // Handles prepared before a storage level change get a cached switched copy
+        const Ciphertext& q = query.at_level(storage_level_);
         
-        int curr = entry_point_;
+        int curr = entry;
         
         // Traverse
-        for (int l = max_level_; l >= 1; --l) {
-            curr = greedy_search_layer(query, curr, 1, l)[0];
+        for (int l = top_level; l >= 1; --l) {
+            curr = greedy_search_layer(q, curr, 1, l)[0];
         }
         
-        auto candidates = greedy_search_layer(query, curr, ef_search_, 0);
+        // Tombstoned nodes are traversed but never returned
+        auto candidates = search_layer(q, curr, ef_search_, 0, true);
         
         // Rerank candidates by actual distance (using softmin or raw dist)
         // We actually already have their distances from search...
@@ -111,79 +679,739 @@ public:
         return candidates;
     }
     
+    /**
+     * Independent searches run as parallel tasks; each search also scores
+     * its neighbors in parallel, all on one scheduler, so queries x
+     * neighbors never exceed the pool size. Results are in query order.
+     */
+    std::vector<std::vector<int>> search_parallel(const std::vector<QueryHandle>& queries, int k) {
+        std::vector<std::vector<int>> results(queries.size());
+        parallel_for(0, queries.size(), [&](size_t i) { results[i] = search(queries[i], k); });
+        return results;
+    }
+    
+    // ==================== Query-batched search ====================
+    
+    /**
+     * Queries of dimension dim that fit one packed ciphertext: each takes a
+     * block of dim rounded up to a power of two slots
+     */
+    int max_query_batch(int dim) const {
+        return static_cast<int>(ctx_.slot_count() / block_stride(dim));
+    }
+    
+    std::vector<std::vector<int>> search_batch(const std::vector<QueryHandle>& queries, int k, int dim) {
+        std::vector<std::vector<int>> ids;
+        for (const auto& results : search_batch_with_distances(queries, k, dim)) {
+            ids.emplace_back();
+            for (const auto& [dist, id] : results) ids.back().push_back(id);
+        }
+        return ids;
+    }
+    
+    /**
+     * Search many queries together. Up to max_query_batch(dim) queries are
+     * packed into one ciphertext and walk the graph in lockstep: every round
+     * each query expands its next candidate, and every node requested in
+     * the round is scored against all packed queries with one distance op
+     * (the node is replicated into every block, then each block is summed
+     * on its own). Scores of queries that did not ask for the node yet are
+     * kept for when their frontier reaches it. Replication plus block sum
+     * need log2(copies) + log2(stride) <= log2(slots) rotations, so even a
+     * node only one query wants is no dearer than the per-query distance,
+     * which remains for a batch of one. Results are approximately those of
+     * search() per query: packed scoring rotates and sums in a different
+     * order, so CKKS noise differs and near-ties may resolve differently.
+     */
+    std::vector<std::vector<std::pair<double, int>>> search_batch_with_distances(
+            const std::vector<QueryHandle>& queries, int k, int dim) {
+        const size_t batch = static_cast<size_t>(std::max(1, max_query_batch(dim)));
+        std::vector<std::vector<std::pair<double, int>>> results;
+        results.reserve(queries.size());
+        for (size_t start = 0; start < queries.size(); start += batch) {
+            size_t count = std::min(batch, queries.size() - start);
+            for (auto& r : search_lockstep(queries, start, count, k, block_stride(dim))) {
+                results.push_back(std::move(r));
+            }
+        }
+        return results;
+    }
+    
+    // Packed (all queries) / per-query distance ops run by batch searches since the last reset
+    std::pair<size_t, size_t> batch_distance_counts() const {
+        return {batched_distance_evals_.load(), single_distance_evals_.load()};
+    }
+    
+    void reset_batch_distance_counts() {
+        batched_distance_evals_ = 0;
+        single_distance_evals_ = 0;
+    }
+    
+    // Immutable neighbor list version; writers swap in a new one atomically
+    using NeighborList = std::shared_ptr<const std::vector<int>>;
+    
     // Internal node structure
     struct NodeInfo {
-        int id;
-        int level;
-        std::vector<std::vector<int>> neighbors;
+        int id = -1;
+        int level = -1;                     // -1 = ID not in use
+        std::atomic<bool> deleted{false};   // tombstone
+        std::vector<NeighborList> neighbors;
+        
+        void reset() {
+            id = -1;
+            level = -1;
+            deleted.store(false);
+            neighbors.clear();
+        }
     };
     
 private:
-    std::vector<int> greedy_search_layer(const Ciphertext& query, int entry, int ef, int level) {
-         // Standard HNSW greedy search but with HE distance calculation + Decrypt
-         
+    // The in-place switch keeps the top-level buffer, so the node is then
+    // reallocated at its stored size
+    void apply_storage_level(size_t id) {
+        if (storage_level_ >= 0 && ctx_.mod_switch_to_level_inplace(node_vectors_[id], storage_level_)) {
+            node_vectors_.shrink_to_fit(id);
+        }
+    }
+    
+    // Vec is Ciphertext (moved in, keeps its buffer) or const Ciphertext&
+    // (copied into the arena pool)
+    template <typename Vec>
+    void store_coarse(int id, Vec&& vec) {
+        if (!coarse_ctx_) throw std::logic_error("add_coarse_vector: no coarse context set");
+        if (coarse_ctx_->mod_switch_to_level_inplace(coarse_vectors_.put(id, std::forward<Vec>(vec)), DISTANCE_DEPTH)) {
+            coarse_vectors_.shrink_to_fit(id);
+        }
+    }
+    
+    /**
+     * Writer side: store the vector and initialise the node before any
+     * neighbor list can point at it
+     */
+    template <typename Vec>
+    void store_node(int id, Vec&& vec, int level) {
+        if (id >= static_cast<int>(nodes_.capacity())) {
+            nodes_.reserve(std::max<size_t>(id + 1, nodes_.capacity() * 2));
+        }
+        node_vectors_.put(id, std::forward<Vec>(vec));
+        apply_storage_level(id);
+        
+        NodeInfo& node = nodes_[id];
+        if (node.deleted.load()) {
+            // Re-adding over a tombstone revives the slot
+            node.deleted.store(false);
+            --num_deleted_;
+            ++num_live_;
+        } else if (node.level < 0) {
+            ++num_live_;
+        }
+        if (static_cast<size_t>(id) >= in_links_.size()) in_links_.resize(id + 1);
+        node.id = id;
+        node.level = level;
+        while (static_cast<int>(node.neighbors.size()) < level + 1) {
+            node.neighbors.push_back(std::make_shared<const std::vector<int>>());
+        }
+        if (id >= num_nodes_) num_nodes_.store(id + 1);
+        
+        if (entry_id() < 0) store_entry(id, level);
+    }
+    
+    // ==================== Reader / writer coordination ====================
+    
+    static uint64_t pack_entry(int id, int level) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(level)) << 32) | static_cast<uint32_t>(id);
+    }
+    
+    std::pair<int, int> load_entry() const {
+        uint64_t e = entry_.load(std::memory_order_acquire);
+        return {static_cast<int32_t>(e & 0xffffffffu), static_cast<int32_t>(e >> 32)};
+    }
+    
+    int entry_id() const { return load_entry().first; }
+    
+    void store_entry(int id, int level) {
+        entry_.store(pack_entry(id, level), std::memory_order_release);
+    }
+    
+    static NeighborList load_links(const NeighborList& slot) {
+        return std::atomic_load(&slot);
+    }
+    
+    static void publish(NeighborList& slot, std::vector<int> links) {
+        std::atomic_store(&slot, NeighborList(std::make_shared<const std::vector<int>>(std::move(links))));
+    }
+    
+    /**
+     * Writer side: swap in id's list on one layer and keep the reverse
+     * links of the nodes it gained or dropped in step
+     */
+    void set_links(int id, int level, std::vector<int> links) {
+        NeighborList old = load_links(nodes_[id].neighbors[level]);
+        for (int n : *old) {
+            if (std::find(links.begin(), links.end(), n) == links.end()) drop_in_link(n, id);
+        }
+        for (int n : links) {
+            if (std::find(old->begin(), old->end(), n) == old->end()) in_links_[n].push_back(id);
+        }
+        publish(nodes_[id].neighbors[level], std::move(links));
+    }
+    
+    // One entry of from in to's reverse links (there is one per layer with the edge)
+    void drop_in_link(int to, int from) {
+        auto& sources = in_links_[to];
+        auto it = std::find(sources.begin(), sources.end(), from);
+        if (it != sources.end()) {
+            *it = sources.back();
+            sources.pop_back();
+        }
+    }
+    
+    /**
+     * Registers a search in the current epoch for its whole duration
+     */
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const SecureHNSWEncrypted& index) : index_(index) {
+            for (;;) {
+                unsigned e = index_.epoch_.load();
+                index_.readers_[e & 1].fetch_add(1);
+                if (index_.epoch_.load() == e) {
+                    slot_ = e & 1;
+                    return;
+                }
+                index_.readers_[e & 1].fetch_sub(1);
+            }
+        }
+        ~ReadGuard() { index_.readers_[slot_].fetch_sub(1); }
+    private:
+        const SecureHNSWEncrypted& index_;
+        unsigned slot_;
+    };
+    
+    /**
+     * Writer-side grace period: flip the epoch and wait until every reader
+     * that entered under the previous epoch has finished
+     */
+    void wait_for_readers() {
+        unsigned e = epoch_.fetch_add(1);
+        while (readers_[e & 1].load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+    
+    std::vector<int> greedy_search_layer(const Ciphertext& query, int entry, int ef, int level,
+                                         bool live_only = false, bool coarse = false) {
+         std::vector<int> res_vec;
+         for (const auto& [dist, id] : search_layer(query, entry, ef, level, live_only, coarse)) {
+             res_vec.push_back(id);
+         }
+         return res_vec;
+    }
+    
+    /**
+     * Standard HNSW layer search with HE distance calculation + Decrypt.
+     * Returns up to ef (distance, id) pairs sorted by ascending distance.
+     * With live_only, tombstoned nodes are expanded but kept out of the results.
+     * With coarse, query is under the coarse keys and scored against the coarse vectors.
+     */
+    std::vector<std::pair<double, int>> search_layer(const Ciphertext& query, int entry, int ef, int level,
+                                                     bool live_only, bool coarse = false) {
+         PPRAG_TRACE_SCOPE("hnsw.search_layer", "level", level);
          std::unordered_set<int> visited;
-         std::priority_queue<std::pair<double, int>> candidates; // max-heap
-         std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::greater<>> results; // min-heap
+         std::priority_queue<std::pair<double, int>> candidates; // max-heap on -dist (closest first)
+         std::priority_queue<std::pair<double, int>> results;    // max-heap on dist (worst on top)
          
-         double d = decrypt_and_get_dist(query, entry);
+         double d = decrypt_and_get_dist(query, entry, coarse);
          
          candidates.push({-d, entry});
-         results.push({d, entry});
+         if (!live_only || !nodes_[entry].deleted.load()) results.push({d, entry});
          visited.insert(entry);
          
          while (!candidates.empty()) {
              auto [neg_dist, curr] = candidates.top();
              candidates.pop();
              
-             if (-neg_dist > results.top().first && results.size() >= ef) break;
+             if (static_cast<int>(results.size()) >= ef && -neg_dist > results.top().first) break;
              
-             // Explore neighbors
-             for (int neighbor : nodes_[curr].neighbors[level]) {
-                 if (visited.count(neighbor)) continue;
-                 visited.insert(neighbor);
-                 
-                 double dist = decrypt_and_get_dist(query, neighbor);
-                 
-                 if (results.size() < ef || dist < results.top().first) {
+             // Explore neighbors (one consistent version of curr's list). Their
+             // distances are independent, so they are scored on the task
+             // scheduler and then visited in list order as before
+             NeighborList links = load_links(nodes_[curr].neighbors[level]);
+             std::vector<int> fresh;
+             for (int neighbor : *links) {
+                 if (visited.insert(neighbor).second) fresh.push_back(neighbor);
+             }
+             std::vector<double> dists(fresh.size());
+             parallel_for(0, fresh.size(), [&](size_t i) { dists[i] = decrypt_and_get_dist(query, fresh[i], coarse); });
+             
+             for (size_t i = 0; i < fresh.size(); ++i) {
+                 int neighbor = fresh[i];
+                 double dist = dists[i];
+                 if (static_cast<int>(results.size()) < ef || dist < results.top().first) {
                      candidates.push({-dist, neighbor});
+                     if (live_only && nodes_[neighbor].deleted.load()) continue;
                      results.push({dist, neighbor});
-                     if (results.size() > ef) results.pop();
+                     if (static_cast<int>(results.size()) > ef) results.pop();
                  }
              }
          }
          
-         std::vector<int> res_vec;
-         while(!results.empty()) {
-             res_vec.push_back(results.top().second);
+         std::vector<std::pair<double, int>> res_vec;
+         while (!results.empty()) {
+             res_vec.push_back(results.top());
              results.pop();
          }
          std::reverse(res_vec.begin(), res_vec.end());
          return res_vec;
     }
     
-    double decrypt_and_get_dist(const Ciphertext& query, int id) {
-        // 1. Compute Encrypted Squared Distance
-        Ciphertext dist_enc = encrypted_distance_sq(query, id);
+    // ==================== Lockstep batch traversal ====================
+    
+    static size_t block_stride(int dim) {
+        if (dim <= 0) throw std::invalid_argument("query dimension must be positive");
+        size_t stride = 1;
+        while (stride < static_cast<size_t>(dim)) stride *= 2;
+        return stride;
+    }
+    
+    /**
+     * One query's best-first search state; the batch driver feeds it the
+     * distances of the neighbors it asked for
+     */
+    struct BatchLane {
+        using Entry = std::pair<double, int>;
+        
+        const Ciphertext* query = nullptr;
+        int level = 0;
+        int ef = 1;
+        bool done = false;
+        std::unordered_set<int> visited;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<>> candidates; // closest on top
+        std::priority_queue<Entry> results;                                        // worst on top
+        std::vector<int> pending; // nodes whose distances this lane waits for
+        
+        bool live_only() const { return level == 0; }
+    };
+    
+    /**
+     * Advance a lane to its next expansion: fill lane.pending with the
+     * unvisited neighbors of its best candidate, moving down a layer when
+     * the current one is exhausted. Marks the lane done after layer 0.
+     */
+    void propose(BatchLane& lane) {
+        lane.pending.clear();
+        while (lane.pending.empty() && !lane.done) {
+            bool exhausted = lane.candidates.empty() ||
+                (static_cast<int>(lane.results.size()) >= lane.ef &&
+                 lane.candidates.top().first > lane.results.top().first);
+            if (exhausted) {
+                if (lane.level == 0) {
+                    lane.done = true;
+                    break;
+                }
+                // Closest node of this layer enters the next one with its known distance
+                BatchLane::Entry best = lane.results.top();
+                while (!lane.results.empty()) {
+                    best = lane.results.top();
+                    lane.results.pop();
+                }
+                --lane.level;
+                lane.ef = lane.level == 0 ? ef_search_ : 1;
+                lane.visited = {best.second};
+                lane.candidates = {};
+                lane.candidates.push(best);
+                if (!lane.live_only() || !nodes_[best.second].deleted.load()) lane.results.push(best);
+                continue;
+            }
+            int curr = lane.candidates.top().second;
+            lane.candidates.pop();
+            NeighborList links = load_links(nodes_[curr].neighbors[lane.level]);
+            for (int neighbor : *links) {
+                if (lane.visited.insert(neighbor).second) lane.pending.push_back(neighbor);
+            }
+        }
+    }
+    
+    void accept(BatchLane& lane, int node, double dist) {
+        if (static_cast<int>(lane.results.size()) < lane.ef || dist < lane.results.top().first) {
+            lane.candidates.push({dist, node});
+            if (lane.live_only() && nodes_[node].deleted.load()) return;
+            lane.results.push({dist, node});
+            if (static_cast<int>(lane.results.size()) > lane.ef) lane.results.pop();
+        }
+    }
+    
+    std::vector<std::vector<std::pair<double, int>>> search_lockstep(
+            const std::vector<QueryHandle>& queries, size_t start, size_t count, int k, size_t stride) {
+        ReadGuard guard(*this);
+        std::vector<std::vector<std::pair<double, int>>> out(count);
+        auto [entry, top_level] = load_entry();
+        if (entry < 0) return out;
+        
+        std::vector<BatchLane> lanes(count);
+        for (size_t j = 0; j < count; ++j) {
+            lanes[j].query = &queries[start + j].at_level(storage_level_);
+            lanes[j].level = top_level;
+            lanes[j].ef = top_level == 0 ? ef_search_ : 1;
+            lanes[j].visited = {entry};
+            lanes[j].pending = {entry};
+        }
+        Ciphertext packed = pack_queries(lanes, stride);
+        size_t copies = 1;
+        while (copies < count) copies *= 2;
+        
+        std::vector<double> lane_dists(count);
+        std::vector<std::vector<size_t>> requesters;
+        std::vector<int> order;
+        std::unordered_map<int, size_t> slot_of;
+        std::unordered_map<int, std::vector<double>> scored;
+        while (true) {
+            // Group this round's requests by node
+            order.clear();
+            requesters.clear();
+            slot_of.clear();
+            for (size_t j = 0; j < count; ++j) {
+                for (int node : lanes[j].pending) {
+                    auto [it, fresh] = slot_of.emplace(node, order.size());
+                    if (fresh) {
+                        order.push_back(node);
+                        requesters.emplace_back();
+                    }
+                    requesters[it->second].push_back(j);
+                }
+            }
+            if (order.empty()) break;
+            
+            for (size_t i = 0; i < order.size(); ++i) {
+                int node = order[i];
+                if (count == 1) {
+                    ++single_distance_evals_;
+                    accept(lanes[0], node, decrypt_and_get_dist(*lanes[0].query, node));
+                    continue;
+                }
+                // One op scores the node against every packed query; lanes
+                // that reach it in a later round reuse the decrypted scores
+                auto cached = scored.find(node);
+                if (cached == scored.end()) {
+                    cached = scored.emplace(node, ctx_.decrypt_vector(batched_score(packed, node, stride, copies))).first;
+                    ++batched_distance_evals_;
+                }
+                for (size_t j : requesters[i]) {
+                    accept(lanes[j], node, score_to_distance(metric_, cached->second[j * stride]));
+                }
+            }
+            for (auto& lane : lanes) propose(lane);
+        }
+        
+        for (size_t j = 0; j < count; ++j) {
+            auto& results = lanes[j].results;
+            while (!results.empty()) {
+                out[j].push_back(results.top());
+                results.pop();
+            }
+            std::reverse(out[j].begin(), out[j].end());
+            if (static_cast<int>(out[j].size()) > k) out[j].resize(k);
+        }
+        return out;
+    }
+    
+    /**
+     * Packed layout: query j in slots [j * stride, (j + 1) * stride)
+     */
+    Ciphertext pack_queries(const std::vector<BatchLane>& lanes, size_t stride) {
+        size_t target = ctx_.level(*lanes[0].query);
+        for (const auto& lane : lanes) target = std::min(target, ctx_.level(*lane.query));
+        
+        Ciphertext packed;
+        for (size_t j = 0; j < lanes.size(); ++j) {
+            Ciphertext q = *lanes[j].query;
+            ctx_.mod_switch_to_level_inplace(q, target);
+            if (j == 0) {
+                packed = std::move(q);
+            } else {
+                ctx_.he_add_inplace(packed, ctx_.he_rotate(q, -static_cast<int>(j * stride)));
+            }
+        }
+        return packed;
+    }
+    
+    /**
+     * Score one node against every packed query; block j's first slot holds
+     * the score for query j
+     */
+    Ciphertext batched_score(const Ciphertext& packed, int node, size_t stride, size_t copies) {
+        Ciphertext x = node_vectors_[node];
+        ctx_.mod_switch_to_level_inplace(x, ctx_.level(packed));
+        Ciphertext rep = ctx_.he_replicate(x, stride, copies);
+        
+        Ciphertext q = packed;
+        ctx_.mod_switch_to_level_inplace(q, ctx_.level(rep));
+        Ciphertext scores = metric_ == Metric::L2 ? ctx_.he_square(ctx_.he_subtract(q, rep))
+                                                  : ctx_.he_multiply(q, rep);
+        ctx_.he_block_sum_inplace(scores, stride);
+        return scores;
+    }
+    
+    // ==================== Graph maintenance ====================
+    
+    static constexpr int REPAIR_BUDGET_PER_INSERT = 4;
+    static constexpr int MAX_LEVEL = 16;
+    
+    int max_neighbors(int level) const {
+        return level == 0 ? 2 * M_ : M_;
+    }
+    
+    bool is_live(int id) const {
+        return id >= 0 && id < num_nodes_.load() &&
+               nodes_[id].level >= 0 && !nodes_[id].deleted.load();
+    }
+    
+    int allocate_id() {
+        if (!free_ids_.empty()) {
+            int id = free_ids_.back();
+            free_ids_.pop_back();
+            return id;
+        }
+        return num_nodes_.load();
+    }
+    
+    /**
+     * Allocate an ID, draw a random level and link the node; with coarse_vec
+     * (two-stage) the coarse ciphertext is stored first
+     */
+    template <typename Vec, typename Coarse = Ciphertext>
+    int insert_node(Vec&& vec, Coarse* coarse_vec = nullptr) {
+        PPRAG_TRACE_SCOPE("hnsw.insert");
+        PPRAG_LATENCY_SCOPE("insert");
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (coarse_vec && !coarse_ctx_) throw std::logic_error("insert: no coarse context set");
+        int id = allocate_id();
+        if (coarse_vec) {
+            if constexpr (std::is_const_v<Coarse>) store_coarse(id, *coarse_vec);
+            else store_coarse(id, std::move(*coarse_vec));
+        }
+        store_node(id, std::forward<Vec>(vec), random_level());
+        link_node(id);
+        
+        // Neighbor repair runs incrementally behind inserts
+        repair_locked(REPAIR_BUDGET_PER_INSERT);
+        return id;
+    }
+    
+    int repair_locked(int max_nodes) {
+        int repaired = 0;
+        while (!repair_queue_.empty() && (max_nodes < 0 || repaired < max_nodes)) {
+            int id = repair_queue_.front();
+            repair_queue_.pop_front();
+            if (!is_live(id)) continue;
+            repair_node(id);
+            ++repaired;
+        }
+        return repaired;
+    }
+    
+    int random_level() {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        double r = -std::log(std::max(uniform(rng_), 1e-12)) * level_mult_;
+        return std::min(static_cast<int>(r), MAX_LEVEL);
+    }
+    
+    /**
+     * Connect a freshly stored node: greedy descent to its top layer, then
+     * ef_construction search and closest-M selection on every layer below
+     */
+    void link_node(int id) {
+        PPRAG_TRACE_SCOPE("hnsw.link_node", "id", id);
+        auto [entry, top_level] = load_entry();
+        if (id == entry) return; // first node, nothing to link to
+        
+        const Ciphertext& vec = node_vectors_[id];
+        int level = nodes_[id].level;
+        int curr = entry;
+        
+        for (int l = top_level; l > level; --l) {
+            curr = greedy_search_layer(vec, curr, 1, l)[0];
+        }
+        
+        for (int l = std::min(level, top_level); l >= 0; --l) {
+            auto found = search_layer(vec, curr, ef_construction_, l, true);
+            
+            std::vector<int> links;
+            for (const auto& [dist, n] : found) {
+                if (n == id) continue;
+                links.push_back(n);
+                if (static_cast<int>(links.size()) >= M_) break;
+            }
+            // Publish the node's own list before it becomes reachable via back links
+            set_links(id, l, links);
+            for (int n : links) add_link(n, id, l);
+            
+            if (!found.empty()) curr = found[0].second;
+        }
+        
+        if (level > top_level) store_entry(id, level);
+    }
+    
+    /**
+     * Nodes used to stitch two graphs together: every upper-layer node
+     * (they route the greedy descent) plus a random fraction of the rest
+     */
+    std::vector<int> boundary_sample(const std::vector<int>& ids, double fraction) {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::vector<int> sample;
+        for (int id : ids) {
+            if (nodes_[id].level > 0 || uniform(rng_) < fraction) sample.push_back(id);
+        }
+        return sample;
+    }
+    
+    /**
+     * Insert-style neighbor selection for an existing node against the
+     * graph reachable from entry; links are added in both directions
+     */
+    void cross_link(int id, int entry, int top_level) {
+        const Ciphertext& vec = node_vectors_[id];
+        int level = nodes_[id].level;
+        int curr = entry;
+        
+        for (int l = top_level; l > level; --l) {
+            curr = greedy_search_layer(vec, curr, 1, l)[0];
+        }
+        
+        for (int l = std::min(level, top_level); l >= 0; --l) {
+            auto found = search_layer(vec, curr, ef_construction_, l, true);
+            
+            int linked = 0;
+            for (const auto& [dist, n] : found) {
+                if (n == id) continue;
+                add_link(id, n, l);
+                add_link(n, id, l);
+                if (++linked >= M_) break;
+            }
+            
+            if (!found.empty()) curr = found[0].second;
+        }
+    }
+    
+    /**
+     * Add edge from -> to on a layer, shrinking from's list to its closest
+     * max_neighbors entries when it overflows
+     */
+    void add_link(int from, int to, int level) {
+        NeighborList current = load_links(nodes_[from].neighbors[level]);
+        if (std::find(current->begin(), current->end(), to) != current->end()) return;
+        
+        std::vector<int> links(*current);
+        links.push_back(to);
+        if (static_cast<int>(links.size()) > max_neighbors(level)) {
+            links = closest_neighbors(from, links, max_neighbors(level));
+        }
+        set_links(from, level, std::move(links));
+    }
+    
+    std::vector<int> closest_neighbors(int id, const std::vector<int>& pool, int limit) {
+        std::vector<std::pair<double, int>> scored(pool.size());
+        parallel_for(0, pool.size(), [&](size_t i) {
+            scored[i] = {decrypt_and_get_dist(node_vectors_[id], pool[i]), pool[i]};
+        });
+        std::sort(scored.begin(), scored.end());
+        
+        std::vector<int> kept;
+        for (const auto& [dist, n] : scored) {
+            if (static_cast<int>(kept.size()) >= limit) break;
+            kept.push_back(n);
+        }
+        return kept;
+    }
+    
+    /**
+     * Replace tombstoned neighbors of id with the closest live candidates
+     * drawn from its live neighbors and the tombstones' own neighbors
+     */
+    void repair_node(int id) {
+        for (int l = 0; l < static_cast<int>(nodes_[id].neighbors.size()); ++l) {
+            NeighborList links = load_links(nodes_[id].neighbors[l]);
+            bool dirty = std::any_of(links->begin(), links->end(),
+                                     [this](int n) { return nodes_[n].deleted.load(); });
+            if (!dirty) continue;
+            
+            std::unordered_set<int> pool;
+            for (int n : *links) {
+                if (!nodes_[n].deleted.load()) {
+                    pool.insert(n);
+                    continue;
+                }
+                if (l >= static_cast<int>(nodes_[n].neighbors.size())) continue;
+                for (int nn : *load_links(nodes_[n].neighbors[l])) {
+                    if (nn != id && is_live(nn)) pool.insert(nn);
+                }
+            }
+            set_links(id, l,
+                      closest_neighbors(id, std::vector<int>(pool.begin(), pool.end()), max_neighbors(l)));
+        }
+    }
+    
+    void choose_new_entry_point() {
+        int best = -1;
+        int best_level = 0;
+        for (int id = 0; id < num_nodes_; ++id) {
+            if (is_live(id) && (best < 0 || nodes_[id].level > best_level)) {
+                best = id;
+                best_level = nodes_[id].level;
+            }
+        }
+        store_entry(best, best_level);
+    }
+    
+    double decrypt_and_get_dist(const Ciphertext& query, int id, bool coarse = false) {
+        PPRAG_TRACE_SCOPE("hnsw.decrypt_and_get_dist", "id", id);
+        // 1. Compute Encrypted Metric Score
+        Ciphertext dist_enc = coarse ? he_metric_score(query, coarse_vectors_[id], *coarse_ctx_, metric_, coarse_width_)
+                                     : encrypted_score(query, id);
         
         // 2. Decrypt (Leaking distance magnitude to server for traversal)
-        std::vector<double> plain = ctx_.decrypt_vector(dist_enc);
+        std::vector<double> plain = (coarse ? *coarse_ctx_ : ctx_).decrypt_vector(dist_enc);
         
-        // Sum slots if not already done? he_squared_distance does slot sum.
-        // The result is in all slots.
-        return plain[0]; 
+        // Slot sum already done by the metric circuit; the result is in all slots.
+        // Map to an ascending distance so traversal is metric-agnostic.
+        return score_to_distance(metric_, plain[0]);
     }
 
     CKKSContext& ctx_;
     int M_, ef_construction_, ef_search_;
     double level_mult_;
-    int max_level_;
-    int entry_point_;
+    std::atomic<uint64_t> entry_; // (max level << 32) | entry point ID, -1 = empty
+    int storage_level_; // chain index for stored vectors, -1 = encryption level
+    Metric metric_ = Metric::L2;
     
-    // Storage
-    std::vector<Ciphertext> node_vectors_; // Index is ID
-    std::vector<NodeInfo> nodes_;
+    // Storage (stable addresses, safe to index while the writer appends)
+    CiphertextArena node_vectors_; // Index is ID
+    size_t width_ = 0;          // slots summed by the distance reduction, 0 = all
+    size_t coarse_width_ = 0;
+    CKKSContext* coarse_ctx_ = nullptr; // two-stage search: traversal context, null = off
+    CiphertextArena coarse_vectors_;    // node vectors under the coarse keys
+    StableChunks<NodeInfo> nodes_;
+    std::atomic<int> num_nodes_{0}; // one past the highest registered ID
+    std::atomic<size_t> batched_distance_evals_{0};
+    std::atomic<size_t> single_distance_evals_{0};
     PolySoftmin softmin_;
+    
+    // Concurrency
+    mutable std::mutex write_mutex_;    // serializes writers
+    std::atomic<unsigned> epoch_{0};
+    mutable std::atomic<int> readers_[2] = {{0}, {0}};
+    std::mutex maintenance_mutex_;
+    std::condition_variable maintenance_cv_;
+    std::thread maintenance_thread_;
+    bool stop_maintenance_ = false;
+    
+    // Update bookkeeping
+    std::mt19937 rng_{std::random_device{}()};
+    std::vector<int> free_ids_;   // IDs reclaimed by compact()
+    std::deque<int> repair_queue_; // nodes that may link to tombstones
+    std::vector<std::vector<int>> in_links_; // in_links_[id] = nodes linking to id, once per layer
+    size_t num_deleted_ = 0;
+    size_t num_live_ = 0;
 };
 
 } // namespace pprag
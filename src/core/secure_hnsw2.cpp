@@ -17,8 +17,12 @@
 #include <unordered_set>
 #include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 #include "seal_utils.cpp"
 #include "poly_softmin.cpp"
+#include "ciphertext_arena.cpp"
+#include "he_compare.cpp"
 
 namespace pprag {
 
@@ -41,33 +45,99 @@ class SecureHNSWEncrypted2 {
 public:
     SecureHNSWEncrypted2(CKKSContext& ctx, int M = 16, int ef_construction = 200, int ef_search = 100)
         : ctx_(ctx), M_(M), ef_construction_(ef_construction), ef_search_(ef_search),
-          max_level_(0), entry_point_(-1), softmin_(4, 1.0), total_comm_bytes_(0) {
+          max_level_(0), entry_point_(-1), storage_level_(-1), softmin_(4, 1.0), total_comm_bytes_(0) {
         level_mult_ = 1.0 / std::log(M_);
     }
     
-    // Store encrypted vectors
-    void add_encrypted_node(int id, const Ciphertext& vec, int level) {
-        if (id >= node_vectors_.size()) {
-            node_vectors_.resize(id + 1);
-            nodes_.resize(id + 1);
+    // Squared L2 distance and inner product each need one ciphertext-ciphertext multiplication
+    static constexpr int DISTANCE_DEPTH = 1;
+    
+    /**
+     * Keep stored vectors at the given chain index (-1 = encryption level).
+     * Lower levels carry fewer primes, so each node costs less memory and
+     * every NTT / key switch in the distance circuit touches fewer limbs.
+     * Nodes already in the index are switched down as well.
+     */
+    void set_storage_level(int level) {
+        if (level >= 0 && (level < DISTANCE_DEPTH || level > static_cast<int>(ctx_.top_level()))) {
+            throw std::invalid_argument(
+                "storage level must be -1 or in [" + std::to_string(DISTANCE_DEPTH) + ", " +
+                std::to_string(ctx_.top_level()) + "]");
         }
-        node_vectors_[id] = vec; // Copy ciphertext
-        
-        nodes_[id].id = id;
-        nodes_[id].level = level;
-        nodes_[id].neighbors.resize(level + 1);
-        
-        if (entry_point_ < 0) {
-            entry_point_ = id;
-            max_level_ = level;
+        storage_level_ = level;
+        for (size_t id = 0; id < node_vectors_.size(); ++id) {
+            if (node_vectors_[id].size() > 0) apply_storage_level(id);
         }
     }
     
+    int storage_level() const { return storage_level_; }
+    
+    /**
+     * Similarity metric; fixed once the index holds nodes. For COSINE the
+     * client normalizes vectors and queries before encrypting them.
+     */
+    void set_metric(Metric metric) {
+        if (metric != metric_ && !nodes_.empty()) {
+            throw std::logic_error("set_metric: index already holds nodes");
+        }
+        metric_ = metric;
+    }
+    
+    Metric metric() const { return metric_; }
+    
+    // Lowest level that still leaves room for the distance circuit
+    int min_storage_level() const { return DISTANCE_DEPTH; }
+    
+    /**
+     * Reserve storage for n nodes so ingestion never reallocates
+     */
+    void reserve(size_t n) {
+        node_vectors_.reserve(n);
+        nodes_.reserve(n);
+    }
+    
+    // Store encrypted vectors
+    void add_encrypted_node(int id, const Ciphertext& vec, int level) {
+        register_node(id, level);
+        node_vectors_.put(id, vec); // Copy ciphertext into the arena
+        apply_storage_level(id);
+    }
+    
+    void add_encrypted_node(int id, Ciphertext&& vec, int level) {
+        register_node(id, level);
+        node_vectors_.put(id, std::move(vec)); // Adopt the caller's buffer
+        apply_storage_level(id);
+    }
+    
     /**
-     * Distance between query (encrypted) and node (encrypted)
-     * Returns encrypted distance^2
+     * Store a vector under the next free ID and link it into the graph:
+     * random level, then the closest M nodes on every layer it belongs to.
+     * Construction is server-local, so it is not counted as communication.
+     * Returns the assigned ID.
+     */
+    int insert(const Ciphertext& vec) {
+        PPRAG_TRACE_SCOPE("hnsw2.insert");
+        PPRAG_LATENCY_SCOPE("insert");
+        int id = static_cast<int>(nodes_.size());
+        add_encrypted_node(id, vec, random_level());
+        link_node(id);
+        return id;
+    }
+    
+    /**
+     * Encrypted metric score between query and node: squared distance for
+     * L2, inner product for IP and COSINE
+     */
+    Ciphertext encrypted_score(const Ciphertext& query, int node_id) {
+        return he_metric_score(query, node_vectors_[node_id], ctx_, metric_);
+    }
+    
+    /**
+     * Encrypted squared L2 distance regardless of metric (the comparison
+     * circuit needs non-negative, bounded distances)
      */
     Ciphertext encrypted_distance_sq(const Ciphertext& query, int node_id) {
+        PPRAG_TRACE_SCOPE("hnsw2.encrypted_distance_sq", "id", node_id);
         return he_squared_distance(query, node_vectors_[node_id], ctx_);
     }
     
@@ -96,31 +166,199 @@ public:
      * 4. Cloud continues navigation with client's decision
      */
     std::vector<int> search(const Ciphertext& query, int k) {
+        PPRAG_TRACE_SCOPE("hnsw2.search", "k", k);
+        PPRAG_LATENCY_SCOPE("search");
         if (entry_point_ < 0) return {};
         
+        // Match the query to the storage level once, not once per distance
+        Ciphertext query_at_storage;
+        const Ciphertext& q = match_storage_level(query, query_at_storage);
+        
         int curr = entry_point_;
         
         // Traverse upper levels
         for (int l = max_level_; l >= 1; --l) {
-            curr = greedy_search_layer_v2(query, curr, 1, l)[0];
+            curr = greedy_search_layer_v2(q, curr, 1, l)[0];
         }
         
         // Bottom layer search with ef_search_
-        auto candidates = greedy_search_layer_v2(query, curr, ef_search_, 0);
+        auto candidates = greedy_search_layer_v2(q, curr, ef_search_, 0);
         
         // Return top-k
         if (candidates.size() > k) candidates.resize(k);
         return candidates;
     }
     
+    /**
+     * Layer-0 search from a client-chosen entry point. A client holding the
+     * upper layers in plaintext (see upper_layer_nodes / get_neighbors)
+     * routes locally and sends only the entry ID with the encrypted query,
+     * so no rounds are spent on the upper layers.
+     */
+    std::vector<int> search_from(const Ciphertext& query, int entry, int k) {
+        PPRAG_TRACE_SCOPE("hnsw2.search_from", "k", k);
+        PPRAG_LATENCY_SCOPE("search");
+        if (entry < 0 || entry >= static_cast<int>(nodes_.size()) || nodes_[entry].neighbors.empty()) {
+            throw std::invalid_argument("search_from: unknown entry point " + std::to_string(entry));
+        }
+        
+        Ciphertext query_at_storage;
+        const Ciphertext& q = match_storage_level(query, query_at_storage);
+        
+        auto candidates = greedy_search_layer_v2(q, entry, ef_search_, 0);
+        if (candidates.size() > static_cast<size_t>(k)) candidates.resize(k);
+        return candidates;
+    }
+    
+    // ==================== Graph export (client routing) ====================
+    
+    int entry_point() const { return entry_point_; }
+    
+    int max_level() const { return max_level_; }
+    
+    int node_level(int id) const {
+        return id >= 0 && id < static_cast<int>(nodes_.size()) ? static_cast<int>(nodes_[id].neighbors.size()) - 1 : -1;
+    }
+    
+    /**
+     * (id, level) of every node that appears above layer 0
+     */
+    std::vector<std::pair<int, int>> upper_layer_nodes() const {
+        std::vector<std::pair<int, int>> upper;
+        for (int id = 0; id < static_cast<int>(nodes_.size()); ++id) {
+            if (node_level(id) >= 1) upper.push_back({id, node_level(id)});
+        }
+        return upper;
+    }
+    
+    const std::vector<int>& get_neighbors(int id, int level) const {
+        if (level < 0 || level > node_level(id)) {
+            throw std::invalid_argument("get_neighbors: node " + std::to_string(id) +
+                                        " has no layer " + std::to_string(level));
+        }
+        return nodes_[id].neighbors[level];
+    }
+    
+    /**
+     * Non-interactive block selection: the server packs the distances of a
+     * candidate block into one ciphertext and reduces it to an encrypted
+     * top-k mask with approximate comparisons. The client receives and
+     * decrypts a single ciphertext instead of one distance per candidate.
+     * Returned IDs are the selected candidates in block order (the mask does
+     * not reveal their relative order). Needs HECompare::select_depth()
+     * levels on the distances, so storage must stay at a high enough level.
+     * Blocks are ranked by squared L2 distance, which orders unit vectors
+     * exactly like COSINE; unnormalized IP indexes are rejected.
+     */
+    std::vector<int> search_block_topk(const Ciphertext& query, const std::vector<int>& candidate_ids, int k,
+                                       double distance_bound = 4.0, double min_gap = 0.2) {
+        check_block_metric("search_block_topk");
+        if (candidate_ids.empty()) return {};
+        HECompare cmp(ctx_, static_cast<int>(candidate_ids.size()), distance_bound, min_gap);
+        
+        Ciphertext query_at_storage;
+        const Ciphertext& q = match_storage_level(query, query_at_storage);
+        
+        // Server: distances, packing and selection, all encrypted
+        std::vector<Ciphertext> distances;
+        distances.reserve(candidate_ids.size());
+        for (int id : candidate_ids) {
+            distances.push_back(encrypted_distance_sq(q, id));
+        }
+        cmp.check_depth(distances[0], cmp.select_depth(), "search_block_topk");
+        Ciphertext mask = cmp.topk_mask(cmp.pack(distances), k);
+        
+        // Client: one ciphertext back, decrypt the mask
+        total_comm_bytes_ += CIPHERTEXT_SIZE_BYTES;
+        std::vector<double> plain = ctx_.decrypt_vector(mask);
+        
+        std::vector<int> selected;
+        for (size_t i = 0; i < candidate_ids.size(); ++i) {
+            if (plain[i] > 0.5) selected.push_back(candidate_ids[i]);
+        }
+        return selected;
+    }
+    
+    /**
+     * Client-aided baseline for the same block: every encrypted distance is
+     * sent to the client, which decrypts and sorts them
+     */
+    std::vector<int> search_block_client(const Ciphertext& query, const std::vector<int>& candidate_ids, int k) {
+        check_block_metric("search_block_client");
+        Ciphertext query_at_storage;
+        const Ciphertext& q = match_storage_level(query, query_at_storage);
+        
+        std::vector<std::pair<double, int>> scored;
+        for (int id : candidate_ids) {
+            Ciphertext enc_dist = encrypted_distance_sq(q, id);
+            total_comm_bytes_ += CIPHERTEXT_SIZE_BYTES;
+            scored.push_back({decrypt_ciphertext(enc_dist), id});
+        }
+        std::sort(scored.begin(), scored.end());
+        
+        std::vector<int> selected;
+        for (size_t i = 0; i < scored.size() && static_cast<int>(i) < k; ++i) {
+            selected.push_back(scored[i].second);
+        }
+        return selected;
+    }
+    
+    /**
+     * Candidates expanded per client round (1 = classic one-at-a-time
+     * expansion). Wider beams need fewer rounds but evaluate more distances.
+     */
+    void set_beam_width(int w) {
+        if (w < 1) throw std::invalid_argument("beam width must be >= 1");
+        beam_width_ = w;
+    }
+    
+    int beam_width() const { return beam_width_; }
+    
+    // Client round trips since the last reset
+    size_t get_rounds() const {
+        return total_rounds_;
+    }
+    
+    // Encrypted distances computed during search since the last reset
+    size_t get_distance_evaluations() const {
+        return total_distance_evals_;
+    }
+    
+    /**
+     * Bytes held by the index: stored ciphertexts by chain index
+     * ("ciphertexts_level_<i>"), neighbor lists ("adjacency") and node
+     * table, arena slots, slot masks and softmin ("overhead").
+     * Keys are reported by CKKSContext::memory_usage().
+     */
+    MemoryUsage memory_usage() const {
+        MemoryUsage usage;
+        size_t adjacency = 0;
+        size_t overhead = vector_bytes(nodes_) + node_vectors_.footprint_bytes() +
+                          vector_bytes(slot_masks_) + softmin_.memory_usage().at("total");
+        for (const Plaintext& mask : slot_masks_) {
+            overhead += mask.coeff_count() * sizeof(uint64_t);
+        }
+        for (size_t id = 0; id < nodes_.size(); ++id) {
+            const Ciphertext& ct = node_vectors_[id];
+            if (ct.size() > 0) usage["ciphertexts_level_" + std::to_string(ctx_.level(ct))] += ciphertext_bytes(ct);
+            overhead += vector_bytes(nodes_[id].neighbors);
+            for (const auto& links : nodes_[id].neighbors) adjacency += vector_bytes(links);
+        }
+        usage["adjacency"] = adjacency;
+        usage["overhead"] = overhead;
+        return add_total(usage);
+    }
+    
     // Get total communication cost in bytes
     size_t get_communication_bytes() const {
         return total_comm_bytes_;
     }
     
-    // Reset communication counter
+    // Reset communication, round and distance counters
     void reset_communication_counter() {
         total_comm_bytes_ = 0;
+        total_rounds_ = 0;
+        total_distance_evals_ = 0;
     }
     
     // Internal node structure
@@ -131,62 +369,102 @@ public:
     };
     
 private:
+    // The in-place switch keeps the top-level buffer, so the node is then
+    // reallocated at its stored size
+    void apply_storage_level(size_t id) {
+        if (storage_level_ >= 0 && ctx_.mod_switch_to_level_inplace(node_vectors_[id], storage_level_)) {
+            node_vectors_.shrink_to_fit(id);
+        }
+    }
+    
+    const Ciphertext& match_storage_level(const Ciphertext& query, Ciphertext& scratch) {
+        if (storage_level_ < 0 || ctx_.level(query) <= static_cast<size_t>(storage_level_)) {
+            return query;
+        }
+        scratch = query;
+        ctx_.mod_switch_to_level_inplace(scratch, storage_level_);
+        return scratch;
+    }
+    
+    void register_node(int id, int level) {
+        if (id >= static_cast<int>(nodes_.size())) {
+            nodes_.resize(id + 1);
+        }
+        
+        nodes_[id].id = id;
+        nodes_[id].level = level;
+        nodes_[id].neighbors.resize(level + 1);
+        
+        if (entry_point_ < 0) {
+            entry_point_ = id;
+            max_level_ = level;
+        }
+    }
+    
     /**
      * Variant 2: Layer search with simulated client-aided decryption
      * 
-     * Flow:
-     * 1. Server: Compute encrypted distances for neighbors (server-side)
-     * 2. Server: Send encrypted distances to client (count communication)
-     * 3. Client: Decrypt intermediate distances and pick next candidates
-     * 4. Continue with selected candidates
+     * Flow (one client round per iteration):
+     * 1. Server: Take the best beam_width_ unexpanded candidates
+     * 2. Server: Compute encrypted distances for all their unvisited neighbors
+     * 3. Server: Send the distances to the client, packed into as few
+     *    ciphertexts as the slot count allows when a level is left for the
+     *    packing mask, otherwise one ciphertext per distance
+     * 4. Client: Decrypt and return the distances used to pick the next candidates
      */
     std::vector<int> greedy_search_layer_v2(const Ciphertext& query, int entry, int ef, int level) {
+        PPRAG_TRACE_SCOPE("hnsw2.search_layer", "level", level);
         std::unordered_set<int> visited;
-        std::priority_queue<std::pair<double, int>> candidates; // max-heap by negative distance
-        std::priority_queue<std::pair<double, int>, std::vector<std::pair<double, int>>, std::greater<>> results; // min-heap
+        using Entry = std::pair<double, int>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<>> candidates; // closest on top
+        std::priority_queue<Entry> results;                                        // worst on top
         
         // Variant2: Entry point distance is decrypted (client-side)
         double entry_dist = decrypt_and_get_dist(query, entry);
+        total_comm_bytes_ += CIPHERTEXT_SIZE_BYTES;
+        ++total_rounds_;
+        ++total_distance_evals_;
         
-        candidates.push({-entry_dist, entry});
+        candidates.push({entry_dist, entry});
         results.push({entry_dist, entry});
         visited.insert(entry);
         
         while (!candidates.empty()) {
-            auto [neg_dist, curr] = candidates.top();
-            candidates.pop();
-            
-            if (-neg_dist > results.top().first && results.size() >= ef) break;
+            // Step 1: Expand the best beam_width_ candidates that can still improve the results
+            std::vector<int> expand;
+            while (!candidates.empty() && static_cast<int>(expand.size()) < beam_width_) {
+                auto [dist, curr] = candidates.top();
+                if (static_cast<int>(results.size()) >= ef && dist > results.top().first) break;
+                candidates.pop();
+                expand.push_back(curr);
+            }
+            if (expand.empty()) break;
             
-            // Step 1: Server computes encrypted distances for all neighbors
-            const auto& neighbors = nodes_[curr].neighbors[level];
+            // Step 2: Server computes encrypted distances for all their unvisited neighbors
             std::vector<int> unvisited_neighbors;
-            std::vector<Ciphertext> encrypted_distances;
-            
-            for (int neighbor : neighbors) {
-                if (visited.count(neighbor)) continue;
-                unvisited_neighbors.push_back(neighbor);
-                // Server: Compute encrypted distance
-                Ciphertext enc_dist = encrypted_distance_sq(query, neighbor);
-                encrypted_distances.push_back(enc_dist);
+            for (int curr : expand) {
+                for (int neighbor : nodes_[curr].neighbors[level]) {
+                    if (visited.insert(neighbor).second) unvisited_neighbors.push_back(neighbor);
+                }
             }
+            if (unvisited_neighbors.empty()) continue;
+            std::vector<Ciphertext> encrypted_distances(unvisited_neighbors.size());
+            parallel_for(0, unvisited_neighbors.size(), [&](size_t i) {
+                encrypted_distances[i] = encrypted_score(query, unvisited_neighbors[i]);
+            });
+            total_distance_evals_ += encrypted_distances.size();
             
-            // Step 2: Simulate client-side decryption of intermediate distances
-            // Communication cost: size of encrypted_distances sent to client
-            total_comm_bytes_ += encrypted_distances.size() * CIPHERTEXT_SIZE_BYTES;
+            // Step 3: One round trip carries every distance of this round
+            std::vector<double> dists = send_distances_to_client(encrypted_distances);
+            ++total_rounds_;
             
-            // Step 3: Client decrypts and evaluates, decides next candidates
+            // Step 4: Client-side decision: add to candidates if promising
             for (size_t i = 0; i < unvisited_neighbors.size(); ++i) {
-                int neighbor = unvisited_neighbors[i];
-                visited.insert(neighbor);
-                
-                // Client decrypts the distance
-                double dist = decrypt_ciphertext(encrypted_distances[i]);
-                
-                // Client-side decision: add to candidates if promising
-                if (results.size() < ef || dist < results.top().first) {
-                    candidates.push({-dist, neighbor});
-                    results.push({dist, neighbor});
+                double dist = dists[i];
+                if (static_cast<int>(results.size()) < ef || dist < results.top().first) {
+                    candidates.push({dist, unvisited_neighbors[i]});
+                    results.push({dist, unvisited_neighbors[i]});
+                    if (static_cast<int>(results.size()) > ef) results.pop();
                 }
             }
         }
@@ -200,10 +478,181 @@ private:
         return res_vec;
     }
     
+    /**
+     * Simulated transfer of encrypted distances to the client, which decrypts
+     * them. Each distance sits in every slot; with a level to spare, slot i
+     * of a packed ciphertext takes distance i (one plaintext mask multiply),
+     * so a round costs ceil(n / slot_count) ciphertexts instead of n.
+     */
+    std::vector<double> send_distances_to_client(const std::vector<Ciphertext>& encrypted_distances) {
+        PPRAG_TRACE_SCOPE("hnsw2.client_round", "distances", static_cast<int64_t>(encrypted_distances.size()));
+        std::vector<double> dists;
+        dists.reserve(encrypted_distances.size());
+        
+        if (encrypted_distances.size() == 1 || ctx_.level(encrypted_distances[0]) == 0) {
+            for (const auto& enc_dist : encrypted_distances) {
+                total_comm_bytes_ += CIPHERTEXT_SIZE_BYTES;
+                dists.push_back(score_to_distance(metric_, decrypt_ciphertext(enc_dist)));
+            }
+            return dists;
+        }
+        
+        size_t slots = ctx_.slot_count();
+        for (size_t start = 0; start < encrypted_distances.size(); start += slots) {
+            size_t count = std::min(slots, encrypted_distances.size() - start);
+            Ciphertext packed;
+            for (size_t i = 0; i < count; ++i) {
+                Ciphertext term;
+                ctx_.evaluator()->multiply_plain(encrypted_distances[start + i],
+                                                 slot_mask(i, encrypted_distances[start + i]), term);
+                if (i == 0) {
+                    packed = std::move(term);
+                } else {
+                    ctx_.evaluator()->add_inplace(packed, term);
+                }
+            }
+            ctx_.evaluator()->rescale_to_next_inplace(packed);
+            
+            total_comm_bytes_ += CIPHERTEXT_SIZE_BYTES;
+            std::vector<double> plain = ctx_.decrypt_vector(packed);
+            for (size_t i = 0; i < count; ++i) dists.push_back(score_to_distance(metric_, plain[i]));
+        }
+        return dists;
+    }
+    
+    /**
+     * One-hot plaintext for slot i at ct's level (cached per level)
+     */
+    const Plaintext& slot_mask(size_t i, const Ciphertext& ct) {
+        if (slot_masks_parms_ != ct.parms_id()) {
+            slot_masks_.clear();
+            slot_masks_parms_ = ct.parms_id();
+        }
+        while (slot_masks_.size() <= i) {
+            std::vector<double> onehot(ctx_.slot_count(), 0.0);
+            onehot[slot_masks_.size()] = 1.0;
+            Plaintext mask;
+            ctx_.encoder()->encode(onehot, ct.parms_id(), ctx_.scale(), mask);
+            slot_masks_.push_back(std::move(mask));
+        }
+        return slot_masks_[i];
+    }
+    
+    // ==================== Graph construction ====================
+    
+    static constexpr int MAX_LEVEL = 16;
+    
+    int random_level() {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        double r = -std::log(std::max(uniform(rng_), 1e-12)) * level_mult_;
+        return std::min(static_cast<int>(r), MAX_LEVEL);
+    }
+    
+    /**
+     * Connect a freshly stored node: greedy descent to its top layer, then
+     * ef_construction search and closest-M selection on every layer below
+     */
+    void link_node(int id) {
+        if (id == entry_point_) return; // first node, nothing to link to
+        
+        const Ciphertext& vec = node_vectors_[id];
+        int level = nodes_[id].level;
+        int curr = entry_point_;
+        
+        for (int l = max_level_; l > level; --l) {
+            curr = construction_search(vec, curr, 1, l)[0].second;
+        }
+        
+        for (int l = std::min(level, max_level_); l >= 0; --l) {
+            auto found = construction_search(vec, curr, ef_construction_, l);
+            for (const auto& [dist, n] : found) {
+                if (n == id) continue;
+                nodes_[id].neighbors[l].push_back(n);
+                add_link(n, id, l);
+                if (static_cast<int>(nodes_[id].neighbors[l].size()) >= M_) break;
+            }
+            curr = found[0].second;
+        }
+        
+        if (level > max_level_) {
+            entry_point_ = id;
+            max_level_ = level;
+        }
+    }
+    
+    void add_link(int from, int to, int level) {
+        auto& links = nodes_[from].neighbors[level];
+        links.push_back(to);
+        int limit = level == 0 ? 2 * M_ : M_;
+        if (static_cast<int>(links.size()) <= limit) return;
+        
+        // Shrink to the closest neighbors
+        std::vector<std::pair<double, int>> scored(links.size());
+        parallel_for(0, links.size(), [&](size_t i) {
+            scored[i] = {decrypt_and_get_dist(node_vectors_[from], links[i]), links[i]};
+        });
+        std::sort(scored.begin(), scored.end());
+        links.clear();
+        for (int i = 0; i < limit; ++i) links.push_back(scored[i].second);
+    }
+    
+    /**
+     * Server-local best-first layer search used while building the graph.
+     * Returns up to ef (distance, id) pairs sorted by ascending distance.
+     */
+    std::vector<std::pair<double, int>> construction_search(const Ciphertext& query, int entry, int ef, int level) {
+        using Entry = std::pair<double, int>;
+        std::unordered_set<int> visited{entry};
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<>> candidates;
+        std::priority_queue<Entry> results;
+        
+        double d = decrypt_and_get_dist(query, entry);
+        candidates.push({d, entry});
+        results.push({d, entry});
+        
+        while (!candidates.empty()) {
+            auto [dist, curr] = candidates.top();
+            candidates.pop();
+            if (static_cast<int>(results.size()) >= ef && dist > results.top().first) break;
+            
+            // Score the unvisited neighbors on the task scheduler, then visit them in order
+            std::vector<int> fresh;
+            for (int neighbor : nodes_[curr].neighbors[level]) {
+                if (visited.insert(neighbor).second) fresh.push_back(neighbor);
+            }
+            std::vector<double> dists(fresh.size());
+            parallel_for(0, fresh.size(), [&](size_t i) { dists[i] = decrypt_and_get_dist(query, fresh[i]); });
+            for (size_t i = 0; i < fresh.size(); ++i) {
+                int neighbor = fresh[i];
+                double nd = dists[i];
+                if (static_cast<int>(results.size()) < ef || nd < results.top().first) {
+                    candidates.push({nd, neighbor});
+                    results.push({nd, neighbor});
+                    if (static_cast<int>(results.size()) > ef) results.pop();
+                }
+            }
+        }
+        
+        std::vector<Entry> res_vec;
+        while (!results.empty()) {
+            res_vec.push_back(results.top());
+            results.pop();
+        }
+        std::reverse(res_vec.begin(), res_vec.end());
+        return res_vec;
+    }
+    
     double decrypt_and_get_dist(const Ciphertext& query, int id) {
-        Ciphertext dist_enc = encrypted_distance_sq(query, id);
+        PPRAG_TRACE_SCOPE("hnsw2.decrypt_and_get_dist", "id", id);
+        Ciphertext dist_enc = encrypted_score(query, id);
         std::vector<double> plain = ctx_.decrypt_vector(dist_enc);
-        return plain[0];
+        return score_to_distance(metric_, plain[0]);
+    }
+    
+    void check_block_metric(const char* op) const {
+        if (metric_ == Metric::IP) {
+            throw std::invalid_argument(std::string(op) + ": block selection ranks by L2; not available for the ip metric");
+        }
     }
     
     double decrypt_ciphertext(const Ciphertext& ct) {
@@ -216,14 +665,25 @@ private:
     double level_mult_;
     int max_level_;
     int entry_point_;
+    int storage_level_; // chain index for stored vectors, -1 = encryption level
+    Metric metric_ = Metric::L2;
     
     // Storage
-    std::vector<Ciphertext> node_vectors_; // Index is ID
+    CiphertextArena node_vectors_; // Index is ID, stable addresses
     std::vector<NodeInfo> nodes_;
     PolySoftmin softmin_;
     
     // Communication tracking
     size_t total_comm_bytes_;
+    size_t total_rounds_ = 0;
+    size_t total_distance_evals_ = 0;
+    
+    // Search protocol
+    int beam_width_ = 1;
+    std::vector<Plaintext> slot_masks_;
+    parms_id_type slot_masks_parms_{};
+    
+    std::mt19937 rng_{std::random_device{}()};
 };
 
 } // namespace pprag
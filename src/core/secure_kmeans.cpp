@@ -11,8 +11,12 @@
 #include <vector>
 #include <random>
 #include <algorithm>
+#include <numeric>
+#include <limits>
+#include <stdexcept>
 #include "poly_softmin.cpp"
 #include "homo_norm.cpp"
+#include "thread_pool.cpp"
 
 namespace pprag {
 
@@ -21,10 +25,16 @@ namespace pprag {
  */
 class SecureKMeans {
 public:
+    /**
+     * normalize_centroids keeps centroids on the unit sphere (embeddings);
+     * turn it off for data that is not normalized, e.g. PQ subvectors
+     */
     SecureKMeans(int n_clusters = 100, int max_iter = 10, 
-                 double temperature = 1.0, int softmin_degree = 4)
+                 double temperature = 1.0, int softmin_degree = 4,
+                 bool normalize_centroids = true)
         : n_clusters_(n_clusters), max_iter_(max_iter),
-          softmin_(softmin_degree, temperature), homo_norm_() {}
+          softmin_(softmin_degree, temperature), homo_norm_(),
+          normalize_centroids_(normalize_centroids) {}
     
     /**
      * Plaintext version of K-Means (for validation and benchmarking)
@@ -43,6 +53,9 @@ public:
         
         int n = vectors.size();
         int dim = vectors[0].size();
+        if (n < n_clusters_) {
+            throw std::invalid_argument("fit_plaintext: fewer vectors than clusters");
+        }
         
         ClusterResult result;
         result.assignment_time = 0;
@@ -68,14 +81,13 @@ public:
             // Soft assignment
             std::vector<std::vector<double>> weights(n);
             
-            #pragma omp parallel for
-            for (int i = 0; i < n; ++i) {
+            parallel_for(0, n, [&](size_t i) {
                 std::vector<double> distances(n_clusters_);
                 for (int c = 0; c < n_clusters_; ++c) {
                     distances[c] = euclidean_distance(vectors[i], result.centroids[c]);
                 }
                 weights[i] = softmin_.compute_plaintext(distances);
-            }
+            }, KMEANS_GRAIN);
             
             // Update centroids
             std::vector<std::vector<double>> new_centroids(n_clusters_, 
@@ -92,19 +104,21 @@ public:
             }
             
             for (int c = 0; c < n_clusters_; ++c) {
-                if (weight_sums[c] > 1e-10) {
+                if (weight_sums[c] > 1e-300) {
                     for (int d = 0; d < dim; ++d) {
                         new_centroids[c][d] /= weight_sums[c];
                     }
+                } else if (!normalize_centroids_) {
+                    continue;  // no mass: keep the previous centroid
                 }
                 // Normalize
-                result.centroids[c] = homo_norm_.normalize_plaintext(new_centroids[c]);
+                result.centroids[c] = normalize_centroids_ ? homo_norm_.normalize_plaintext(new_centroids[c])
+                                                           : new_centroids[c];
             }
         }
         
         // Hard assignment to obtain final labels
-        #pragma omp parallel for
-        for (int i = 0; i < n; ++i) {
+        parallel_for(0, n, [&](size_t i) {
             double min_dist = std::numeric_limits<double>::max();
             for (int c = 0; c < n_clusters_; ++c) {
                 double dist = euclidean_distance(vectors[i], result.centroids[c]);
@@ -113,12 +127,33 @@ public:
                     result.labels[i] = c;
                 }
             }
-        }
+        }, KMEANS_GRAIN);
         
         return result;
     }
     
+    /**
+     * Bytes held by the object; given n and dim, also the peak working set of
+     * fit_plaintext() on n vectors of that dimension (inputs not counted),
+     * which the n x n_clusters soft-assignment weights dominate
+     */
+    MemoryUsage memory_usage(size_t n = 0, size_t dim = 0) const {
+        MemoryUsage usage;
+        usage["object"] = sizeof(*this);
+        usage["softmin"] = softmin_.memory_usage().at("total");
+        if (n > 0) {
+            size_t k = static_cast<size_t>(n_clusters_);
+            usage["weights"] = n * (sizeof(std::vector<double>) + k * sizeof(double));
+            usage["centroids"] = 2 * k * (sizeof(std::vector<double>) + dim * sizeof(double));
+            usage["labels"] = 2 * n * sizeof(int);  // labels + shuffled init indices
+        }
+        return add_total(usage);
+    }
+    
 private:
+    // Plaintext rows per scheduler task; one row is far too little work to hand off
+    static constexpr size_t KMEANS_GRAIN = 64;
+    
     double euclidean_distance(const std::vector<double>& a, 
                                const std::vector<double>& b) const {
         double sum = 0.0;
@@ -133,6 +168,7 @@ private:
     int max_iter_;
     PolySoftmin softmin_;
     HomoNorm homo_norm_;
+    bool normalize_centroids_;
 };
 
 } // namespace pprag
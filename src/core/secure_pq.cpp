@@ -0,0 +1,319 @@
+/**
+ * secure_pq.cpp
+ * Encrypted product-quantization search (asymmetric distance computation)
+ *
+ * The server keeps one byte per subspace per vector (a plaintext PQ code)
+ * instead of a ~100 KB ciphertext. The client encrypts the query with
+ * subspace j in the block of S slots at j*S (S = sub_dim rounded up to a
+ * power of two); the server turns it into encrypted distance tables
+ * T[j][c] = ||q_j - centroid_{j,c}||^2 and scores codes by summing table
+ * entries, all without decrypting anything but the final scores:
+ *
+ *   1. Tables (packed): the query block (width W) is replicated G = slots/W
+ *      times; copy g is compared with centroid t*G+g of every subspace, so
+ *      one square and log2(S) rotations yield G centroids for all m
+ *      subspaces. ceil(ks/G) table ciphertexts per query.
+ *   2. Lanes: each table is masked to the block heads and spread over the S
+ *      slots of its block (S-1 rotations), so lane b of every block holds
+ *      the same entry.
+ *   3. Scores: S vectors at a time, a 0/1 plaintext mask per table selects
+ *      entry code_j(x_b) in lane b; summing the slots of each lane
+ *      (log2(slots/S) rotations) leaves vector b's distance in slot b.
+ *
+ * Depth 3 (square, lane mask, selection mask), so the context needs at
+ * least four data primes. The scan touches every code: pair it with a
+ * shortlist (candidates) for large collections. Like v1 the decrypted
+ * scores are only used for ranking.
+ *
+ * Codebooks are trained per subspace with SecureKMeans on client
+ * plaintext; codes are assigned to the nearest centroid.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "seal_utils.cpp"
+#include "secure_kmeans.cpp"
+
+#ifdef USE_SEAL
+
+namespace pprag {
+
+class SecurePQIndex {
+public:
+    // Levels consumed between the encrypted query and the scores
+    static constexpr int DEPTH = 3;
+
+    /**
+     * dim split into m subspaces of dim/m; ks centroids each (at most 256,
+     * one byte per code)
+     */
+    SecurePQIndex(CKKSContext& ctx, int dim, int m = 32, int ks = 256,
+                  int train_iters = 10, double temperature = 0.01)
+        : ctx_(ctx), dim_(dim), m_(m), ks_(ks),
+          train_iters_(train_iters), temperature_(temperature) {
+        if (dim <= 0 || m <= 0 || dim % m != 0) {
+            throw std::invalid_argument("SecurePQIndex: dim must be a positive multiple of m");
+        }
+        if (ks < 2 || ks > 256) throw std::invalid_argument("SecurePQIndex: ks must be in [2, 256]");
+        sub_dim_ = dim / m;
+        stride_ = pow2_at_least(sub_dim_);
+        width_ = pow2_at_least(m_ * stride_);
+        if (width_ > ctx_.slot_count()) {
+            throw std::invalid_argument("SecurePQIndex: query layout of " + std::to_string(width_) +
+                                        " slots exceeds " + std::to_string(ctx_.slot_count()));
+        }
+        copies_ = ctx_.slot_count() / width_;
+        tables_ = (ks_ + copies_ - 1) / copies_;
+    }
+
+    // ==================== Codebooks and codes (client side) ====================
+
+    /**
+     * Train the m codebooks on a plaintext sample (at least ks vectors)
+     */
+    void train(const std::vector<std::vector<double>>& vectors) {
+        check_rows(vectors);
+        codebooks_.assign(m_, {});
+        for (int j = 0; j < m_; ++j) {
+            std::vector<std::vector<double>> sub;
+            sub.reserve(vectors.size());
+            for (const auto& v : vectors) {
+                sub.emplace_back(v.begin() + j * sub_dim_, v.begin() + (j + 1) * sub_dim_);
+            }
+            SecureKMeans kmeans(ks_, train_iters_, temperature_, 4, false);
+            codebooks_[j] = kmeans.fit_plaintext(sub).centroids;
+        }
+    }
+
+    bool trained() const { return !codebooks_.empty(); }
+
+    /**
+     * Nearest-centroid code per subspace (m bytes per vector)
+     */
+    std::vector<uint8_t> encode(const std::vector<double>& vec) const {
+        if (!trained()) throw std::logic_error("SecurePQIndex: train() before encoding");
+        if (vec.size() != static_cast<size_t>(dim_)) throw std::invalid_argument("SecurePQIndex: wrong dimension");
+        std::vector<uint8_t> code(m_);
+        for (int j = 0; j < m_; ++j) {
+            double best = std::numeric_limits<double>::infinity();
+            for (int c = 0; c < ks_; ++c) {
+                double d = 0.0;
+                for (int i = 0; i < sub_dim_; ++i) {
+                    double diff = vec[j * sub_dim_ + i] - codebooks_[j][c][i];
+                    d += diff * diff;
+                }
+                if (d < best) { best = d; code[j] = static_cast<uint8_t>(c); }
+            }
+        }
+        return code;
+    }
+
+    /**
+     * Slot layout the query is encrypted in: subspace j at j*S, zero padded
+     */
+    std::vector<double> query_layout(const std::vector<double>& vec) const {
+        if (vec.size() != static_cast<size_t>(dim_)) throw std::invalid_argument("SecurePQIndex: wrong dimension");
+        std::vector<double> slots(m_ * stride_, 0.0);
+        for (int j = 0; j < m_; ++j) {
+            std::copy(vec.begin() + j * sub_dim_, vec.begin() + (j + 1) * sub_dim_, slots.begin() + j * stride_);
+        }
+        return slots;
+    }
+
+    // ==================== Storage (server side) ====================
+
+    /**
+     * Append codes from encode(); returns the id of the first one
+     */
+    int add_codes(const std::vector<std::vector<uint8_t>>& codes) {
+        int first = size();
+        for (const auto& code : codes) {
+            if (code.size() != static_cast<size_t>(m_)) throw std::invalid_argument("SecurePQIndex: code length != m");
+            for (uint8_t c : code) {
+                if (c >= ks_) throw std::invalid_argument("SecurePQIndex: code out of range");
+            }
+            codes_.insert(codes_.end(), code.begin(), code.end());
+        }
+        return first;
+    }
+
+    int add(const std::vector<std::vector<double>>& vectors) {
+        std::vector<std::vector<uint8_t>> codes;
+        codes.reserve(vectors.size());
+        for (const auto& v : vectors) codes.push_back(encode(v));
+        return add_codes(codes);
+    }
+
+    int size() const { return static_cast<int>(codes_.size() / m_); }
+
+    // Bytes stored per vector
+    int code_bytes() const { return m_; }
+
+    // ==================== Search ====================
+
+    std::vector<int> search(const Ciphertext& query, int k, const std::vector<int>& candidates = {}) {
+        std::vector<int> ids;
+        for (const auto& [dist, id] : search_with_distances(query, k, candidates)) {
+            ids.push_back(id);
+        }
+        return ids;
+    }
+
+    /**
+     * Top-k by approximate (PQ) squared distance over every stored code, or
+     * over candidates when given
+     */
+    std::vector<std::pair<double, int>> search_with_distances(const Ciphertext& query, int k,
+                                                              const std::vector<int>& candidates = {}) {
+        if (!trained()) throw std::logic_error("SecurePQIndex: search before train()");
+        if (ctx_.level(query) < static_cast<size_t>(DEPTH)) {
+            throw std::invalid_argument("SecurePQIndex: query needs " + std::to_string(DEPTH) +
+                                        " levels, has " + std::to_string(ctx_.level(query)));
+        }
+        std::vector<int> ids = candidates;
+        if (ids.empty()) {
+            ids.resize(size());
+            for (int i = 0; i < size(); ++i) ids[i] = i;
+        }
+        for (int id : ids) {
+            if (id < 0 || id >= size()) throw std::out_of_range("SecurePQIndex: candidate id out of range");
+        }
+
+        std::vector<Ciphertext> lanes = lane_tables(query);
+        std::vector<std::pair<double, int>> results;
+        results.reserve(ids.size());
+        for (size_t base = 0; base < ids.size(); base += stride_) {
+            size_t count = std::min(stride_, ids.size() - base);
+            std::vector<double> scores = ctx_.decrypt_vector(score_group(lanes, ids.data() + base, count), count);
+            for (size_t b = 0; b < count; ++b) results.emplace_back(scores[b], ids[base + b]);
+        }
+
+        size_t keep = std::min(results.size(), static_cast<size_t>(std::max(k, 0)));
+        std::partial_sort(results.begin(), results.begin() + keep, results.end());
+        results.resize(keep);
+        return results;
+    }
+
+    int dim() const { return dim_; }
+    int subspaces() const { return m_; }
+    int centroids() const { return ks_; }
+    int depth() const { return DEPTH; }
+
+    // Vectors scored per output ciphertext
+    int lanes() const { return static_cast<int>(stride_); }
+
+    // Distance-table ciphertexts built per query
+    int table_count() const { return static_cast<int>(tables_); }
+
+    const std::vector<std::vector<std::vector<double>>>& codebooks() const { return codebooks_; }
+
+private:
+    static size_t pow2_at_least(int n) {
+        size_t p = 1;
+        while (p < static_cast<size_t>(n)) p *= 2;
+        return p;
+    }
+
+    void check_rows(const std::vector<std::vector<double>>& vectors) const {
+        if (vectors.size() < static_cast<size_t>(ks_)) {
+            throw std::invalid_argument("SecurePQIndex: need at least ks training vectors");
+        }
+        for (const auto& v : vectors) {
+            if (v.size() != static_cast<size_t>(dim_)) throw std::invalid_argument("SecurePQIndex: wrong dimension");
+        }
+    }
+
+    /**
+     * Steps 1-2: per table t, slot g*W + j*S + b holds T[j][t*G + g] for every lane b
+     */
+    std::vector<Ciphertext> lane_tables(const Ciphertext& query) {
+        Ciphertext rep = ctx_.he_replicate(query, width_, copies_);
+
+        std::vector<double> heads(ctx_.slot_count(), 0.0);
+        for (size_t g = 0; g < copies_; ++g) {
+            for (int j = 0; j < m_; ++j) heads[g * width_ + j * stride_] = 1.0;
+        }
+
+        std::vector<Ciphertext> lanes;
+        lanes.reserve(tables_);
+        for (size_t t = 0; t < tables_; ++t) {
+            std::vector<double> packed(ctx_.slot_count(), 0.0);
+            for (size_t g = 0; g < copies_; ++g) {
+                size_t c = t * copies_ + g;
+                if (c >= static_cast<size_t>(ks_)) break;  // unused copies are never selected
+                for (int j = 0; j < m_; ++j) {
+                    std::copy(codebooks_[j][c].begin(), codebooks_[j][c].end(),
+                              packed.begin() + g * width_ + j * stride_);
+                }
+            }
+            Ciphertext table = ctx_.he_square(ctx_.he_subtract_plain_vector(rep, packed));
+            ctx_.he_block_sum_inplace(table, stride_);
+            // Only block heads hold full sums; clear the partial ones before spreading
+            table = ctx_.he_multiply_plain_vector(table, heads);
+            Ciphertext spread = table;
+            for (size_t b = 1; b < stride_; ++b) {
+                ctx_.he_add_inplace(spread, ctx_.he_rotate(table, -static_cast<int>(b)));
+            }
+            lanes.push_back(std::move(spread));
+        }
+        return lanes;
+    }
+
+    /**
+     * Step 3: scores of ids[0..count) in slots 0..count
+     */
+    Ciphertext score_group(const std::vector<Ciphertext>& lanes, const int* ids, size_t count) {
+        std::vector<std::vector<double>> masks(tables_);
+        for (size_t b = 0; b < count; ++b) {
+            const uint8_t* code = &codes_[static_cast<size_t>(ids[b]) * m_];
+            for (int j = 0; j < m_; ++j) {
+                size_t t = code[j] / copies_, g = code[j] % copies_;
+                if (masks[t].empty()) masks[t].assign(ctx_.slot_count(), 0.0);
+                masks[t][g * width_ + j * stride_ + b] = 1.0;
+            }
+        }
+
+        Ciphertext scores;
+        bool first = true;
+        for (size_t t = 0; t < tables_; ++t) {
+            if (masks[t].empty()) continue;  // no code of the group lands in this table
+            Ciphertext selected = ctx_.he_multiply_plain_vector(lanes[t], masks[t]);
+            if (first) {
+                scores = std::move(selected);
+                first = false;
+            } else {
+                ctx_.he_add_inplace(scores, selected);
+            }
+        }
+        for (size_t step = stride_; step < ctx_.slot_count(); step *= 2) {
+            ctx_.he_add_inplace(scores, ctx_.he_rotate(scores, static_cast<int>(step)));
+        }
+        return scores;
+    }
+
+    CKKSContext& ctx_;
+    int dim_;
+    int m_;
+    int ks_;
+    int sub_dim_;
+    int train_iters_;
+    double temperature_;
+    size_t stride_;   // S: slots per subspace block
+    size_t width_;    // W: query block, m * S rounded up to a power of two
+    size_t copies_;   // G: query copies per ciphertext (centroids per table)
+    size_t tables_;
+
+    std::vector<std::vector<std::vector<double>>> codebooks_;  // [subspace][centroid][sub_dim]
+    std::vector<uint8_t> codes_;                               // m bytes per vector, row-major
+};
+
+} // namespace pprag
+
+#endif // USE_SEAL
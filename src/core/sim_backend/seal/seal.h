@@ -0,0 +1,580 @@
+/**
+ * sim_backend/seal/seal.h
+ * Cost-model simulator backend: a plaintext stand-in for the SEAL API
+ *
+ * Put this directory ahead of the real SEAL headers (the pprag_core_sim
+ * target does) and the unchanged CKKSContext / HNSW code runs on it. Every
+ * "ciphertext" holds its slot values in the clear, so results equal the
+ * exact arithmetic, while levels, scales and ciphertext sizes follow the
+ * real scheme. Each evaluator, encoder and encryptor call is counted by
+ * operation and input chain index; multiplying the counts by a per-op cost
+ * table calibrated on real SEAL (measure_op_costs in the native module)
+ * predicts HE wall time without running HE.
+ *
+ * Types live in seal_sim (aliased to seal) so they never collide with real
+ * SEAL types loaded by another extension module in the same process.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define PPRAG_SIM_BACKEND 1
+
+namespace seal_sim {
+
+// ==================== Op accounting ====================
+
+namespace sim {
+
+enum class Op {
+    Encode, Decode, Encrypt, Decrypt,
+    Add, Sub, AddPlain, SubPlain, Negate,
+    Multiply, MultiplyPlain, Square, Relinearize, Rescale, ModSwitch, Rotate,
+    Count
+};
+
+inline const char* op_name(Op op) {
+    static const char* names[] = {
+        "encode", "decode", "encrypt", "decrypt",
+        "add", "sub", "add_plain", "sub_plain", "negate",
+        "multiply", "multiply_plain", "square", "relinearize", "rescale", "mod_switch", "rotate"
+    };
+    return names[static_cast<int>(op)];
+}
+
+constexpr std::size_t MAX_CHAIN = 64;
+
+// Relaxed atomics: concurrent searches count without locking
+inline std::atomic<std::uint64_t> op_counts_[static_cast<int>(Op::Count)][MAX_CHAIN];
+
+inline void record(Op op, std::size_t chain_index) {
+    op_counts_[static_cast<int>(op)][std::min(chain_index, MAX_CHAIN - 1)].fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Non-zero counts as op name -> chain index -> calls
+ */
+inline std::map<std::string, std::map<int, std::uint64_t>> op_counts() {
+    std::map<std::string, std::map<int, std::uint64_t>> counts;
+    for (int op = 0; op < static_cast<int>(Op::Count); ++op) {
+        for (std::size_t level = 0; level < MAX_CHAIN; ++level) {
+            std::uint64_t n = op_counts_[op][level].load(std::memory_order_relaxed);
+            if (n > 0) counts[op_name(static_cast<Op>(op))][static_cast<int>(level)] = n;
+        }
+    }
+    return counts;
+}
+
+inline void reset_op_counts() {
+    for (auto& per_op : op_counts_) {
+        for (auto& n : per_op) n.store(0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace sim
+
+// ==================== Parameters ====================
+
+using seal_byte = std::byte;
+using parms_id_type = std::array<std::uint64_t, 4>;
+
+enum class scheme_type : std::uint8_t { none = 0, bfv, ckks, bgv };
+enum class compr_mode_type : std::uint8_t { none = 0, zlib = 1, zstd = 2 };
+
+struct Serialization {
+    static constexpr compr_mode_type compr_mode_default = compr_mode_type::zstd;
+};
+
+enum class mm_prof_opt : std::uint64_t { DEFAULT = 0, mm_force_global = 1, mm_force_new = 2, mm_force_thread_local = 4 };
+
+class MemoryPoolHandle {
+public:
+    std::size_t alloc_byte_count() const { return 0; }
+    explicit operator bool() const { return true; }
+};
+
+struct MemoryManager {
+    static MemoryPoolHandle GetPool(mm_prof_opt = mm_prof_opt::DEFAULT) { return {}; }
+};
+
+class Modulus {
+public:
+    explicit Modulus(int bits = 60) : bits_(bits) {}
+    int bit_count() const { return bits_; }
+    // Power of two stands in for the NTT prime of the same size
+    std::uint64_t value() const { return std::uint64_t(1) << bits_; }
+
+private:
+    friend class EncryptionParameters;
+    int bits_;
+};
+
+struct CoeffModulus {
+    static std::vector<Modulus> Create(std::size_t, const std::vector<int>& bit_sizes) {
+        std::vector<Modulus> primes;
+        for (int bits : bit_sizes) primes.emplace_back(bits);
+        return primes;
+    }
+};
+
+class EncryptionParameters {
+public:
+    explicit EncryptionParameters(scheme_type scheme = scheme_type::ckks) : scheme_(scheme) {}
+
+    void set_poly_modulus_degree(std::size_t n) { poly_degree_ = n; }
+    void set_coeff_modulus(const std::vector<Modulus>& primes) { primes_ = primes; }
+    std::size_t poly_modulus_degree() const { return poly_degree_; }
+    const std::vector<Modulus>& coeff_modulus() const { return primes_; }
+    scheme_type scheme() const { return scheme_; }
+
+    std::streamoff save(std::ostream& os, compr_mode_type = Serialization::compr_mode_default) const {
+        std::uint64_t n = poly_degree_, count = primes_.size();
+        os.write(reinterpret_cast<const char*>(&n), 8);
+        os.write(reinterpret_cast<const char*>(&count), 8);
+        for (const auto& p : primes_) os.write(reinterpret_cast<const char*>(&p.bits_), sizeof(int));
+        return static_cast<std::streamoff>(16 + count * sizeof(int));
+    }
+
+    void load(std::istream& is) {
+        std::uint64_t n = 0, count = 0;
+        is.read(reinterpret_cast<char*>(&n), 8);
+        is.read(reinterpret_cast<char*>(&count), 8);
+        poly_degree_ = n;
+        primes_.assign(count, Modulus());
+        for (auto& p : primes_) is.read(reinterpret_cast<char*>(&p.bits_), sizeof(int));
+    }
+
+    // Chain index c keeps the first c + 1 primes
+    void truncate(std::size_t primes) { primes_.resize(primes); }
+
+private:
+    scheme_type scheme_;
+    std::size_t poly_degree_ = 8192;
+    std::vector<Modulus> primes_;
+};
+
+inline parms_id_type parms_id_of(std::size_t chain_index) { return {chain_index, 0x5eed, 0, 0}; }
+
+class SEALContext {
+public:
+    class ContextData {
+    public:
+        std::size_t chain_index() const { return chain_index_; }
+        const EncryptionParameters& parms() const { return parms_; }
+        parms_id_type parms_id() const { return parms_id_of(chain_index_); }
+
+        std::shared_ptr<const ContextData> next_context_data() const {
+            return chain_index_ == 0 ? nullptr : owner_->get_context_data(parms_id_of(chain_index_ - 1));
+        }
+
+    private:
+        friend class SEALContext;
+        std::size_t chain_index_ = 0;
+        const SEALContext* owner_ = nullptr;
+        EncryptionParameters parms_;
+    };
+
+    explicit SEALContext(const EncryptionParameters& parms, bool = true) : parms_(parms) {
+        if (parms.coeff_modulus().size() < 2) throw std::invalid_argument("coeff_modulus needs at least two primes");
+        // Last prime is the special (key) prime: data levels are 0 .. size - 2
+        top_ = parms.coeff_modulus().size() - 2;
+        for (std::size_t c = 0; c <= top_ + 1; ++c) {
+            auto data = std::make_shared<ContextData>();
+            data->chain_index_ = c;
+            data->owner_ = this;
+            data->parms_ = parms;
+            data->parms_.truncate(c + 1);
+            levels_.push_back(data);
+        }
+    }
+
+    SEALContext(const SEALContext&) = delete;
+    SEALContext& operator=(const SEALContext&) = delete;
+
+    std::shared_ptr<const ContextData> get_context_data(parms_id_type id) const {
+        return id[1] == 0x5eed && id[0] < levels_.size() ? levels_[id[0]] : nullptr;
+    }
+    std::shared_ptr<const ContextData> first_context_data() const { return levels_[top_]; }
+    std::shared_ptr<const ContextData> last_context_data() const { return levels_[0]; }
+    std::shared_ptr<const ContextData> key_context_data() const { return levels_[top_ + 1]; }
+    parms_id_type first_parms_id() const { return parms_id_of(top_); }
+    parms_id_type last_parms_id() const { return parms_id_of(0); }
+    bool parameters_set() const { return true; }
+
+    std::size_t slot_count() const { return parms_.poly_modulus_degree() / 2; }
+
+    // Divisor applied when rescaling away the last prime at chain index c
+    double prime(std::size_t c) const { return static_cast<double>(parms_.coeff_modulus()[c].value()); }
+
+private:
+    EncryptionParameters parms_;
+    std::size_t top_;
+    std::vector<std::shared_ptr<ContextData>> levels_;
+};
+
+// ==================== Plaintexts and ciphertexts ====================
+
+class Plaintext {
+public:
+    parms_id_type& parms_id() { return parms_id_; }
+    const parms_id_type& parms_id() const { return parms_id_; }
+    double& scale() { return scale_; }
+    double scale() const { return scale_; }
+    bool is_ntt_form() const { return true; }
+
+    // Coefficients of the real NTT-form plaintext: N per prime, N = 2 * slots
+    std::size_t coeff_count() const { return slots.empty() ? 0 : 2 * slots.size() * (parms_id_[0] + 1); }
+
+    std::vector<double> slots;
+
+private:
+    parms_id_type parms_id_{};
+    double scale_ = 1.0;
+};
+
+class Ciphertext {
+public:
+    Ciphertext() = default;
+    explicit Ciphertext(MemoryPoolHandle) {}
+
+    // Buffer bookkeeping follows SEAL's DynArray: a copy allocates exactly
+    // the source size, assignment and in-place ops only ever grow capacity
+    Ciphertext(const Ciphertext& other)
+        : slots(other.slots), parms_id_(other.parms_id_), scale_(other.scale_), size_(other.size_),
+          poly_degree_(other.poly_degree_), capacity_(other.data_size()) {}
+    Ciphertext(Ciphertext&&) = default;
+    Ciphertext& operator=(const Ciphertext& other) {
+        if (this == &other) return *this;
+        std::size_t capacity = std::max(dyn_array().capacity(), other.data_size());
+        slots = other.slots;
+        parms_id_ = other.parms_id_;
+        scale_ = other.scale_;
+        size_ = other.size_;
+        poly_degree_ = other.poly_degree_;
+        capacity_ = capacity;
+        return *this;
+    }
+    Ciphertext& operator=(Ciphertext&&) = default;
+
+    // Coefficient counts of the real ciphertext's data buffer (no data is held)
+    struct DataBuffer {
+        std::size_t used, allocated;
+        std::size_t size() const { return used; }
+        std::size_t capacity() const { return allocated; }
+    };
+    DataBuffer dyn_array() const { return {data_size(), std::max(capacity_, data_size())}; }
+
+    parms_id_type& parms_id() { return parms_id_; }
+    const parms_id_type& parms_id() const { return parms_id_; }
+    double& scale() { return scale_; }
+    double scale() const { return scale_; }
+    bool is_ntt_form() const { return true; }
+
+    // Polynomials in the ciphertext (3 after a multiplication until relinearized)
+    std::size_t size() const { return slots.empty() ? 0 : size_; }
+    std::size_t poly_modulus_degree() const { return poly_degree_; }
+    std::size_t coeff_modulus_size() const { return slots.empty() ? 0 : parms_id_[0] + 1; }
+    MemoryPoolHandle pool() const { return {}; }
+
+    // Byte size of the real ciphertext (uncompressed)
+    std::streamoff save_size(compr_mode_type = Serialization::compr_mode_default) const {
+        return static_cast<std::streamoff>(size() * poly_degree_ * coeff_modulus_size() * 8);
+    }
+
+    std::streamoff save(std::ostream& os, compr_mode_type = Serialization::compr_mode_default) const {
+        std::uint64_t n = slots.size(), meta[3] = {size_, poly_degree_, 0};
+        os.write(reinterpret_cast<const char*>(&n), 8);
+        os.write(reinterpret_cast<const char*>(slots.data()), static_cast<std::streamsize>(n * 8));
+        os.write(reinterpret_cast<const char*>(&parms_id_), sizeof(parms_id_));
+        os.write(reinterpret_cast<const char*>(&scale_), 8);
+        os.write(reinterpret_cast<const char*>(meta), sizeof(meta));
+        return static_cast<std::streamoff>(8 + n * 8 + sizeof(parms_id_) + 8 + sizeof(meta));
+    }
+
+    void load(const SEALContext&, std::istream& is) {
+        std::uint64_t n = 0, meta[3] = {};
+        is.read(reinterpret_cast<char*>(&n), 8);
+        slots.resize(n);
+        is.read(reinterpret_cast<char*>(slots.data()), static_cast<std::streamsize>(n * 8));
+        is.read(reinterpret_cast<char*>(&parms_id_), sizeof(parms_id_));
+        is.read(reinterpret_cast<char*>(&scale_), 8);
+        is.read(reinterpret_cast<char*>(meta), sizeof(meta));
+        size_ = meta[0];
+        poly_degree_ = meta[1];
+    }
+
+    std::vector<double> slots;
+
+private:
+    friend class Encryptor;
+    friend class Evaluator;
+    std::size_t data_size() const { return size() * poly_degree_ * coeff_modulus_size(); }
+
+    // In-place ops that shrink the data keep the allocation
+    void keep_capacity() { capacity_ = dyn_array().capacity(); }
+
+    parms_id_type parms_id_{};
+    double scale_ = 1.0;
+    std::size_t size_ = 2;
+    std::size_t poly_degree_ = 0;
+    std::size_t capacity_ = 0;
+};
+
+// ==================== Keys ====================
+
+// Keys carry no material; they serialize to a marker so export/import round-trips
+class KeyMarker {
+public:
+    std::streamoff save(std::ostream& os, compr_mode_type = Serialization::compr_mode_default) const {
+        os.put('K');
+        return 1;
+    }
+    void load(const SEALContext&, std::istream& is) { is.get(); }
+};
+
+class PublicKey : public KeyMarker {};
+class SecretKey : public KeyMarker {};
+class RelinKeys : public KeyMarker {};
+class GaloisKeys : public KeyMarker {};
+
+class KeyGenerator {
+public:
+    explicit KeyGenerator(const SEALContext&) {}
+    KeyGenerator(const SEALContext&, const SecretKey& sk) : secret_key_(sk) {}
+    const SecretKey& secret_key() const { return secret_key_; }
+    void create_public_key(PublicKey&) const {}
+    void create_relin_keys(RelinKeys&) const {}
+    void create_galois_keys(GaloisKeys&) const {}
+    void create_galois_keys(const std::vector<int>&, GaloisKeys&) const {}
+
+private:
+    SecretKey secret_key_;
+};
+
+// ==================== Encoder / encryptor / decryptor ====================
+
+class CKKSEncoder {
+public:
+    explicit CKKSEncoder(const SEALContext& ctx) : ctx_(&ctx) {}
+
+    std::size_t slot_count() const { return ctx_->slot_count(); }
+
+    void encode(const std::vector<double>& values, parms_id_type id, double scale, Plaintext& plain) const {
+        if (values.size() > slot_count()) throw std::invalid_argument("values has invalid size");
+        sim::record(sim::Op::Encode, id[0]);
+        plain.slots.assign(slot_count(), 0.0);
+        std::copy(values.begin(), values.end(), plain.slots.begin());
+        plain.parms_id() = id;
+        plain.scale() = scale;
+    }
+
+    void encode(const std::vector<double>& values, double scale, Plaintext& plain) const {
+        encode(values, ctx_->first_parms_id(), scale, plain);
+    }
+
+    void encode(double value, parms_id_type id, double scale, Plaintext& plain) const {
+        sim::record(sim::Op::Encode, id[0]);
+        plain.slots.assign(slot_count(), value);
+        plain.parms_id() = id;
+        plain.scale() = scale;
+    }
+
+    void encode(double value, double scale, Plaintext& plain) const {
+        encode(value, ctx_->first_parms_id(), scale, plain);
+    }
+
+    void decode(const Plaintext& plain, std::vector<double>& destination) const {
+        sim::record(sim::Op::Decode, plain.parms_id()[0]);
+        destination = plain.slots;
+    }
+
+private:
+    const SEALContext* ctx_;
+};
+
+class Encryptor {
+public:
+    Encryptor(const SEALContext& ctx, const PublicKey&) : ctx_(&ctx) {}
+
+    void encrypt(const Plaintext& plain, Ciphertext& destination) const {
+        sim::record(sim::Op::Encrypt, plain.parms_id()[0]);
+        destination.slots = plain.slots;
+        destination.parms_id_ = plain.parms_id();
+        destination.scale_ = plain.scale();
+        destination.size_ = 2;
+        destination.poly_degree_ = ctx_->slot_count() * 2;
+    }
+
+private:
+    const SEALContext* ctx_;
+};
+
+class Decryptor {
+public:
+    Decryptor(const SEALContext&, const SecretKey&) {}
+
+    void decrypt(const Ciphertext& encrypted, Plaintext& destination) const {
+        sim::record(sim::Op::Decrypt, encrypted.parms_id()[0]);
+        destination.slots = encrypted.slots;
+        destination.parms_id() = encrypted.parms_id();
+        destination.scale() = encrypted.scale();
+    }
+};
+
+// ==================== Evaluator ====================
+
+class Evaluator {
+public:
+    explicit Evaluator(const SEALContext& ctx) : ctx_(&ctx) {}
+
+    void add_inplace(Ciphertext& a, const Ciphertext& b) const {
+        check_same(a, b);
+        sim::record(sim::Op::Add, a.parms_id_[0]);
+        for (std::size_t i = 0; i < a.slots.size(); ++i) a.slots[i] += b.slots[i];
+        a.size_ = std::max(a.size_, b.size_);
+    }
+    void add(const Ciphertext& a, const Ciphertext& b, Ciphertext& r) const { r = a; add_inplace(r, b); }
+
+    void sub_inplace(Ciphertext& a, const Ciphertext& b) const {
+        check_same(a, b);
+        sim::record(sim::Op::Sub, a.parms_id_[0]);
+        for (std::size_t i = 0; i < a.slots.size(); ++i) a.slots[i] -= b.slots[i];
+        a.size_ = std::max(a.size_, b.size_);
+    }
+    void sub(const Ciphertext& a, const Ciphertext& b, Ciphertext& r) const { r = a; sub_inplace(r, b); }
+
+    void negate_inplace(Ciphertext& a) const {
+        sim::record(sim::Op::Negate, a.parms_id_[0]);
+        for (auto& x : a.slots) x = -x;
+    }
+    void negate(const Ciphertext& a, Ciphertext& r) const { r = a; negate_inplace(r); }
+
+    void add_plain_inplace(Ciphertext& a, const Plaintext& p) const {
+        check_plain(a, p, true);
+        sim::record(sim::Op::AddPlain, a.parms_id_[0]);
+        for (std::size_t i = 0; i < a.slots.size(); ++i) a.slots[i] += p.slots[i];
+    }
+    void add_plain(const Ciphertext& a, const Plaintext& p, Ciphertext& r) const { r = a; add_plain_inplace(r, p); }
+
+    void sub_plain_inplace(Ciphertext& a, const Plaintext& p) const {
+        check_plain(a, p, true);
+        sim::record(sim::Op::SubPlain, a.parms_id_[0]);
+        for (std::size_t i = 0; i < a.slots.size(); ++i) a.slots[i] -= p.slots[i];
+    }
+    void sub_plain(const Ciphertext& a, const Plaintext& p, Ciphertext& r) const { r = a; sub_plain_inplace(r, p); }
+
+    void multiply_inplace(Ciphertext& a, const Ciphertext& b) const {
+        if (a.parms_id_ != b.parms_id_) throw std::invalid_argument("encrypted1 and encrypted2 parameter mismatch");
+        if (a.size_ != 2 || b.size_ != 2) throw std::invalid_argument("multiply expects relinearized inputs");
+        sim::record(sim::Op::Multiply, a.parms_id_[0]);
+        for (std::size_t i = 0; i < a.slots.size(); ++i) a.slots[i] *= b.slots[i];
+        a.scale_ *= b.scale_;
+        a.size_ = 3;
+        check_scale(a);
+    }
+    void multiply(const Ciphertext& a, const Ciphertext& b, Ciphertext& r) const { r = a; multiply_inplace(r, b); }
+
+    void square_inplace(Ciphertext& a) const {
+        if (a.size_ != 2) throw std::invalid_argument("square expects a relinearized input");
+        sim::record(sim::Op::Square, a.parms_id_[0]);
+        for (auto& x : a.slots) x *= x;
+        a.scale_ *= a.scale_;
+        a.size_ = 3;
+        check_scale(a);
+    }
+    void square(const Ciphertext& a, Ciphertext& r) const { r = a; square_inplace(r); }
+
+    void multiply_plain_inplace(Ciphertext& a, const Plaintext& p) const {
+        check_plain(a, p, false);
+        sim::record(sim::Op::MultiplyPlain, a.parms_id_[0]);
+        for (std::size_t i = 0; i < a.slots.size(); ++i) a.slots[i] *= p.slots[i];
+        a.scale_ *= p.scale();
+        check_scale(a);
+    }
+    void multiply_plain(const Ciphertext& a, const Plaintext& p, Ciphertext& r) const { r = a; multiply_plain_inplace(r, p); }
+
+    void relinearize_inplace(Ciphertext& a, const RelinKeys&) const {
+        sim::record(sim::Op::Relinearize, a.parms_id_[0]);
+        a.keep_capacity();
+        a.size_ = 2;
+    }
+    void relinearize(const Ciphertext& a, const RelinKeys& keys, Ciphertext& r) const { r = a; relinearize_inplace(r, keys); }
+
+    void rescale_to_next_inplace(Ciphertext& a) const {
+        std::size_t c = a.parms_id_[0];
+        if (c == 0) throw std::invalid_argument("end of modulus switching chain reached");
+        sim::record(sim::Op::Rescale, c);
+        a.scale_ /= ctx_->prime(c);
+        a.keep_capacity();
+        a.parms_id_ = parms_id_of(c - 1);
+    }
+    void rescale_to_next(const Ciphertext& a, Ciphertext& r) const { r = a; rescale_to_next_inplace(r); }
+
+    void mod_switch_to_inplace(Ciphertext& a, parms_id_type id) const {
+        if (id[0] > a.parms_id_[0]) throw std::invalid_argument("cannot switch to higher level modulus");
+        for (std::size_t c = a.parms_id_[0]; c > id[0]; --c) sim::record(sim::Op::ModSwitch, c);
+        a.keep_capacity();
+        a.parms_id_ = id;
+    }
+    void mod_switch_to_next_inplace(Ciphertext& a) const {
+        if (a.parms_id_[0] == 0) throw std::invalid_argument("end of modulus switching chain reached");
+        mod_switch_to_inplace(a, parms_id_of(a.parms_id_[0] - 1));
+    }
+    void mod_switch_to(const Ciphertext& a, parms_id_type id, Ciphertext& r) const { r = a; mod_switch_to_inplace(r, id); }
+    void mod_switch_to_inplace(Plaintext& p, parms_id_type id) const { p.parms_id() = id; }
+
+    // Positive steps rotate left (slot i receives slot i + steps), as in SEAL
+    void rotate_vector(const Ciphertext& a, int steps, const GaloisKeys&, Ciphertext& r) const {
+        if (a.size_ != 2) throw std::invalid_argument("rotate expects a relinearized input");
+        sim::record(sim::Op::Rotate, a.parms_id_[0]);
+        r = a;
+        long n = static_cast<long>(a.slots.size());
+        long shift = ((steps % n) + n) % n;
+        for (long i = 0; i < n; ++i) r.slots[i] = a.slots[(i + shift) % n];
+    }
+    void rotate_vector_inplace(Ciphertext& a, int steps, const GaloisKeys& keys) const {
+        Ciphertext r;
+        rotate_vector(a, steps, keys, r);
+        a = std::move(r);
+    }
+
+private:
+    static void check_same(const Ciphertext& a, const Ciphertext& b) {
+        if (a.parms_id_ != b.parms_id_) throw std::invalid_argument("encrypted1 and encrypted2 parameter mismatch");
+        if (std::abs(a.scale_ / b.scale_ - 1.0) > 1e-6) throw std::invalid_argument("scale mismatch");
+    }
+
+    static void check_plain(const Ciphertext& a, const Plaintext& p, bool same_scale) {
+        if (a.parms_id_ != p.parms_id()) throw std::invalid_argument("encrypted and plain parameter mismatch");
+        if (same_scale && std::abs(a.scale_ / p.scale() - 1.0) > 1e-6) throw std::invalid_argument("scale mismatch");
+    }
+
+    // Real SEAL rejects a scale that outgrows the remaining modulus
+    void check_scale(const Ciphertext& a) const {
+        int bits = 0;
+        for (std::size_t c = 0; c <= a.parms_id_[0]; ++c) {
+            bits += ctx_->get_context_data(a.parms_id_)->parms().coeff_modulus()[c].bit_count();
+        }
+        if (std::log2(a.scale_) >= bits) throw std::invalid_argument("scale out of bounds");
+    }
+
+    const SEALContext* ctx_;
+};
+
+} // namespace seal_sim
+
+namespace seal = seal_sim;
@@ -0,0 +1,328 @@
+/**
+ * thread_pool.cpp
+ * Module-wide work-stealing task scheduler
+ *
+ * One pool per extension module, shared by index build, search, batch
+ * encryption and k-means, so combining them (parallel queries whose searches
+ * score neighbors in parallel, parallel partial builds whose inserts do the
+ * same) never runs more threads than the pool has.
+ *
+ * Each worker owns a deque. A task submitted from a worker goes to the back
+ * of that worker's deque and the owner pops from the back (LIFO, cache-warm);
+ * idle workers steal from the front of the others (FIFO, the oldest work).
+ * Tasks from outside the pool are dealt round-robin.
+ *
+ * parallel_for splits a range into chunks claimed from a shared counter. The
+ * calling thread claims chunks as well, and a helper task is only queued after
+ * reserving a spare worker: one that is neither running a task nor already
+ * reserved by another loop. A nested parallel_for on a busy pool therefore
+ * queues nothing and runs inline, the deques never hold more helpers than
+ * there are idle workers, and no caller waits for work nobody has started.
+ *
+ * The thread count includes the calling thread: size() - 1 workers run.
+ * PPRAG_THREADS sets the initial size (default: hardware threads).
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace pprag {
+
+class TaskScheduler {
+public:
+    using Task = std::function<void()>;
+
+    static TaskScheduler& instance() {
+        static TaskScheduler scheduler;
+        return scheduler;
+    }
+
+    ~TaskScheduler() { stop(); }
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    /**
+     * Resize the pool (threads <= 0: hardware threads). With pin_threads,
+     * worker i is bound to the (i+1)-th CPU the process may run on, leaving
+     * the first for the calling thread (Linux only). Call while no parallel
+     * work is running; queued tasks finish first.
+     */
+    void configure(int threads, bool pin_threads = false) {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        stop();
+        start(threads, pin_threads);
+    }
+
+    int size() const { return static_cast<int>(workers_.size()) + 1; }
+    bool pinned() const { return pinned_; }
+    uint64_t executed() const { return executed_.load(std::memory_order_relaxed); }
+    uint64_t stolen() const { return stolen_.load(std::memory_order_relaxed); }
+
+    /**
+     * Keeps up to n spare workers out of parallel_for while it lives, for
+     * threads outside the pool that do CPU-bound work of their own: those
+     * threads then share size() hardware threads with the pool instead of
+     * adding to them. Create and destroy while no parallel work is queued.
+     */
+    class Hold {
+    public:
+        Hold(TaskScheduler& scheduler, int n)
+            : scheduler_(scheduler), held_(scheduler.reserve_spare(static_cast<size_t>(std::max(n, 0)))) {}
+        ~Hold() { scheduler_.spare_.fetch_add(static_cast<int64_t>(held_)); }
+
+        Hold(const Hold&) = delete;
+        Hold& operator=(const Hold&) = delete;
+
+        size_t held() const { return held_; }
+
+    private:
+        TaskScheduler& scheduler_;
+        size_t held_;
+    };
+
+    /**
+     * Run fn on the pool. Do not wait on the future from inside a pool task
+     * (use parallel_for for nested work): every worker could end up waiting.
+     */
+    template <typename Fn>
+    auto submit(Fn fn) -> std::future<decltype(fn())> {
+        using Result = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(fn));
+        std::future<Result> future = task->get_future();
+        push([task]() { (*task)(); });
+        return future;
+    }
+
+    /**
+     * fn(i) for every i in [begin, end), in chunks of grain indices, on the
+     * calling thread plus whichever workers are idle. The first exception
+     * stops further chunks and is rethrown here.
+     */
+    template <typename Fn>
+    void parallel_for(size_t begin, size_t end, Fn&& fn, size_t grain = 1) {
+        if (end <= begin) return;
+        grain = std::max<size_t>(grain, 1);
+        const size_t chunks = (end - begin + grain - 1) / grain;
+        const size_t helpers = reserve_spare(chunks - 1);
+        if (helpers == 0) {
+            for (size_t i = begin; i < end; ++i) fn(i);
+            return;
+        }
+
+        auto state = std::make_shared<LoopState>();
+        state->chunks = chunks;
+        // fn is only touched after a successful claim, and every claim
+        // happens before this call returns (see LoopState::active)
+        auto body = [state, begin, end, grain, f = &fn]() {
+            state->active.fetch_add(1);
+            for (size_t c; (c = state->next.fetch_add(1)) < state->chunks;) {
+                try {
+                    size_t lo = begin + c * grain, hi = std::min(end, lo + grain);
+                    for (size_t i = lo; i < hi; ++i) (*f)(i);
+                } catch (...) {
+                    state->fail(std::current_exception());
+                }
+            }
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->active.fetch_sub(1) == 1) state->done.notify_all();
+        };
+        // The worker that runs a helper counts itself busy, so the helper
+        // hands its reservation back first
+        auto helper = [this, body]() {
+            spare_.fetch_add(1);
+            body();
+        };
+        for (size_t h = 0; h < helpers; ++h) push(helper);
+        body();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&]() { return state->active.load() == 0; });
+        if (state->error) std::rethrow_exception(state->error);
+    }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    // A helper counts itself active before claiming, so once the caller's own
+    // claim fails and active drops to 0 no helper can still reach fn
+    struct LoopState {
+        size_t chunks = 0;
+        std::atomic<size_t> next{0};
+        std::atomic<int> active{0};
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+
+        void fail(std::exception_ptr e) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) error = e;
+            next.store(chunks);
+        }
+    };
+
+    TaskScheduler() {
+        const char* env = std::getenv("PPRAG_THREADS");
+        start(env ? std::atoi(env) : 0, false);
+    }
+
+    void start(int threads, bool pin_threads) {
+        if (threads <= 0) threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        stopping_ = false;
+        pinned_ = pin_threads;
+        workers_.clear();
+        for (int w = 0; w + 1 < threads; ++w) workers_.push_back(std::make_unique<Worker>());
+        spare_.store(static_cast<int64_t>(workers_.size()));
+        for (size_t w = 0; w < workers_.size(); ++w) {
+            workers_[w]->thread = std::thread([this, w]() { run_worker(w); });
+            if (pin_threads) pin(workers_[w]->thread, w + 1);
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stopping_ = true;
+        }
+        sleep_cv_.notify_all();
+        for (auto& w : workers_) {
+            if (w->thread.joinable()) w->thread.join();
+        }
+        workers_.clear();
+    }
+
+    void push(Task task) {
+        if (workers_.empty()) {
+            task();
+            return;
+        }
+        size_t w = current_ == this ? current_worker_ : next_worker_.fetch_add(1) % workers_.size();
+        {
+            std::lock_guard<std::mutex> lock(workers_[w]->mutex);
+            workers_[w]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            pending_.fetch_add(1);
+        }
+        sleep_cv_.notify_one();
+    }
+
+    // Reserve up to wanted spare workers for helper tasks; returns how many
+    size_t reserve_spare(size_t wanted) {
+        int64_t spare = spare_.load();
+        for (;;) {
+            int64_t take = std::min<int64_t>(std::max<int64_t>(spare, 0), static_cast<int64_t>(wanted));
+            if (take == 0 || spare_.compare_exchange_weak(spare, spare - take)) return static_cast<size_t>(take);
+        }
+    }
+
+    bool pop_local(size_t w, Task& task) {
+        std::lock_guard<std::mutex> lock(workers_[w]->mutex);
+        if (workers_[w]->tasks.empty()) return false;
+        task = std::move(workers_[w]->tasks.back());
+        workers_[w]->tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t thief, Task& task) {
+        for (size_t k = 1; k < workers_.size(); ++k) {
+            Worker& victim = *workers_[(thief + k) % workers_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            stolen_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void run_worker(size_t w) {
+        current_ = this;
+        current_worker_ = w;
+        Task task;
+        for (;;) {
+            if (pop_local(w, task) || steal(w, task)) {
+                pending_.fetch_sub(1);
+                spare_.fetch_sub(1);
+                task();
+                task = nullptr;
+                spare_.fetch_add(1);
+                executed_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            sleep_cv_.wait(lock, [this]() { return pending_.load() > 0 || stopping_; });
+            if (stopping_ && pending_.load() == 0) return;
+        }
+    }
+
+    static void pin(std::thread& thread, size_t slot) {
+#ifdef __linux__
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+        std::vector<int> cpus;
+        for (int c = 0; c < CPU_SETSIZE; ++c) {
+            if (CPU_ISSET(c, &allowed)) cpus.push_back(c);
+        }
+        if (cpus.empty()) return;
+        cpu_set_t one;
+        CPU_ZERO(&one);
+        CPU_SET(cpus[slot % cpus.size()], &one);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(one), &one);
+#else
+        (void)thread;
+        (void)slot;
+#endif
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex config_mutex_;
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    std::atomic<int64_t> pending_{0};  // queued, not yet started
+    std::atomic<int64_t> spare_{0};    // workers neither running a task nor reserved by a parallel_for
+    std::atomic<size_t> next_worker_{0};
+    std::atomic<uint64_t> executed_{0};
+    std::atomic<uint64_t> stolen_{0};
+    bool stopping_ = false;
+    bool pinned_ = false;
+
+    static inline thread_local TaskScheduler* current_ = nullptr;
+    static inline thread_local size_t current_worker_ = 0;
+};
+
+/**
+ * TaskScheduler::instance().parallel_for
+ */
+template <typename Fn>
+void parallel_for(size_t begin, size_t end, Fn&& fn, size_t grain = 1) {
+    TaskScheduler::instance().parallel_for(begin, end, std::forward<Fn>(fn), grain);
+}
+
+} // namespace pprag
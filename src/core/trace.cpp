@@ -0,0 +1,198 @@
+/**
+ * trace.cpp
+ * Scoped trace spans exported as Chrome trace JSON (chrome://tracing, Perfetto)
+ *
+ * PPRAG_TRACE_SCOPE("name") records the enclosing scope as a complete event.
+ * Each thread appends to its own fixed-size ring (single writer, no locks);
+ * when a ring is full the oldest events are overwritten, so long runs keep
+ * the most recent RING_CAPACITY spans per thread. A disabled tracer costs a
+ * relaxed atomic load per span; building with PPRAG_NO_TRACE removes the
+ * spans entirely.
+ *
+ * Dump after the traced work has finished: a thread still appending while
+ * the rings are read may have its oldest events replaced mid-dump.
+ * Names and argument names must be string literals (only the pointer is kept).
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace pprag {
+
+class Tracer {
+public:
+    static constexpr size_t RING_CAPACITY = 1 << 16;
+
+    static Tracer& instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    void set_enabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    static uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    /**
+     * Append a finished span to the calling thread's ring
+     */
+    void record(const char* name, uint64_t start_ns, uint64_t end_ns, const char* arg_name, int64_t arg) {
+        Ring& ring = local_ring();
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        Event& e = ring.events[head % RING_CAPACITY];
+        e.name.store(name, std::memory_order_relaxed);
+        e.arg_name.store(arg_name, std::memory_order_relaxed);
+        e.arg.store(arg, std::memory_order_relaxed);
+        e.start_ns.store(start_ns, std::memory_order_relaxed);
+        e.dur_ns.store(end_ns - start_ns, std::memory_order_relaxed);
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * Buffered spans of every thread as a Chrome trace document
+     */
+    std::string chrome_trace_json() const {
+        std::ostringstream os;
+        os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        for (const auto& ring : rings_) {
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t begin = ring->cleared.load(std::memory_order_relaxed);
+            if (head > RING_CAPACITY) begin = std::max(begin, head - RING_CAPACITY);
+            for (uint64_t i = begin; i < head; ++i) {
+                const Event& e = ring->events[i % RING_CAPACITY];
+                os << (first ? "" : ",") << "{\"name\":\"" << e.name.load(std::memory_order_relaxed)
+                   << "\",\"cat\":\"pprag\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->tid
+                   << ",\"ts\":" << microseconds(e.start_ns.load(std::memory_order_relaxed))
+                   << ",\"dur\":" << microseconds(e.dur_ns.load(std::memory_order_relaxed));
+                if (const char* arg_name = e.arg_name.load(std::memory_order_relaxed)) {
+                    os << ",\"args\":{\"" << arg_name << "\":" << e.arg.load(std::memory_order_relaxed) << "}";
+                }
+                os << "}";
+                first = false;
+            }
+        }
+        os << "]}";
+        return os.str();
+    }
+
+    void write_chrome_trace(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) throw std::runtime_error("cannot write trace to " + path);
+        out << chrome_trace_json();
+    }
+
+    // Spans currently buffered across all threads
+    size_t event_count() const {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        size_t n = 0;
+        for (const auto& ring : rings_) {
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t begin = ring->cleared.load(std::memory_order_relaxed);
+            if (head > RING_CAPACITY) begin = std::max(begin, head - RING_CAPACITY);
+            n += head - begin;
+        }
+        return n;
+    }
+
+    /**
+     * Drop buffered spans (rings stay registered; writers are not blocked)
+     */
+    void clear() {
+        std::lock_guard<std::mutex> lock(registry_mutex_);
+        for (auto& ring : rings_) {
+            ring->cleared.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct Event {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<const char*> arg_name{nullptr};
+        std::atomic<int64_t> arg{0};
+        std::atomic<uint64_t> start_ns{0};
+        std::atomic<uint64_t> dur_ns{0};
+    };
+
+    struct Ring {
+        explicit Ring(int tid) : tid(tid), events(new Event[RING_CAPACITY]) {}
+        int tid;
+        std::unique_ptr<Event[]> events;
+        std::atomic<uint64_t> head{0};     // events ever written
+        std::atomic<uint64_t> cleared{0};  // head at the last clear()
+    };
+
+    Tracer() = default;
+
+    // Registered on the thread's first span and kept for the process lifetime
+    Ring& local_ring() {
+        thread_local Ring* ring = nullptr;
+        if (!ring) {
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            rings_.push_back(std::make_unique<Ring>(static_cast<int>(rings_.size()) + 1));
+            ring = rings_.back().get();
+        }
+        return *ring;
+    }
+
+    static std::string microseconds(uint64_t ns) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(ns) / 1000.0);
+        return buf;
+    }
+
+    std::atomic<bool> enabled_{false};
+    mutable std::mutex registry_mutex_;
+    std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+/**
+ * Records its lifetime as one span when tracing was enabled at construction
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* arg_name = nullptr, int64_t arg = 0)
+        : name_(Tracer::instance().enabled() ? name : nullptr), arg_name_(arg_name), arg_(arg),
+          start_ns_(name_ ? Tracer::now_ns() : 0) {}
+
+    ~TraceSpan() {
+        if (name_) Tracer::instance().record(name_, start_ns_, Tracer::now_ns(), arg_name_, arg_);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_;
+    const char* arg_name_;
+    int64_t arg_;
+    uint64_t start_ns_;
+};
+
+} // namespace pprag
+
+#define PPRAG_TRACE_CONCAT_(a, b) a##b
+#define PPRAG_TRACE_CONCAT(a, b) PPRAG_TRACE_CONCAT_(a, b)
+
+#ifdef PPRAG_NO_TRACE
+#define PPRAG_TRACE_SCOPE(...) ((void)0)
+#else
+// PPRAG_TRACE_SCOPE("name") or PPRAG_TRACE_SCOPE("name", "arg_name", value)
+#define PPRAG_TRACE_SCOPE(...) ::pprag::TraceSpan PPRAG_TRACE_CONCAT(pprag_trace_span_, __LINE__)(__VA_ARGS__)
+#endif
@@ -0,0 +1,323 @@
+/**
+ * yaml_config.cpp
+ * Reader for the YAML subset used by config/config.yaml
+ *
+ * Supports block maps and lists (including "- key: value" list items),
+ * flow lists ("[60, 40, 40, 60]"), quoted and plain scalars and comments.
+ * Anchors, multi-line strings and flow maps are not supported. Map keys keep
+ * file order, so to_json() matches what Python writes for the same config.
+ */
+
+#pragma once
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pprag {
+
+class ConfigNode {
+public:
+    enum class Kind { Null, Scalar, List, Map };
+
+    Kind kind() const { return kind_; }
+    bool is_null() const { return kind_ == Kind::Null; }
+
+    /**
+     * Map entry, or a null node when absent (so lookups chain safely)
+     */
+    const ConfigNode& operator[](const std::string& key) const {
+        if (kind_ == Kind::Map) {
+            for (const auto& [k, v] : map_) {
+                if (k == key) return v;
+            }
+        }
+        return null_node();
+    }
+
+    bool has(const std::string& key) const { return !(*this)[key].is_null(); }
+
+    const std::vector<ConfigNode>& items() const { return list_; }
+    const std::vector<std::pair<std::string, ConfigNode>>& entries() const { return map_; }
+
+    std::string as_string(const std::string& fallback = "") const {
+        return kind_ == Kind::Scalar ? value_ : fallback;
+    }
+
+    double as_double(double fallback = 0.0) const {
+        if (kind_ != Kind::Scalar) return fallback;
+        char* end = nullptr;
+        double v = std::strtod(value_.c_str(), &end);
+        if (end == value_.c_str() || *end != '\0') {
+            throw std::invalid_argument("config: '" + value_ + "' is not a number");
+        }
+        return v;
+    }
+
+    int as_int(int fallback = 0) const {
+        return kind_ == Kind::Scalar ? static_cast<int>(as_double()) : fallback;
+    }
+
+    bool as_bool(bool fallback = false) const {
+        if (kind_ != Kind::Scalar) return fallback;
+        if (value_ == "true" || value_ == "True") return true;
+        if (value_ == "false" || value_ == "False") return false;
+        throw std::invalid_argument("config: '" + value_ + "' is not a boolean");
+    }
+
+    std::vector<int> as_int_list(const std::vector<int>& fallback = {}) const {
+        if (kind_ != Kind::List) return fallback;
+        std::vector<int> out;
+        for (const auto& item : list_) out.push_back(item.as_int());
+        return out;
+    }
+
+    /**
+     * JSON rendering (json.dump(..., indent=2) layout); unquoted scalars
+     * become numbers, booleans or null where YAML would read them so
+     */
+    std::string to_json(int indent = 0) const {
+        std::ostringstream os;
+        write_json(os, indent);
+        return os.str();
+    }
+
+    static ConfigNode parse(const std::string& text) {
+        std::vector<Line> lines;
+        std::istringstream is(text);
+        std::string raw;
+        while (std::getline(is, raw)) {
+            std::string content = strip_comment(raw);
+            size_t indent = content.find_first_not_of(' ');
+            if (indent == std::string::npos) continue;
+            if (content[indent] == '\t') throw std::invalid_argument("config: tabs are not allowed for indentation");
+            size_t last = content.find_last_not_of(" \r");
+            lines.push_back({static_cast<int>(indent), content.substr(indent, last - indent + 1)});
+        }
+        size_t pos = 0;
+        if (lines.empty()) return ConfigNode();
+        ConfigNode root = parse_block(lines, pos, lines[0].indent);
+        if (pos != lines.size()) {
+            throw std::invalid_argument("config: unexpected indentation at '" + lines[pos].text + "'");
+        }
+        return root;
+    }
+
+    static ConfigNode load_file(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) throw std::runtime_error("cannot read config " + path);
+        std::stringstream buf;
+        buf << in.rdbuf();
+        return parse(buf.str());
+    }
+
+private:
+    struct Line {
+        int indent;
+        std::string text;
+    };
+
+    static const ConfigNode& null_node() {
+        static const ConfigNode node;
+        return node;
+    }
+
+    static ConfigNode scalar(std::string value, bool quoted) {
+        ConfigNode node;
+        node.kind_ = Kind::Scalar;
+        node.value_ = std::move(value);
+        node.quoted_ = quoted;
+        return node;
+    }
+
+    // Drop a trailing "# ..." that is not inside quotes
+    static std::string strip_comment(const std::string& line) {
+        char quote = 0;
+        for (size_t i = 0; i < line.size(); ++i) {
+            char c = line[i];
+            if (quote) {
+                if (c == quote) quote = 0;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '#' && (i == 0 || line[i - 1] == ' ')) {
+                return line.substr(0, i);
+            }
+        }
+        return line;
+    }
+
+    static std::string trim(const std::string& s) {
+        size_t b = s.find_first_not_of(' ');
+        if (b == std::string::npos) return "";
+        return s.substr(b, s.find_last_not_of(' ') - b + 1);
+    }
+
+    // Position of the "key:" separator, npos for a plain value
+    static size_t key_separator(const std::string& text) {
+        char quote = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            char c = text[i];
+            if (quote) {
+                if (c == quote) quote = 0;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '[') {
+                return std::string::npos;
+            } else if (c == ':' && (i + 1 == text.size() || text[i + 1] == ' ')) {
+                return i;
+            }
+        }
+        return std::string::npos;
+    }
+
+    static std::string unquote(const std::string& s) {
+        if (s.size() >= 2 && (s[0] == '"' || s[0] == '\'') && s.back() == s[0]) return s.substr(1, s.size() - 2);
+        return s;
+    }
+
+    static ConfigNode parse_value(const std::string& text) {
+        std::string v = trim(text);
+        if (v.empty() || v == "~" || v == "null") return ConfigNode();
+        if (v.front() == '[') {
+            if (v.back() != ']') throw std::invalid_argument("config: unterminated list '" + v + "'");
+            ConfigNode list;
+            list.kind_ = Kind::List;
+            std::string body = v.substr(1, v.size() - 2);
+            char quote = 0;
+            std::string item;
+            for (char c : body + ",") {
+                if (quote) {
+                    if (c == quote) quote = 0;
+                    item += c;
+                } else if (c == '"' || c == '\'') {
+                    quote = c;
+                    item += c;
+                } else if (c == ',') {
+                    if (!trim(item).empty()) list.list_.push_back(parse_value(item));
+                    item.clear();
+                } else {
+                    item += c;
+                }
+            }
+            return list;
+        }
+        bool quoted = v.size() >= 2 && (v[0] == '"' || v[0] == '\'') && v.back() == v[0];
+        return scalar(unquote(v), quoted);
+    }
+
+    static ConfigNode parse_block(std::vector<Line>& lines, size_t& pos, int indent) {
+        ConfigNode node;
+        bool is_list = lines[pos].text[0] == '-' && (lines[pos].text.size() == 1 || lines[pos].text[1] == ' ');
+        node.kind_ = is_list ? Kind::List : Kind::Map;
+
+        while (pos < lines.size() && lines[pos].indent == indent) {
+            Line& line = lines[pos];
+            if (is_list) {
+                if (line.text[0] != '-') throw std::invalid_argument("config: expected '- ' at '" + line.text + "'");
+                std::string rest = trim(line.text.substr(1));
+                if (rest.empty()) {
+                    ++pos;
+                    node.list_.push_back(child_block(lines, pos, indent));
+                } else if (key_separator(rest) != std::string::npos) {
+                    // "- key: value": a map whose keys line up with "key"
+                    int column = indent + static_cast<int>(line.text.find(rest));
+                    line = {column, rest};
+                    node.list_.push_back(parse_block(lines, pos, column));
+                } else {
+                    node.list_.push_back(parse_value(rest));
+                    ++pos;
+                }
+                continue;
+            }
+
+            size_t sep = key_separator(line.text);
+            if (sep == std::string::npos) throw std::invalid_argument("config: expected 'key: value' at '" + line.text + "'");
+            std::string key = unquote(trim(line.text.substr(0, sep)));
+            std::string rest = trim(line.text.substr(sep + 1));
+            ++pos;
+            if (!rest.empty()) {
+                node.map_.emplace_back(key, parse_value(rest));
+            } else if (pos < lines.size() && lines[pos].indent == indent && lines[pos].text[0] == '-') {
+                node.map_.emplace_back(key, parse_block(lines, pos, indent));  // list at key indent
+            } else {
+                node.map_.emplace_back(key, child_block(lines, pos, indent));
+            }
+        }
+        return node;
+    }
+
+    static ConfigNode child_block(std::vector<Line>& lines, size_t& pos, int parent_indent) {
+        if (pos < lines.size() && lines[pos].indent > parent_indent) {
+            return parse_block(lines, pos, lines[pos].indent);
+        }
+        return ConfigNode();
+    }
+
+    static bool is_number(const std::string& s) {
+        if (s.empty()) return false;
+        char* end = nullptr;
+        std::strtod(s.c_str(), &end);
+        return *end == '\0' && (std::isdigit(static_cast<unsigned char>(s.back())) || s.back() == '.');
+    }
+
+    static void write_string(std::ostream& os, const std::string& s) {
+        os << '"';
+        for (char c : s) {
+            if (c == '"' || c == '\\') os << '\\' << c;
+            else if (c == '\n') os << "\\n";
+            else os << c;
+        }
+        os << '"';
+    }
+
+    void write_json(std::ostream& os, int indent) const {
+        const std::string pad(indent + 2, ' '), close(indent, ' ');
+        switch (kind_) {
+            case Kind::Null:
+                os << "null";
+                break;
+            case Kind::Scalar:
+                if (quoted_) write_string(os, value_);
+                else if (value_ == "true" || value_ == "True") os << "true";
+                else if (value_ == "false" || value_ == "False") os << "false";
+                else if (is_number(value_)) os << value_;
+                else write_string(os, value_);
+                break;
+            case Kind::List:
+                if (list_.empty()) { os << "[]"; break; }
+                os << "[\n";
+                for (size_t i = 0; i < list_.size(); ++i) {
+                    os << pad;
+                    list_[i].write_json(os, indent + 2);
+                    os << (i + 1 < list_.size() ? ",\n" : "\n");
+                }
+                os << close << "]";
+                break;
+            case Kind::Map:
+                if (map_.empty()) { os << "{}"; break; }
+                os << "{\n";
+                for (size_t i = 0; i < map_.size(); ++i) {
+                    os << pad;
+                    write_string(os, map_[i].first);
+                    os << ": ";
+                    map_[i].second.write_json(os, indent + 2);
+                    os << (i + 1 < map_.size() ? ",\n" : "\n");
+                }
+                os << close << "}";
+                break;
+        }
+    }
+
+    Kind kind_ = Kind::Null;
+    std::string value_;
+    bool quoted_ = false;
+    std::vector<ConfigNode> list_;
+    std::vector<std::pair<std::string, ConfigNode>> map_;
+};
+
+} // namespace pprag
@@ -14,6 +14,7 @@ from .ckks_wrapper import (
     HEContext,
     SecureHNSWWrapper
 )
+from .sharded_index import ShardedSecureHNSW
 from .bench_runner import BenchmarkRunner, run_benchmark
 from .visualizer import generate_all_figures
 
@@ -29,6 +30,7 @@ __all__ = [
     # CKKS Wrapper
     'HEContext',
     'SecureHNSWWrapper',
+    'ShardedSecureHNSW',
     # Benchmark
     'BenchmarkRunner',
     'run_benchmark',
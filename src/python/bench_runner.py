@@ -1,19 +1,25 @@
 """
 Benchmark Runner using Real CKKS
 """
+import sys
 import time
 import json
+import atexit
+import functools
+import threading
 import numpy as np
 from pathlib import Path
 from typing import Dict, List, Any
-from dataclasses import dataclass, asdict
+from dataclasses import dataclass, asdict, field
 from datetime import datetime
 
 from .data_generator import (
     load_config, load_dataset, get_sample_dataset,
     generate_query_vectors, generate_update_vectors
 )
-from .ckks_wrapper import HEContext, SecureHNSWWrapper
+from .ckks_wrapper import HEContext, SecureHNSWWrapper, SecurePQWrapper, pprag_core
+from .sharded_index import ShardedSecureHNSW
+from .load_generator import OpenLoopGenerator
 
 
 @dataclass
@@ -41,6 +47,7 @@ class BenchmarkResult:
     setup_results: List[TimingResult]
     retrieve_results: List[TimingResult]
     update_results: List[TimingResult]
+    memory: Dict[str, Dict[str, float]] = field(default_factory=dict)  # phase -> MB figures
     
     def to_dict(self) -> dict:
         return {
@@ -48,7 +55,8 @@ class BenchmarkResult:
             'config': self.config,
             'setup': [r.to_dict() for r in self.setup_results],
             'retrieve': [r.to_dict() for r in self.retrieve_results],
-            'update': [r.to_dict() for r in self.update_results]
+            'update': [r.to_dict() for r in self.update_results],
+            'memory': self.memory
         }
     
     def save(self, path: str):
@@ -58,6 +66,46 @@ class BenchmarkResult:
         print(f"[BenchmarkRunner] Results saved to {path}")
 
 
+def _reset_peak_rss() -> bool:
+    """Start a new peak-RSS window (Linux: writing 5 to clear_refs resets VmHWM); False if unsupported"""
+    try:
+        with open('/proc/self/clear_refs', 'w') as f:
+            f.write('5')
+        return True
+    except OSError:
+        return False
+
+
+def _peak_rss_bytes() -> int:
+    """Peak resident set size since the last reset, or over the process lifetime where it cannot be reset"""
+    try:
+        with open('/proc/self/status') as f:
+            for line in f:
+                if line.startswith('VmHWM:'):
+                    return int(line.split()[1]) * 1024
+    except OSError:
+        pass
+    try:
+        import resource
+    except ImportError:
+        return 0
+    peak = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    return peak if sys.platform == 'darwin' else peak * 1024
+
+
+def tracks_memory(phase: str):
+    """Record peak RSS of a benchmark phase, and key/index bytes after it, in results.memory"""
+    def wrap(method):
+        @functools.wraps(method)
+        def run(self, *args, **kwargs):
+            per_phase = _reset_peak_rss()
+            out = method(self, *args, **kwargs)
+            self.record_memory(phase, per_phase)
+            return out
+        return run
+    return wrap
+
+
 class BenchmarkRunner:
     """
     Coordinates Real CKKS Benchmarks
@@ -66,6 +114,10 @@ class BenchmarkRunner:
     def __init__(self, config_path: str = "./config/config.yaml"):
         self.config = load_config(config_path)
         
+        # One native task pool for build, search, encryption and k-means
+        bench_config = self.config.get('benchmark', {})
+        pprag_core.set_thread_pool(bench_config.get('num_workers', 0), bench_config.get('pin_threads', False))
+        
         # Initialize HE Context
         print("\n[Init] Initializing CKKS Context...")
         self.he_ctx = HEContext(self.config)
@@ -80,6 +132,47 @@ class BenchmarkRunner:
             retrieve_results=[],
             update_results=[]
         )
+        
+        # Chrome trace of the native spans, written when the process exits
+        if self.config['benchmark'].get('trace', False):
+            pprag_core.set_tracing(True)
+            atexit.register(self.save_trace, self.config['benchmark'].get('trace_path', './results/trace.json'))
+    
+    def save_trace(self, path: str):
+        """Write buffered trace spans as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)"""
+        Path(path).parent.mkdir(parents=True, exist_ok=True)
+        pprag_core.write_chrome_trace(path)
+        print(f"[BenchmarkRunner] {pprag_core.trace_event_count()} trace spans saved to {path}")
+    
+    def record_memory(self, phase: str, per_phase: bool = True):
+        """Peak RSS of the phase plus the native key and index accounting, in MB"""
+        mb = 1024 * 1024
+        index = self.hnsw.memory_usage()
+        ciphertexts = sum(b for name, b in index.items() if 'ciphertexts_level_' in name)
+        self.results.memory[phase] = {
+            'peak_rss_mb': _peak_rss_bytes() / mb,
+            'peak_rss_per_phase': float(per_phase),  # 0: process-lifetime peak (no VmHWM reset)
+            'keys_mb': self.he_ctx.memory_usage()['total'] / mb,
+            'index_mb': index['total'] / mb,
+            'index_ciphertexts_mb': ciphertexts / mb,
+            'index_adjacency_mb': index['adjacency'] / mb,
+            'index_overhead_mb': index['overhead'] / mb,
+            'index_nodes': float(self.hnsw.hnsw.size()),
+        }
+        m = self.results.memory[phase]
+        print(f"      [Memory] {phase}: peak RSS {m['peak_rss_mb']:.1f} MB "
+              f"(keys {m['keys_mb']:.1f} MB, index {m['index_mb']:.1f} MB for {m['index_nodes']:.0f} nodes)")
+    
+    @staticmethod
+    def latency_details(*ops: str) -> Dict[str, float]:
+        """p50/p90/p99/p999 (ms) of the native per-operation histograms since the last reset"""
+        histograms = pprag_core.latency_histograms()
+        details = {}
+        for op in ops:
+            if op in histograms:
+                for p in ('p50', 'p90', 'p99', 'p999'):
+                    details[f'{op}_{p}_ms'] = histograms[op][f'{p}_ms']
+        return details
     
     def load_data(self) -> np.ndarray:
         """Load dataset (support sampling)"""
@@ -98,6 +191,7 @@ class BenchmarkRunner:
     
     # ==================== Setup Phase ====================
     
+    @tracks_memory('setup')
     def benchmark_setup(self, vectors: np.ndarray) -> List[TimingResult]:
         """Test Setup Phase"""
         results = []
@@ -109,6 +203,7 @@ class BenchmarkRunner:
         # 1. Encryption Estimation
         print("\n[1/2] Benchmarking encryption throughput...")
         sample_n = min(n, 50)
+        pprag_core.reset_latency_histograms()
         t_enc_start = time.perf_counter()
         _ = self.he_ctx.encrypt_batch(vectors[:sample_n])
         t_enc_end = time.perf_counter()
@@ -120,13 +215,15 @@ class BenchmarkRunner:
             operation='encrypt_estimate',
             total_time=estimated_enc_total,
             num_items=n,
-            avg_time_per_item=avg_enc_time
+            avg_time_per_item=avg_enc_time,
+            details=self.latency_details('encrypt')
         ))
         print(f"      Avg Encrypt: {avg_enc_time*1000:.4f}ms/vector")
         print(f"      Est Total Encrypt: {estimated_enc_total:.4f}s")
         
         # 2. Secure HNSW Setup
         print("\n[2/2] Building Encrypted HNSW Index...")
+        pprag_core.reset_latency_histograms()
         t0 = time.perf_counter()
         _ = self.hnsw.build_index(vectors)
         build_time = time.perf_counter() - t0
@@ -136,15 +233,78 @@ class BenchmarkRunner:
             operation='build_index_e2e',
             total_time=build_time,
             num_items=n,
-            avg_time_per_item=build_time / n
+            avg_time_per_item=build_time / n,
+            details=self.latency_details('encrypt', 'insert')
         ))
         print(f"      Total Build Time: {build_time:.4f}s")
         
         self.results.setup_results = results
         return results
     
+    def benchmark_parallel_build(self, vectors: np.ndarray, num_parts: int = None) -> List[TimingResult]:
+        """Test building partial graphs concurrently and merging them into one index"""
+        if num_parts is None:
+            num_parts = self.config['benchmark'].get('parallel_build_parts', 2)
+        
+        n = len(vectors)
+        results = []
+        print(f"\n{'='*60}")
+        print(f"[Setup Benchmark] Parallel build: {num_parts} parts merged into one graph")
+        print(f"{'='*60}")
+        
+        parts = [SecureHNSWWrapper(self.he_ctx, self.config) for _ in range(num_parts)]
+        # Parts are merged, so they share one dimension layout and traversal projection
+        if self.hnsw.dim is None:
+            self.hnsw.prepare_layout(vectors)
+        for part in parts:
+            part.prepare_layout(vectors, projection=self.hnsw.projection)
+        chunks = np.array_split(vectors, num_parts)
+        # Encrypt up front so the timed section is graph construction (insert releases the GIL)
+        encrypted = [self.he_ctx.encrypt_batch(self.hnsw._to_metric_space(chunk)) for chunk in chunks]
+        if self.he_ctx.coarse is not None:
+            # Two-stage parts also need every node under the coarse keys
+            encrypted = [list(zip(cts, self.he_ctx.coarse.encrypt_batch(
+                              [self.hnsw._coarse_space(v) for v in self.hnsw._to_metric_space(chunk)])))
+                         for cts, chunk in zip(encrypted, chunks)]
+        
+        def build(part: SecureHNSWWrapper, cts):
+            for ct in cts:
+                if isinstance(ct, tuple):
+                    part.hnsw.insert(*ct)
+                else:
+                    part.hnsw.insert(ct)
+        
+        threads = [threading.Thread(target=build, args=(p, cts)) for p, cts in zip(parts, encrypted)]
+        t0 = time.perf_counter()
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        build_time = time.perf_counter() - t0
+        
+        t0 = time.perf_counter()
+        for part in parts[1:]:
+            parts[0].merge(part)
+        merge_time = time.perf_counter() - t0
+        
+        for op, total in (('build_parts', build_time), ('merge', merge_time)):
+            results.append(TimingResult(
+                component='secure_hnsw_parallel',
+                operation=op,
+                total_time=total,
+                num_items=n,
+                avg_time_per_item=total / n,
+                details={'parts': float(num_parts)}
+            ))
+        print(f"      Parallel Build: {build_time:.4f}s, Merge: {merge_time:.4f}s "
+              f"({parts[0].hnsw.size()} nodes)")
+        
+        self.results.setup_results.extend(results)
+        return results
+    
     # ==================== Retrieve Phase ====================
     
+    @tracks_memory('retrieve')
     def benchmark_retrieve(self, vectors: np.ndarray, num_queries: int = None, top_k_values: List[int] = None) -> List[TimingResult]:
         """Test Retrieve Phase"""
         if num_queries is None:
@@ -160,6 +320,7 @@ class BenchmarkRunner:
         queries = generate_query_vectors(vectors, num_queries)
         
         print("\n[1/2] Benchmarking Query Encryption...")
+        pprag_core.reset_latency_histograms()
         t0 = time.perf_counter()
         _ = self.he_ctx.encrypt_batch(queries)
         enc_time = time.perf_counter() - t0
@@ -168,16 +329,29 @@ class BenchmarkRunner:
             operation='encrypt_query',
             total_time=enc_time,
             num_items=num_queries,
-            avg_time_per_item=enc_time / num_queries
+            avg_time_per_item=enc_time / num_queries,
+            details=self.latency_details('encrypt')
         ))
         print(f"      Total: {enc_time:.4f}s")
         
+        # Encrypt and preprocess each query once; every top_k reuses the handle
+        t0 = time.perf_counter()
+        handles = [self.hnsw.prepare_query(q) for q in queries]
+        prep_time = time.perf_counter() - t0
+        results.append(TimingResult(
+            component='secure_hnsw',
+            operation='prepare_query',
+            total_time=prep_time,
+            num_items=num_queries,
+            avg_time_per_item=prep_time / num_queries
+        ))
+        
         print("\n[2/2] Benchmarking Secure Search...")
         for k in top_k_values:
             print(f"\n      Testing top_k={k}...")
+            pprag_core.reset_latency_histograms()
             t_search_start = time.perf_counter()
-            for q in queries:
-                self.hnsw.search(q, k)
+            self.hnsw.search_batch(handles, k)
             search_total = time.perf_counter() - t_search_start
             
             results.append(TimingResult(
@@ -185,15 +359,289 @@ class BenchmarkRunner:
                 operation=f'search_top{k}',
                 total_time=search_total,
                 num_items=num_queries,
-                avg_time_per_item=search_total / num_queries
+                avg_time_per_item=search_total / num_queries,
+                details=self.latency_details('search', 'distance', 'decrypt')
             ))
             print(f"      Total: {search_total:.4f}s")
+            if results[-1].details:
+                print(f"      Search p50/p99: {results[-1].details['search_p50_ms']:.2f}/"
+                      f"{results[-1].details['search_p99_ms']:.2f}ms")
             
         self.results.retrieve_results = results
         return results
     
+    def benchmark_load(self, vectors: np.ndarray, qps_levels: List[float] = None) -> List[TimingResult]:
+        """
+        Open-loop retrieval: Poisson query arrivals at each target QPS against
+        benchmark.load.workers search threads; latency includes queueing.
+        One row per level, then the saturation summary.
+        """
+        load_config = self.config['benchmark'].get('load') or {}
+        if qps_levels is None:
+            qps_levels = load_config.get('qps_levels') or []
+        duration = load_config.get('duration_s', 10)
+        workers = load_config.get('workers', self.config['benchmark'].get('num_workers', 4))
+        k = load_config.get('top_k', 10)
+        slo_ms = load_config.get('latency_slo_ms', 1000)
+        num_queries = self.config['benchmark'].get('num_test_queries', 50)
+        
+        print(f"\n{'='*60}")
+        print(f"[Load Benchmark] Open loop, {workers} search workers, {duration}s per level")
+        print(f"{'='*60}")
+        
+        # Queries are encrypted up front: the server-side executor is what is under load
+        handles = [self.hnsw.prepare_query(q) for q in generate_query_vectors(vectors, num_queries)]
+        generator = OpenLoopGenerator(lambda h: self.hnsw.search_encrypted(h, k), handles,
+                                      workers=workers, seed=load_config.get('seed', 0))
+        levels, summary = generator.sweep(qps_levels, duration, slo_ms)
+        
+        results = [TimingResult(
+            component='secure_hnsw_load',
+            operation=f'open_loop_{level.target_qps:g}qps',
+            total_time=level.duration_s,
+            num_items=level.completed,
+            avg_time_per_item=level.mean_ms / 1000,
+            details={name: float(v) for name, v in level.to_dict().items()}
+        ) for level in levels]
+        results.append(TimingResult(
+            component='secure_hnsw_load',
+            operation='saturation',
+            total_time=sum(level.duration_s for level in levels),
+            num_items=sum(level.completed for level in levels),
+            avg_time_per_item=1.0 / summary['saturation_qps'] if summary['saturation_qps'] > 0 else 0.0,
+            details=summary
+        ))
+        print(f"      Saturation: {summary['saturation_qps']:.2f} qps within p99 <= {slo_ms}ms "
+              f"(max throughput {summary['max_throughput_qps']:.2f} qps)")
+        
+        self.results.retrieve_results.extend(results)
+        return results
+    
+    def benchmark_query_batching(self, vectors: np.ndarray, num_queries: int = None) -> List[TimingResult]:
+        """Throughput of one-by-one search vs. packed queries walking the graph in lockstep"""
+        if num_queries is None:
+            num_queries = self.config['benchmark'].get('num_test_queries', 50)
+        k = max(self.config['benchmark'].get('retrieval_top_k', [10]))
+        batch = self.hnsw.hnsw.max_query_batch(vectors.shape[1])
+        
+        results = []
+        print(f"\n{'='*60}")
+        print(f"[Retrieve Benchmark] Query batching: {num_queries} queries, "
+              f"up to {batch} per packed ciphertext, top_k={k}")
+        print(f"{'='*60}")
+        
+        handles = [self.hnsw.prepare_query(q) for q in generate_query_vectors(vectors, num_queries)]
+        found = {}
+        for mode in ('sequential', 'batched'):
+            self.hnsw.hnsw.reset_batch_distance_counts()
+            t0 = time.perf_counter()
+            found[mode] = self.hnsw.search_batch(handles, k, batched=(mode == 'batched'))
+            search_total = time.perf_counter() - t0
+            
+            details = {'max_batch': float(batch)}
+            if mode == 'batched':
+                packed_ops, _ = self.hnsw.hnsw.batch_distance_counts()
+                details['distance_ops_per_query'] = packed_ops / num_queries
+            results.append(TimingResult(
+                component='secure_hnsw_batch',
+                operation=f'search_top{k}_{mode}',
+                total_time=search_total,
+                num_items=num_queries,
+                avg_time_per_item=search_total / num_queries,
+                details=details
+            ))
+            print(f"      {mode}: {search_total:.4f}s ({num_queries / search_total:.2f} queries/s)")
+        
+        # Sequential mode is search() per query; batched scoring differs only by CKKS noise
+        overlap = np.mean([len(set(a) & set(b)) / max(len(a), 1)
+                           for a, b in zip(found['sequential'], found['batched'])])
+        agree = sum(list(a) == list(b) for a, b in zip(found['sequential'], found['batched']))
+        results[-1].details.update({'overlap_with_search': float(overlap),
+                                    'identical_results': agree / num_queries})
+        print(f"      Overlap with search() top-{k}: {overlap:.3f} (identical: {agree}/{num_queries})")
+        self.results.retrieve_results.extend(results)
+        return results
+    
+    def benchmark_two_stage(self, vectors: np.ndarray, num_queries: int = None) -> List[TimingResult]:
+        """Precise-only search vs. coarse traversal plus precise rerank (index.two_stage)"""
+        if self.he_ctx.coarse is None:
+            print("\n[Retrieve Benchmark] Two-stage search disabled (index.two_stage), skipping")
+            return []
+        if num_queries is None:
+            num_queries = self.config['benchmark'].get('num_test_queries', 50)
+        k = max(self.config['benchmark'].get('retrieval_top_k', [10]))
+        
+        results = []
+        print(f"\n{'='*60}")
+        print(f"[Retrieve Benchmark] Two-stage search: {num_queries} queries, top_k={k}")
+        print(f"{'='*60}")
+        
+        handles = [self.hnsw.prepare_query(q) for q in generate_query_vectors(vectors, num_queries)]
+        found = {}
+        for mode in ('precise', 'two_stage'):
+            t0 = time.perf_counter()
+            if mode == 'precise':
+                found[mode] = [self.hnsw.hnsw.search(h, k) for h, _ in handles]
+            else:
+                found[mode] = [self.hnsw.hnsw.search_two_stage(h, c, k) for h, c in handles]
+            search_total = time.perf_counter() - t0
+            results.append(TimingResult(
+                component='secure_hnsw_two_stage',
+                operation=f'search_top{k}_{mode}',
+                total_time=search_total,
+                num_items=num_queries,
+                avg_time_per_item=search_total / num_queries
+            ))
+            print(f"      {mode}: {search_total:.4f}s ({search_total / num_queries * 1000:.1f}ms/query)")
+        
+        # Share of the precise top-k the two-stage search also returns
+        overlap = np.mean([len(set(a) & set(b)) / max(len(a), 1)
+                           for a, b in zip(found['precise'], found['two_stage'])])
+        results[-1].details = {'overlap_with_precise': float(overlap)}
+        print(f"      Overlap with precise top-{k}: {overlap:.3f}")
+        self.results.retrieve_results.extend(results)
+        return results
+    
+    def benchmark_pq(self, vectors: np.ndarray, num_queries: int = None) -> List[TimingResult]:
+        """Encrypted PQ scan (index.pq): server memory per vector, latency and recall"""
+        if not self.config['index'].get('pq', {}).get('enabled', False):
+            print("\n[Retrieve Benchmark] PQ search disabled (index.pq.enabled), skipping")
+            return []
+        if num_queries is None:
+            num_queries = self.config['benchmark'].get('num_test_queries', 50)
+        k = max(self.config['benchmark'].get('retrieval_top_k', [10]))
+        
+        results = []
+        print(f"\n{'='*60}")
+        print(f"[Retrieve Benchmark] Encrypted PQ search: {num_queries} queries, top_k={k}")
+        print(f"{'='*60}")
+        
+        pq = SecurePQWrapper(self.config)
+        t0 = time.perf_counter()
+        pq.build_index(vectors)
+        build_time = time.perf_counter() - t0
+        # Server-side bytes per vector: PQ code vs. one serialized ciphertext
+        ct_bytes = len(self.he_ctx.ctx.serialize(self.he_ctx.encrypt(vectors[0])))
+        results.append(TimingResult(
+            component='secure_pq',
+            operation='build_index',
+            total_time=build_time,
+            num_items=len(vectors),
+            avg_time_per_item=build_time / len(vectors),
+            details={'bytes_per_vector': pq.pq.code_bytes(), 'ciphertext_bytes_per_vector': ct_bytes}
+        ))
+        print(f"      Build: {build_time:.4f}s, {pq.pq.code_bytes()} B/vector "
+              f"(vs. {ct_bytes / 1024:.1f} KB ciphertext)")
+        
+        queries = generate_query_vectors(vectors, num_queries)
+        handles = [pq.prepare_query(q) for q in queries]
+        t0 = time.perf_counter()
+        found = [pq.search(h, k) for h in handles]
+        search_total = time.perf_counter() - t0
+        
+        dists = ((queries[:, None, :] - vectors[None, :, :]) ** 2).sum(axis=2)
+        truth = np.argsort(dists, axis=1)[:, :k]
+        recall = np.mean([len(set(f.tolist()) & set(t.tolist())) / k for f, t in zip(found, truth)])
+        results.append(TimingResult(
+            component='secure_pq',
+            operation=f'search_top{k}',
+            total_time=search_total,
+            num_items=num_queries,
+            avg_time_per_item=search_total / num_queries,
+            details={f'recall@{k}': float(recall), 'tables_per_query': pq.pq.table_count(),
+                     'vectors_per_ciphertext': pq.pq.lanes()}
+        ))
+        print(f"      Search: {search_total / num_queries * 1000:.1f}ms/query, recall@{k}: {recall:.3f}")
+        self.results.retrieve_results.extend(results)
+        return results
+    
+    def benchmark_plain_baseline(self, vectors: np.ndarray, num_queries: int = None) -> List[TimingResult]:
+        """
+        HE overhead vs. plaintext: PlainHNSW builds the graph, the encrypted
+        index adopts it, and both search it with the same queries. Reports the
+        search latency ratio, the share of the plaintext top-k the encrypted
+        search returns on that graph, and recall against brute force.
+        """
+        if num_queries is None:
+            num_queries = self.config['benchmark'].get('num_test_queries', 50)
+        k = max(self.config['benchmark'].get('retrieval_top_k', [10]))
+        index_config = self.config['index']
+        
+        results = []
+        print(f"\n{'='*60}")
+        print(f"[Overhead Benchmark] Plaintext vs. encrypted HNSW: {len(vectors)} vectors, "
+              f"{num_queries} queries, top_k={k}")
+        print(f"{'='*60}")
+        
+        encrypted = SecureHNSWWrapper(self.he_ctx, self.config)
+        metric_vectors = np.ascontiguousarray(encrypted._to_metric_space(vectors), dtype=np.float64)
+        plain = pprag_core.PlainHNSW(vectors.shape[1], index_config.get('hnsw_m', 16),
+                                     index_config.get('hnsw_ef_construction', 200),
+                                     index_config.get('hnsw_ef_search', 100))
+        plain.set_metric(pprag_core.parse_metric(encrypted.metric))
+        
+        t0 = time.perf_counter()
+        plain.build(metric_vectors)
+        plain_build = time.perf_counter() - t0
+        results.append(TimingResult(
+            component='plain_hnsw',
+            operation='build_index',
+            total_time=plain_build,
+            num_items=len(vectors),
+            avg_time_per_item=plain_build / len(vectors)
+        ))
+        print(f"      Plaintext build: {plain_build:.4f}s")
+        
+        print("      Encrypting vectors onto the same graph...")
+        encrypted.load_graph(vectors, plain.export_graph())
+        
+        queries = generate_query_vectors(vectors, num_queries)
+        metric_queries = np.ascontiguousarray(encrypted._to_metric_space(queries), dtype=np.float64)
+        t0 = time.perf_counter()
+        plain_found = [plain.search(q, k) for q in metric_queries]
+        plain_total = time.perf_counter() - t0
+        
+        handles = [encrypted.hnsw.prepare_query(self.he_ctx.encrypt(q)) for q in metric_queries]
+        t0 = time.perf_counter()
+        enc_found = [encrypted.hnsw.search(h, k) for h in handles]
+        enc_total = time.perf_counter() - t0
+        
+        if encrypted.metric == 'l2':
+            scores = ((metric_queries[:, None, :] - metric_vectors[None, :, :]) ** 2).sum(axis=2)
+        else:
+            scores = -(metric_queries @ metric_vectors.T)
+        truth = np.argsort(scores, axis=1)[:, :k]
+        
+        def overlap(found, expected):
+            return float(np.mean([len(set(f.tolist()) & set(e.tolist())) / k for f, e in zip(found, expected)]))
+        
+        details = {
+            'latency_ratio': enc_total / plain_total if plain_total > 0 else float('inf'),
+            'same_graph_recall': overlap(enc_found, plain_found),
+            f'plain_recall@{k}': overlap(plain_found, truth),
+            f'encrypted_recall@{k}': overlap(enc_found, truth),
+        }
+        for name, total in (('plain_hnsw', plain_total), ('secure_hnsw', enc_total)):
+            results.append(TimingResult(
+                component=name,
+                operation=f'search_top{k}_same_graph',
+                total_time=total,
+                num_items=num_queries,
+                avg_time_per_item=total / num_queries,
+                details=details if name == 'secure_hnsw' else None
+            ))
+        print(f"      Plaintext: {plain_total / num_queries * 1e6:.1f}us/query, "
+              f"encrypted: {enc_total / num_queries * 1000:.1f}ms/query")
+        print(f"      HE overhead: {details['latency_ratio']:.0f}x")
+        print(f"      Same-graph recall: {details['same_graph_recall']:.3f} "
+              f"(recall@{k}: plain {details[f'plain_recall@{k}']:.3f}, "
+              f"encrypted {details[f'encrypted_recall@{k}']:.3f})")
+        self.results.retrieve_results.extend(results)
+        return results
+    
     # ==================== Update Phase ====================
     
+    @tracks_memory('update')
     def benchmark_update(self, vectors: np.ndarray, batch_sizes: List[int] = None) -> List[TimingResult]:
         """Test Update"""
         if batch_sizes is None:
@@ -209,8 +657,10 @@ class BenchmarkRunner:
             print(f"\n--- Batch size: {batch_size} ---")
             new_vectors = generate_update_vectors(dim, batch_size)
             
+            # Incremental insert: new IDs are allocated, existing nodes are untouched
+            pprag_core.reset_latency_histograms()
             t0 = time.perf_counter()
-            self.hnsw.build_index(new_vectors)
+            new_ids = self.hnsw.insert(new_vectors)
             insert_time = time.perf_counter() - t0
             
             results.append(TimingResult(
@@ -218,13 +668,164 @@ class BenchmarkRunner:
                 operation=f'insert_batch{batch_size}',
                 total_time=insert_time,
                 num_items=batch_size,
-                avg_time_per_item=insert_time / batch_size
+                avg_time_per_item=insert_time / batch_size,
+                details=self.latency_details('insert', 'distance')
+            ))
+            print(f"      Insert Total: {insert_time:.4f}s")
+            
+            # Tombstone delete of the same batch
+            t0 = time.perf_counter()
+            self.hnsw.remove(new_ids)
+            delete_time = time.perf_counter() - t0
+            
+            results.append(TimingResult(
+                component='secure_hnsw',
+                operation=f'delete_batch{batch_size}',
+                total_time=delete_time,
+                num_items=batch_size,
+                avg_time_per_item=delete_time / batch_size
             ))
-            print(f"      Total: {insert_time:.4f}s")
+            print(f"      Delete Total: {delete_time:.4f}s")
+        
+        # Neighbor repair + reclaiming the tombstones
+        t0 = time.perf_counter()
+        reclaimed = self.hnsw.compact()
+        compact_time = time.perf_counter() - t0
+        results.append(TimingResult(
+            component='secure_hnsw',
+            operation='compact',
+            total_time=compact_time,
+            num_items=reclaimed,
+            avg_time_per_item=compact_time / max(reclaimed, 1)
+        ))
+        print(f"\n      Compact: {reclaimed} nodes reclaimed in {compact_time:.4f}s")
             
         self.results.update_results = results
         return results
     
+    def benchmark_update_concurrent(self, vectors: np.ndarray, batch_size: int = None,
+                                    num_readers: int = None) -> List[TimingResult]:
+        """Test Update throughput while reader threads keep searching"""
+        if batch_size is None:
+            batch_size = max(self.config['benchmark'].get('update_batch_sizes', [10]))
+        if num_readers is None:
+            num_readers = self.config['benchmark'].get('concurrent_readers', 2)
+        k = min(self.config['benchmark'].get('retrieval_top_k', [10]))
+        num_queries = self.config['benchmark'].get('num_test_queries', 10)
+        
+        dim = vectors.shape[1]
+        results = []
+        print(f"\n{'='*60}")
+        print(f"[Update Benchmark] Batch {batch_size} under {num_readers} concurrent readers")
+        print(f"{'='*60}")
+        
+        # Handles are shared by all reader threads
+        enc_queries = [self.hnsw.prepare_query(q) for q in generate_query_vectors(vectors, num_queries)]
+        stop = threading.Event()
+        latencies = [[] for _ in range(num_readers)]
+        
+        def reader(idx: int):
+            i = idx
+            while not stop.is_set():
+                t = time.perf_counter()
+                self.hnsw.search_encrypted(enc_queries[i % len(enc_queries)], k)
+                latencies[idx].append(time.perf_counter() - t)
+                i += 1
+        
+        threads = [threading.Thread(target=reader, args=(i,), daemon=True) for i in range(num_readers)]
+        for t in threads:
+            t.start()
+        
+        new_vectors = generate_update_vectors(dim, batch_size)
+        t0 = time.perf_counter()
+        new_ids = self.hnsw.insert(new_vectors)
+        insert_time = time.perf_counter() - t0
+        
+        t0 = time.perf_counter()
+        self.hnsw.remove(new_ids)
+        delete_time = time.perf_counter() - t0
+        
+        stop.set()
+        for t in threads:
+            t.join()
+        
+        all_lat = np.array([x for lat in latencies for x in lat]) * 1000
+        details = {
+            'readers': float(num_readers),
+            'queries_served': float(len(all_lat)),
+            'query_avg_ms': float(all_lat.mean()) if len(all_lat) else 0.0,
+            'query_p99_ms': float(np.percentile(all_lat, 99)) if len(all_lat) else 0.0,
+        }
+        
+        for op, total in (('insert', insert_time), ('delete', delete_time)):
+            results.append(TimingResult(
+                component='secure_hnsw_concurrent',
+                operation=f'{op}_batch{batch_size}',
+                total_time=total,
+                num_items=batch_size,
+                avg_time_per_item=total / batch_size,
+                details=details
+            ))
+        print(f"      Insert: {batch_size/insert_time:.2f} vectors/sec, Delete: {batch_size/delete_time:.2f} vectors/sec")
+        print(f"      Queries served meanwhile: {len(all_lat)} (avg {details['query_avg_ms']:.2f}ms, "
+              f"p99 {details['query_p99_ms']:.2f}ms)")
+        
+        self.results.update_results.extend(results)
+        return results
+    
+    # ==================== Sharded Mode ====================
+    
+    def benchmark_sharded(self, vectors: np.ndarray, num_shards: int = None,
+                          num_queries: int = None, top_k_values: List[int] = None) -> List[TimingResult]:
+        """Test build and search with the index split across worker processes"""
+        if num_shards is None:
+            num_shards = self.config['index'].get('num_shards', 2)
+        if num_queries is None:
+            num_queries = self.config['benchmark'].get('num_test_queries', 50)
+        if top_k_values is None:
+            top_k_values = self.config['benchmark'].get('retrieval_top_k', [1, 5, 10])
+        
+        n = len(vectors)
+        results = []
+        print(f"\n{'='*60}")
+        print(f"[Sharded Benchmark] {n} vectors across {num_shards} shard processes")
+        print(f"{'='*60}")
+        
+        with ShardedSecureHNSW(self.he_ctx, self.config, num_shards) as index:
+            t0 = time.perf_counter()
+            index.build_index(vectors)
+            build_time = time.perf_counter() - t0
+            results.append(TimingResult(
+                component='secure_hnsw_sharded',
+                operation='build_index_e2e',
+                total_time=build_time,
+                num_items=n,
+                avg_time_per_item=build_time / n,
+                details={'shards': float(num_shards), 'bytes_sent': float(index.bytes_sent)}
+            ))
+            print(f"      Total Build Time: {build_time:.4f}s")
+            
+            enc_queries = self.he_ctx.encrypt_batch(generate_query_vectors(vectors, num_queries))
+            for k in top_k_values:
+                index.bytes_sent = 0
+                t0 = time.perf_counter()
+                for q in enc_queries:
+                    index.search_encrypted(q, k)
+                search_total = time.perf_counter() - t0
+                results.append(TimingResult(
+                    component='secure_hnsw_sharded',
+                    operation=f'search_top{k}',
+                    total_time=search_total,
+                    num_items=num_queries,
+                    avg_time_per_item=search_total / num_queries,
+                    details={'shards': float(num_shards),
+                             'bytes_per_query': float(index.bytes_sent / num_queries)}
+                ))
+                print(f"      top_k={k}: {search_total / num_queries * 1000:.2f}ms/query")
+        
+        self.results.retrieve_results.extend(results)
+        return results
+    
     def run_all(self, output_path: str = "./results/timings.json") -> BenchmarkResult:
         print("\n" + "="*70)
         print("PP-RAG Real CKKS Benchmark Suite")
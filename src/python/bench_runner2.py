@@ -4,6 +4,7 @@ Tracks communication overhead (encrypted distances transmitted)
 """
 import time
 import json
+import atexit
 import numpy as np
 from pathlib import Path
 from typing import Dict, List, Any
@@ -14,7 +15,7 @@ from .data_generator import (
     load_config, load_dataset, get_sample_dataset,
     generate_query_vectors, generate_update_vectors
 )
-from .ckks_wrapper2 import HEContext2, SecureHNSWWrapper2
+from .ckks_wrapper2 import HEContext2, SecureHNSWWrapper2, ClientRoutingTable, pprag_core2
 
 
 @dataclass
@@ -69,6 +70,10 @@ class BenchmarkRunner2:
     def __init__(self, config_path: str = "./config/config.yaml"):
         self.config = load_config(config_path)
         
+        # One native task pool for build, search and encryption
+        bench_config = self.config.get('benchmark', {})
+        pprag_core2.set_thread_pool(bench_config.get('num_workers', 0), bench_config.get('pin_threads', False))
+        
         # Initialize HE Context - Variant 2
         print("\n[Init] Initializing CKKS Context (Variant 2)...")
         self.he_ctx = HEContext2(self.config)
@@ -83,6 +88,28 @@ class BenchmarkRunner2:
             retrieve_results=[],
             update_results=[]
         )
+        
+        # Chrome trace of the native spans, written when the process exits
+        if self.config['benchmark'].get('trace', False):
+            pprag_core2.set_tracing(True)
+            atexit.register(self.save_trace, self.config['benchmark'].get('trace_path', './results/trace.json'))
+    
+    def save_trace(self, path: str):
+        """Write buffered trace spans as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)"""
+        Path(path).parent.mkdir(parents=True, exist_ok=True)
+        pprag_core2.write_chrome_trace(path)
+        print(f"[BenchmarkRunner] {pprag_core2.trace_event_count()} trace spans saved to {path}")
+    
+    @staticmethod
+    def latency_details(*ops: str) -> Dict[str, float]:
+        """p50/p90/p99/p999 (ms) of the native per-operation histograms since the last reset"""
+        histograms = pprag_core2.latency_histograms()
+        details = {}
+        for op in ops:
+            if op in histograms:
+                for p in ('p50', 'p90', 'p99', 'p999'):
+                    details[f'{op}_{p}_ms'] = histograms[op][f'{p}_ms']
+        return details
     
     def load_data(self) -> np.ndarray:
         """Load dataset (support sampling)"""
@@ -112,6 +139,7 @@ class BenchmarkRunner2:
         # 1. Encryption Estimation
         print("\n[1/2] Benchmarking encryption throughput...")
         sample_n = min(n, 50)
+        pprag_core2.reset_latency_histograms()
         t_enc_start = time.perf_counter()
         _ = self.he_ctx.encrypt_batch(vectors[:sample_n])
         t_enc_end = time.perf_counter()
@@ -124,13 +152,15 @@ class BenchmarkRunner2:
             total_time=estimated_enc_total,
             num_items=n,
             avg_time_per_item=avg_enc_time,
-            communication_bytes=0
+            communication_bytes=0,
+            details=self.latency_details('encrypt')
         ))
         print(f"      Avg Encrypt: {avg_enc_time*1000:.4f}ms/vector")
         print(f"      Est Total Encrypt: {estimated_enc_total:.4f}s")
         
         # 2. Secure HNSW Setup (Variant 2)
         print("\n[2/2] Building Encrypted HNSW Index (Variant 2)...")
+        pprag_core2.reset_latency_histograms()
         t0 = time.perf_counter()
         _ = self.hnsw.build_index(vectors)
         build_time = time.perf_counter() - t0
@@ -142,7 +172,8 @@ class BenchmarkRunner2:
             total_time=build_time,
             num_items=n,
             avg_time_per_item=build_time / n,
-            communication_bytes=0
+            communication_bytes=0,
+            details=self.latency_details('encrypt', 'insert')
         ))
         print(f"      Total Build Time: {build_time:.4f}s")
         
@@ -166,6 +197,7 @@ class BenchmarkRunner2:
         queries = generate_query_vectors(vectors, num_queries)
         
         print("\n[1/2] Benchmarking Query Encryption...")
+        pprag_core2.reset_latency_histograms()
         t0 = time.perf_counter()
         _ = self.he_ctx.encrypt_batch(queries)
         enc_time = time.perf_counter() - t0
@@ -175,7 +207,8 @@ class BenchmarkRunner2:
             total_time=enc_time,
             num_items=num_queries,
             avg_time_per_item=enc_time / num_queries,
-            communication_bytes=0
+            communication_bytes=0,
+            details=self.latency_details('encrypt')
         ))
         print(f"      Total: {enc_time:.4f}s")
         
@@ -185,6 +218,7 @@ class BenchmarkRunner2:
             
             # Reset communication counter before search
             self.hnsw.reset_communication_counter()
+            pprag_core2.reset_latency_histograms()
             
             t_search_start = time.perf_counter()
             for q in queries:
@@ -200,7 +234,8 @@ class BenchmarkRunner2:
                 total_time=search_total,
                 num_items=num_queries,
                 avg_time_per_item=search_total / num_queries,
-                communication_bytes=comm_bytes
+                communication_bytes=comm_bytes,
+                details=self.latency_details('search', 'distance', 'decrypt')
             ))
             print(f"      Total: {search_total:.4f}s")
             print(f"      Communication: {comm_bytes / (1024*1024):.2f} MB")
@@ -208,6 +243,176 @@ class BenchmarkRunner2:
         self.results.retrieve_results = results
         return results
     
+    def benchmark_beam_widths(self, vectors: np.ndarray, beam_widths: List[int] = None,
+                              num_queries: int = None) -> List[TimingResult]:
+        """Rounds vs. distance evaluations for beam-parallel client-aided search"""
+        if beam_widths is None:
+            beam_widths = self.config['benchmark'].get('beam_widths', [1, 2, 4, 8])
+        if num_queries is None:
+            num_queries = self.config['benchmark'].get('num_test_queries', 50)
+        k = max(self.config['benchmark'].get('retrieval_top_k', [10]))
+        
+        results = []
+        print(f"\n{'='*60}")
+        print(f"[Beam Search V2] Beam widths {beam_widths}, top_k={k}")
+        print(f"{'='*60}")
+        
+        queries = generate_query_vectors(vectors, num_queries)
+        enc_queries = self.he_ctx.encrypt_batch(queries)
+        truth = [set(np.argsort(np.sum((vectors - q) ** 2, axis=1))[:k]) for q in queries]
+        default_width = self.hnsw.hnsw.beam_width()
+        
+        for w in beam_widths:
+            self.hnsw.set_beam_width(w)
+            self.hnsw.reset_communication_counter()
+            hits = 0
+            t0 = time.perf_counter()
+            for q_enc, true_ids in zip(enc_queries, truth):
+                hits += len(true_ids & set(self.hnsw.hnsw.search(q_enc, k).tolist()))
+            search_total = time.perf_counter() - t0
+            
+            rounds = self.hnsw.get_rounds() / num_queries
+            evals = self.hnsw.get_distance_evaluations() / num_queries
+            comm_bytes = self.hnsw.get_communication_bytes()
+            results.append(TimingResult(
+                component='secure_hnsw2_beam',
+                operation=f'search_top{k}_beam{w}',
+                total_time=search_total,
+                num_items=num_queries,
+                avg_time_per_item=search_total / num_queries,
+                communication_bytes=comm_bytes,
+                details={'beam_width': float(w),
+                         'rounds_per_query': rounds,
+                         'distance_evals_per_query': evals,
+                         'recall': hits / (k * num_queries)}
+            ))
+            print(f"      w={w}: {rounds:.1f} rounds/query, {evals:.1f} distances/query, "
+                  f"{comm_bytes / num_queries / 1024:.0f} KB/query, recall {hits / (k * num_queries):.3f}")
+        
+        self.hnsw.set_beam_width(default_width)
+        self.results.retrieve_results.extend(results)
+        return results
+    
+    def benchmark_client_routing(self, vectors: np.ndarray, num_queries: int = None) -> List[TimingResult]:
+        """Server-side upper-layer descent vs. client-held routing table"""
+        if num_queries is None:
+            num_queries = self.config['benchmark'].get('num_test_queries', 50)
+        k = max(self.config['benchmark'].get('retrieval_top_k', [10]))
+        
+        results = []
+        print(f"\n{'='*60}")
+        print(f"[Client Routing V2] top_k={k}")
+        print(f"{'='*60}")
+        
+        # Node IDs follow insertion order, so upper-layer plaintexts come straight from vectors
+        routing = ClientRoutingTable(self.hnsw.metric)
+        routing.refresh(self.hnsw.hnsw, lambda node_id: np.asarray(vectors[node_id], dtype=np.float64))
+        print(f"      Routing table: {len(routing.vectors)} upper-layer nodes, "
+              f"{routing.memory_bytes() / 1024:.1f} KB on the client")
+        
+        queries = generate_query_vectors(vectors, num_queries)
+        enc_queries = self.he_ctx.encrypt_batch(queries)
+        truth = [set(np.argsort(np.sum((vectors - q) ** 2, axis=1))[:k]) for q in queries]
+        
+        for mode in ('server', 'client'):
+            self.hnsw.reset_communication_counter()
+            hits = 0
+            t0 = time.perf_counter()
+            for q, q_enc, true_ids in zip(queries, enc_queries, truth):
+                if mode == 'client':
+                    found = self.hnsw.hnsw.search_from(q_enc, routing.route(q), k)
+                else:
+                    found = self.hnsw.hnsw.search(q_enc, k)
+                hits += len(true_ids & set(found.tolist()))
+            search_total = time.perf_counter() - t0
+            
+            rounds = self.hnsw.get_rounds() / num_queries
+            evals = self.hnsw.get_distance_evaluations() / num_queries
+            comm_bytes = self.hnsw.get_communication_bytes()
+            results.append(TimingResult(
+                component='secure_hnsw2_routing',
+                operation=f'search_top{k}_{mode}_routing',
+                total_time=search_total,
+                num_items=num_queries,
+                avg_time_per_item=search_total / num_queries,
+                communication_bytes=comm_bytes,
+                details={'rounds_per_query': rounds,
+                         'distance_evals_per_query': evals,
+                         'recall': hits / (k * num_queries),
+                         'routing_table_bytes': float(routing.memory_bytes())}
+            ))
+            print(f"      {mode} routing: {rounds:.1f} rounds/query, {evals:.1f} distances/query, "
+                  f"{comm_bytes / num_queries / 1024:.0f} KB/query, recall {hits / (k * num_queries):.3f}")
+        
+        self.results.retrieve_results.extend(results)
+        return results
+    
+    def benchmark_server_topk(self, vectors: np.ndarray, num_queries: int = None) -> List[TimingResult]:
+        """
+        Compare client-aided and non-interactive (encrypted comparison) top-k
+        selection over one candidate block. The comparison circuit is deep,
+        so it runs in its own context built from the server_topk config.
+        """
+        topk_config = self.config.get('server_topk', {})
+        if num_queries is None:
+            num_queries = min(self.config['benchmark'].get('num_test_queries', 50), 5)
+        block_size = topk_config.get('block_size', 8)
+        k = topk_config.get('k', 3)
+        distance_bound = topk_config.get('distance_bound', 4.0)
+        min_gap = topk_config.get('min_gap', 0.2)
+        
+        results = []
+        print(f"\n{'='*60}")
+        print(f"[Server Top-k V2] block={block_size}, k={k}, {num_queries} queries")
+        print(f"{'='*60}")
+        
+        deep_config = dict(self.config)
+        deep_config['encryption'] = {
+            key: topk_config[key] for key in ('poly_modulus_degree', 'scale_power', 'coeff_modulus_bits')
+            if key in topk_config
+        }
+        # Stored vectors stay at the top level: the comparison needs every prime
+        deep_config['index'] = {key: v for key, v in self.config.get('index', {}).items() if key != 'storage_level'}
+        he_ctx = HEContext2(deep_config)
+        index = SecureHNSWWrapper2(he_ctx, deep_config)
+        
+        block = vectors[:block_size]
+        for i, vec in enumerate(block):
+            index.hnsw.add_encrypted_node(i, he_ctx.encrypt(vec), 0)
+        candidate_ids = list(range(len(block)))
+        queries = generate_query_vectors(vectors, num_queries)
+        enc_queries = he_ctx.encrypt_batch(queries)
+        truth = [set(np.argsort(np.sum((block - q) ** 2, axis=1))[:k]) for q in queries]
+        
+        for mode in ('client', 'server'):
+            index.reset_communication_counter()
+            hits = 0
+            t0 = time.perf_counter()
+            for q_enc, true_ids in zip(enc_queries, truth):
+                if mode == 'client':
+                    selected = index.search_block_client(q_enc, candidate_ids, k)
+                else:
+                    selected = index.search_block_topk(q_enc, candidate_ids, k, distance_bound, min_gap)
+                hits += len(true_ids & set(selected))
+            total = time.perf_counter() - t0
+            comm_bytes = index.get_communication_bytes()
+            
+            results.append(TimingResult(
+                component='secure_hnsw2',
+                operation=f'block_top{k}_{mode}',
+                total_time=total,
+                num_items=num_queries,
+                avg_time_per_item=total / num_queries,
+                communication_bytes=comm_bytes,
+                details={'block_size': float(block_size),
+                         'recall': hits / (k * num_queries)}
+            ))
+            print(f"      {mode}: {total / num_queries * 1000:.2f}ms/query, "
+                  f"{comm_bytes / num_queries / 1024:.0f} KB/query, recall {hits / (k * num_queries):.3f}")
+        
+        self.results.retrieve_results.extend(results)
+        return results
+    
     # ==================== Update Phase ====================
     
     def benchmark_update(self, vectors: np.ndarray, batch_sizes: List[int] = None) -> List[TimingResult]:
@@ -225,6 +430,7 @@ class BenchmarkRunner2:
             print(f"\n--- Batch size: {batch_size} ---")
             new_vectors = generate_update_vectors(dim, batch_size)
             
+            pprag_core2.reset_latency_histograms()
             t0 = time.perf_counter()
             self.hnsw.build_index(new_vectors)
             insert_time = time.perf_counter() - t0
@@ -235,7 +441,8 @@ class BenchmarkRunner2:
                 total_time=insert_time,
                 num_items=batch_size,
                 avg_time_per_item=insert_time / batch_size,
-                communication_bytes=0
+                communication_bytes=0,
+                details=self.latency_details('insert', 'distance')
             ))
             print(f"      Total: {insert_time:.4f}s")
             
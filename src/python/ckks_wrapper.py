@@ -2,12 +2,23 @@
 ckks_wrapper.py
 High-level Wrapper for Real CKKS C++ Module
 """
+import os
 import sys
 import numpy as np
 from typing import List, Optional
 
+from .data_generator import normalize_rows
+
+# PPRAG_SIM_BACKEND=1 loads the cost-model simulator build instead: same API,
+# plaintext arithmetic and per-level op counts, no encryption (see cost_model.py)
+SIM_BACKEND = os.environ.get('PPRAG_SIM_BACKEND', '0') not in ('', '0')
+
 try:
-    import pprag_core
+    if SIM_BACKEND:
+        import pprag_core_sim as pprag_core
+        print("[HE] Using simulator backend (pprag_core_sim): op counts only, no encryption")
+    else:
+        import pprag_core
 except ImportError:
     print("CRITICAL ERROR: 'pprag_core' C++ module not found.")
     print("Please compile the C++ extension:")
@@ -23,11 +34,19 @@ class HEContext:
         poly_modulus_degree = enc_config.get('poly_modulus_degree', 8192)
         scale_power = enc_config.get('scale_power', 40)
         scale = 2.0 ** scale_power
+        # Prime sizes of the modulus chain; deeper circuits need more primes
+        coeff_modulus_bits = enc_config.get('coeff_modulus_bits', [60, 40, 40, 60])
         
         # Initialize CKKS context with configured parameters
-        self.ctx = pprag_core.CKKSContext(poly_modulus_degree, scale)
+        self.ctx = pprag_core.CKKSContext(poly_modulus_degree, scale, coeff_modulus_bits)
         print(f"[HE] Initialized CKKS Context (slots={self.ctx.slot_count()})")
         
+        # Small fast context for two-stage search traversal, shared by every index on these keys
+        self.coarse = None
+        index_config = config.get('index', {})
+        if index_config.get('two_stage', False):
+            self.coarse = HEContext({'encryption': index_config.get('coarse_encryption', {})})
+        
     def encrypt(self, vector: np.ndarray):
         """Encrypt a numpy vector"""
         # Ensure vector is float64
@@ -38,12 +57,66 @@ class HEContext:
             raise ValueError("Only 1D vectors supported for single encryption")
             
     def encrypt_batch(self, vectors: np.ndarray):
-        """Encrypt multiple vectors"""
-        return [self.encrypt(v) for v in vectors]
+        """Encrypt multiple vectors (in parallel on the native task scheduler)"""
+        if len(vectors) == 0:
+            return []
+        return self.ctx.encrypt_batch(np.ascontiguousarray(vectors, dtype=np.float64))
         
     def decrypt(self, ciphertext) -> np.ndarray:
         """Decrypt to numpy vector"""
         return self.ctx.decrypt_vector(ciphertext)
+    
+    def memory_usage(self) -> dict:
+        """Key bytes by key type plus 'total'; coarse keys are prefixed 'coarse_'"""
+        usage = dict(self.ctx.memory_usage())
+        if self.coarse is not None:
+            coarse = self.coarse.memory_usage()
+            usage.update({f'coarse_{name}': b for name, b in coarse.items() if name != 'total'})
+            usage['total'] += coarse['total']
+        return usage
+
+class SecurePQWrapper:
+    """
+    Encrypted product-quantization index: the server keeps index.pq.m bytes
+    of plaintext PQ code per vector, queries stay encrypted and distances are
+    assembled from encrypted subspace tables (see secure_pq.cpp). The scan
+    needs three levels, so it runs under its own context (index.pq.encryption).
+    """
+    def __init__(self, config: dict, he_ctx: HEContext = None):
+        pq_config = config.get('index', {}).get('pq', {})
+        if he_ctx is None:
+            he_ctx = HEContext({'encryption': pq_config.get('encryption', config.get('encryption', {}))})
+        self.he_ctx = he_ctx
+        self.m = pq_config.get('m', 32)
+        self.ks = pq_config.get('ks', 256)
+        self.train_iters = pq_config.get('train_iters', 10)
+        self.temperature = pq_config.get('kmeans_temperature', 0.01)
+        self.train_samples = pq_config.get('train_samples', 5000)
+        self.seed = pq_config.get('seed', 0)
+        self.pq = None
+        
+    def build_index(self, vectors: np.ndarray):
+        """Train codebooks on a sample (client side) and store the codes"""
+        vectors = np.ascontiguousarray(vectors, dtype=np.float64)
+        self.pq = pprag_core.SecurePQIndex(self.he_ctx.ctx, vectors.shape[1], self.m, self.ks,
+                                           self.train_iters, self.temperature)
+        rng = np.random.default_rng(self.seed)
+        sample = vectors[rng.choice(len(vectors), min(len(vectors), self.train_samples), replace=False)]
+        print(f"[PQ] Training {self.m} codebooks x {self.ks} centroids on {len(sample)} vectors...")
+        self.pq.train(sample)
+        self.pq.add_codes(self.pq.encode(vectors))
+        print(f"[PQ] Stored {self.pq.size()} codes ({self.pq.code_bytes()} bytes each)")
+        
+    def prepare_query(self, query: np.ndarray):
+        """Encrypt the query in the subspace-block layout the scan expects"""
+        return self.he_ctx.encrypt(self.pq.query_layout(np.asarray(query, dtype=np.float64)))
+        
+    def search(self, query, k: int = 10, candidates: Optional[List[int]] = None):
+        """Top-k by PQ distance over every code, or over candidates (e.g. a shortlist)"""
+        if isinstance(query, np.ndarray):
+            query = self.prepare_query(query)
+        return self.pq.search(query, k, list(candidates) if candidates is not None else [])
+
 
 class SecureHNSWWrapper:
     def __init__(self, he_ctx: HEContext, config: dict):
@@ -54,48 +127,206 @@ class SecureHNSWWrapper:
         
         self.hnsw = pprag_core.SecureHNSWEncrypted(he_ctx.ctx, M, ef_c, ef_s)
         self.he_ctx = he_ctx
+        # Similarity metric: l2, ip or cosine (cosine normalizes on the client before encrypting)
+        self.metric = index_config.get('metric', 'l2')
+        self.hnsw.set_metric(pprag_core.parse_metric(self.metric))
+        # Score a node against many packed queries at once in search_batch
+        self.query_batching = index_config.get('query_batching', False)
+        self.dim = None
+        # Share of layer-0 nodes cross-linked when merging separately built graphs
+        self.merge_sample_fraction = index_config.get('merge_sample_fraction', 0.1)
+        # Stage worker counts and queue capacity of ingest_npy
+        self.ingest_config = dict(index_config.get('ingest') or {})
+        
+        # Two-stage search: a small fast context drives traversal, he_ctx reranks the candidates
+        self.coarse_ctx = he_ctx.coarse
+        if self.coarse_ctx is not None:
+            self.hnsw.set_coarse_context(self.coarse_ctx.ctx)
+        # Traversal vectors projected client-side to fewer dimensions: none, pca or random
+        self.projection_kind = index_config.get('projection', 'none')
+        self.projection_dim = index_config.get('projection_dim', 128)
+        self.projection_seed = index_config.get('projection_seed', 0)
+        self.projection_fit_samples = index_config.get('projection_fit_samples', 5000)
+        self.projection = None
+        if self.projection_kind != 'none' and self.coarse_ctx is None:
+            raise ValueError(f"projection '{self.projection_kind}' only applies to two-stage "
+                             f"traversal vectors; set index.two_stage or projection: none")
+        
+        # Optionally keep stored vectors at a lower modulus level ("min" = lowest the distance needs)
+        storage_level = index_config.get('storage_level')
+        if storage_level is not None:
+            if storage_level == 'min':
+                storage_level = self.hnsw.min_storage_level()
+            self.hnsw.set_storage_level(int(storage_level))
         
     def build_index(self, vectors: np.ndarray):
         """Build index from plaintext vectors (encrypts them internally)"""
         print(f"[HNSW] Building Encrypted Index for {len(vectors)} vectors...")
-        # Since our C++ SecureHNSWEncrypted stores ciphertexts, we need to encrypt and add them
-        # Note: "build" usually implies batch. We can iterate.
-        
-        # We assume vectors are plaintext here and we encrypt them one by one to add
-        # Alternatively, we could parallelize encryption in Python
-        
+        self.prepare_layout(vectors)
+        # Pre-size node storage so ingestion never reallocates
+        self.hnsw.reserve(len(vectors))
         for i, vec in enumerate(vectors):
-            enc_vec = self.he_ctx.encrypt(vec)
-            # Default level 0 for now, or use random level logic within C++?
-            # Our C++ implementation of add_encrypted_node expects 'level'. 
-            # The random level generation should ideally be inside the class or exposed.
-            # But add_encrypted_node logic in my C++ code:
-            # "if (id >= node_vectors_.size())... nodes_[id].level = level"
-            # It seems the caller must decide the level.
-            # We need a random level generator here similar to HNSW standard.
-            
-            level = self._random_level()
-            self.hnsw.add_encrypted_node(i, enc_vec, level)
+            vec = self._to_metric_space(vec)
+            # Random level and neighbor linking happen in C++
+            if self.coarse_ctx is not None:
+                self.hnsw.insert(self.he_ctx.encrypt(vec), self.coarse_ctx.encrypt(self._coarse_space(vec)))
+            else:
+                self.hnsw.insert(self.he_ctx.encrypt(vec))
             
             if (i+1) % 100 == 0:
                 print(f"[HNSW] Indexed {i+1}/{len(vectors)}", end='\r')
         print(f"\n[HNSW] Build complete.")
         return [] # Timings?
         
-    def search(self, query: np.ndarray, k: int = 10):
-        # Encrypt query
-        q_enc = self.he_ctx.encrypt(query)
-        # Search
-        return self.hnsw.search(q_enc, k)
-        
-    def _random_level(self):
-        # Simple Python random level generator
-        # M_ is 16 usually. mult = 1/log(M)
-        import math
-        import random
-        mult = 1.0 / math.log(16)
-        level = 0
-        while random.random() < math.exp(-mult) and level < 16:
-            level += 1
-        return level
-
+    def load_graph(self, vectors: np.ndarray, graph):
+        """
+        Encrypt vectors under their IDs and adopt a graph built elsewhere
+        (e.g. PlainHNSW.export_graph() on the same vectors), so encrypted and
+        plaintext search walk the same graph
+        """
+        self.prepare_layout(vectors)
+        self.hnsw.reserve(len(vectors))
+        for i, vec in enumerate(vectors):
+            vec = self._to_metric_space(vec)
+            self.hnsw.add_encrypted_node(i, self.he_ctx.encrypt(vec), graph.levels[i])
+            if self.coarse_ctx is not None:
+                self.hnsw.add_coarse_vector(i, self.coarse_ctx.encrypt(self._coarse_space(vec)))
+        self.hnsw.load_graph(graph)
+        
+    def ingest_npy(self, path: str, begin: int = 0, end: int = -1, **workers) -> dict:
+        """
+        Stream rows [begin, end) of an .npy file into the index natively: the
+        file is memory-mapped and rows flow read -> encode -> encrypt -> insert
+        through bounded queues, never entering Python. Worker counts come from
+        index.ingest in config.yaml unless given as keyword arguments. Returns
+        rows, seconds, rows_per_second, per-stage workers and busy_seconds,
+        and ids (index ID of each row).
+        """
+        if self.coarse_ctx is not None:
+            raise ValueError("ingest_npy: two-stage indexes need coarse vectors, use insert()")
+        if self.dim is None:
+            self.dim = pprag_core.npy_shape(path)[1]
+            self.hnsw.set_dimension(self.dim)
+        options = dict(self.ingest_config, **workers)
+        print(f"[HNSW] Ingesting {path} ({options})...")
+        stats = pprag_core.ingest_npy(self.hnsw, self.he_ctx.ctx, path,
+                                      normalize=self.metric == 'cosine', begin=begin, end=end,
+                                      merge_sample_fraction=self.merge_sample_fraction, **options)
+        print(f"[HNSW] Ingested {stats['rows']} vectors in {stats['seconds']:.2f}s "
+              f"({stats['rows_per_second']:.1f} vectors/s)")
+        return stats
+        
+    def insert(self, vectors: np.ndarray) -> List[int]:
+        """Encrypt and incrementally insert vectors; returns the assigned IDs"""
+        if self.dim is None:
+            self.prepare_layout(vectors)
+        if self.coarse_ctx is not None:
+            return [self.hnsw.insert(self.he_ctx.encrypt(v), self.coarse_ctx.encrypt(self._coarse_space(v)))
+                    for v in map(self._to_metric_space, vectors)]
+        return [self.hnsw.insert(self.he_ctx.encrypt(self._to_metric_space(vec))) for vec in vectors]
+        
+    def remove(self, ids: List[int]):
+        """Tombstone nodes (skipped by search, repaired in the background)"""
+        for node_id in ids:
+            self.hnsw.remove(int(node_id))
+            
+    def merge(self, other: 'SecureHNSWWrapper', sample_fraction: float = None) -> int:
+        """Merge another index built under the same keys; its IDs shift by the returned offset"""
+        if sample_fraction is None:
+            sample_fraction = self.merge_sample_fraction
+        return self.hnsw.merge(other.hnsw, sample_fraction)
+        
+    def compact(self) -> int:
+        """Repair pending neighbors and reclaim tombstoned nodes"""
+        return self.hnsw.compact()
+        
+    def memory_usage(self) -> dict:
+        """Index bytes: ciphertexts by chain level, adjacency, overhead and 'total'"""
+        return self.hnsw.memory_usage()
+        
+    def prepare_query(self, query: np.ndarray):
+        """
+        Encrypt and preprocess a query once; the handle can be reused across
+        searches. In two-stage mode it is a (precise, coarse) handle pair.
+        """
+        vec = self._to_metric_space(query)
+        handle = self.hnsw.prepare_query(self.he_ctx.encrypt(vec))
+        if self.coarse_ctx is None:
+            return handle
+        return handle, self.hnsw.prepare_coarse_query(self.coarse_ctx.encrypt(self._coarse_space(vec)))
+        
+    def search(self, query, k: int = 10):
+        """Search with a plaintext query or a handle from prepare_query"""
+        if isinstance(query, np.ndarray):
+            query = self.prepare_query(query)
+        return self._search_handle(query, k)
+        
+    def search_batch(self, queries, k: int = 10, batched: bool = None) -> List[np.ndarray]:
+        """
+        Search several queries (plaintext vectors or prepared handles). With
+        query batching, queries are packed into shared ciphertexts and walk
+        the graph in lockstep; results approximate searching one by one
+        (packed scoring carries different CKKS noise, so near-ties can flip).
+        """
+        if batched is None:
+            batched = self.query_batching
+        handles = [self.prepare_query(q) if isinstance(q, np.ndarray) else q for q in queries]
+        # Lockstep packing runs on the precise context only; two-stage searches go one by one
+        if batched and self.dim is not None and self.coarse_ctx is None:
+            return self.hnsw.search_batch(handles, k, self.dim)
+        return [self._search_handle(h, k) for h in handles]
+        
+    def search_parallel(self, queries, k: int = 10) -> List[np.ndarray]:
+        """
+        Search several queries (plaintext vectors or prepared handles) as
+        parallel native tasks; each search also scores neighbors in parallel
+        on the same pool, so this never oversubscribes the cores
+        """
+        handles = [self.prepare_query(q) if isinstance(q, np.ndarray) else q for q in queries]
+        if self.coarse_ctx is not None:
+            return [self._search_handle(h, k) for h in handles]
+        return self.hnsw.search_parallel(handles, k)
+        
+    def search_encrypted(self, q_enc, k: int = 10):
+        """Search with an already encrypted query or handle (safe to call from several threads)"""
+        return self._search_handle(q_enc, k)
+        
+    def _search_handle(self, handle, k: int):
+        if isinstance(handle, tuple):
+            return self.hnsw.search_two_stage(handle[0], handle[1], k)
+        return self.hnsw.search(handle, k)
+        
+    def prepare_layout(self, vectors: np.ndarray, projection=None):
+        """
+        Record the vector dimension (the distance reduction then rotates over
+        log2(dim) slots only) and fit or adopt the traversal projection.
+        Indexes that will be merged must share one projection.
+        """
+        self.dim = vectors.shape[1]
+        self.hnsw.set_dimension(self.dim)
+        if self.coarse_ctx is None:
+            return
+        if projection is not None:
+            self.projection = projection
+        elif self.projection is None and self.projection_kind != 'none' and self.projection_dim < self.dim:
+            self.projection = self._fit_projection(vectors)
+        self.hnsw.set_coarse_dimension(self.projection.out_dim() if self.projection else self.dim)
+        
+    def _fit_projection(self, vectors: np.ndarray):
+        if self.projection_kind == 'random':
+            return pprag_core.Projection.random_orthogonal(self.dim, self.projection_dim, self.projection_seed)
+        if self.projection_kind == 'pca':
+            rng = np.random.default_rng(self.projection_seed)
+            sample = vectors[rng.choice(len(vectors), min(len(vectors), self.projection_fit_samples), replace=False)]
+            sample = np.ascontiguousarray(self._to_metric_space(sample), dtype=np.float64)
+            print(f"[HNSW] Fitting PCA projection {self.dim} -> {self.projection_dim} on {len(sample)} vectors")
+            return pprag_core.Projection.pca(sample, self.projection_dim, seed=self.projection_seed)
+        raise ValueError(f"unknown projection '{self.projection_kind}' (expected none, pca or random)")
+        
+    def _coarse_space(self, vec: np.ndarray) -> np.ndarray:
+        """Traversal vectors: projected when a projection is configured"""
+        return self.projection.apply(vec) if self.projection is not None else vec
+        
+    def _to_metric_space(self, vec: np.ndarray) -> np.ndarray:
+        """Cosine compares unit vectors, so they are normalized before encryption"""
+        return normalize_rows(vec) if self.metric == 'cosine' else vec
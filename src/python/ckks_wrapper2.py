@@ -7,23 +7,34 @@ import os
 import numpy as np
 from typing import List, Optional
 
+from .data_generator import normalize_rows
+
 # Add current directory and parent directory to path for importing compiled modules
 sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
 sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
 sys.path.insert(0, os.getcwd())
 
+# PPRAG_SIM_BACKEND=1 loads both modules from the cost-model simulator build
+SIM_BACKEND = os.environ.get('PPRAG_SIM_BACKEND', '0') not in ('', '0')
+
 # Import pprag_core for base classes (CKKSContext, Ciphertext)
 try:
-    import pprag_core
-    print("[HE] Using pprag_core module for base classes")
+    if SIM_BACKEND:
+        import pprag_core_sim as pprag_core
+    else:
+        import pprag_core
+    print(f"[HE] Using {pprag_core.__name__} module for base classes")
 except ImportError:
     print("ERROR: pprag_core not found, needed for CKKSContext")
     raise
 
 # Import pprag_core2 for variant 2 implementation (SecureHNSWEncrypted2)
 try:
-    import pprag_core2
-    print("[HE] Using pprag_core2 module for SecureHNSWEncrypted2")
+    if SIM_BACKEND:
+        import pprag_core2_sim as pprag_core2
+    else:
+        import pprag_core2
+    print(f"[HE] Using {pprag_core2.__name__} module for SecureHNSWEncrypted2")
 except ImportError:
     print("ERROR: pprag_core2 not found, needed for SecureHNSWEncrypted2")
     raise
@@ -35,9 +46,11 @@ class HEContext2:
         poly_modulus_degree = enc_config.get('poly_modulus_degree', 8192)
         scale_power = enc_config.get('scale_power', 40)
         scale = 2.0 ** scale_power
+        # Prime sizes of the modulus chain; deeper circuits need more primes
+        coeff_modulus_bits = enc_config.get('coeff_modulus_bits', [60, 40, 40, 60])
         
         # Initialize CKKS context with configured parameters
-        self.ctx = pprag_core.CKKSContext(poly_modulus_degree, scale)
+        self.ctx = pprag_core.CKKSContext(poly_modulus_degree, scale, coeff_modulus_bits)
         print(f"[HE] Initialized CKKS Context (slots={self.ctx.slot_count()})")
         
     def encrypt(self, vector: np.ndarray):
@@ -57,6 +70,59 @@ class HEContext2:
         """Decrypt to numpy vector"""
         return self.ctx.decrypt_vector(ciphertext)
 
+class ClientRoutingTable:
+    """
+    Plaintext copy of the upper HNSW layers, held by the client
+    
+    Upper layers hold about N/M^l nodes, so keeping their vectors and
+    adjacency on the client is cheap. The client descends them locally and
+    only the resulting layer-0 entry point goes to the server.
+    """
+    def __init__(self, metric: str = 'l2'):
+        self.metric = metric  # l2 and cosine (unit vectors) descend by L2, ip by inner product
+        self.vectors = {}     # node id -> plaintext vector (upper-layer nodes only)
+        self.neighbors = {}   # (node id, level) -> neighbor ids
+        self.entry_point = -1
+        self.max_level = 0
+    
+    def refresh(self, hnsw, vector_of):
+        """Re-sync adjacency from the server graph; vector_of(id) supplies plaintexts of new upper nodes"""
+        self.neighbors.clear()
+        for node_id, level in hnsw.upper_layer_nodes():
+            if node_id not in self.vectors:
+                self.vectors[node_id] = vector_of(node_id)
+            for l in range(1, level + 1):
+                self.neighbors[(node_id, l)] = hnsw.get_neighbors(node_id, l)
+        self.entry_point = hnsw.entry_point()
+        self.max_level = hnsw.max_level()
+    
+    def route(self, query: np.ndarray) -> int:
+        """Greedy descent through the upper layers; returns the layer-0 entry point"""
+        curr = self.entry_point
+        if self.max_level == 0:
+            return curr
+        best = self._distance(curr, query)
+        for level in range(self.max_level, 0, -1):
+            improved = True
+            while improved:
+                improved = False
+                for n in self.neighbors.get((curr, level), []):
+                    d = self._distance(n, query)
+                    if d < best:
+                        curr, best = n, d
+                        improved = True
+        return curr
+    
+    def _distance(self, node_id: int, query: np.ndarray) -> float:
+        if self.metric == 'ip':
+            return -float(np.dot(self.vectors[node_id], query))
+        return float(np.sum((self.vectors[node_id] - query) ** 2))
+    
+    def memory_bytes(self) -> int:
+        return sum(v.nbytes for v in self.vectors.values()) + \
+               sum(4 * len(links) for links in self.neighbors.values())
+
+
 class SecureHNSWWrapper2:
     """
     Variant 2: Hybrid HNSW with Partial Client-Side Decryption
@@ -83,44 +149,97 @@ class SecureHNSWWrapper2:
         
         self.he_ctx = he_ctx
         
+        # Similarity metric: l2, ip or cosine (cosine normalizes on the client before encrypting)
+        self.metric = index_config.get('metric', 'l2')
+        self.hnsw.set_metric(pprag_core.parse_metric(self.metric))
+        
+        # Client keeps the upper layers in plaintext and routes locally
+        self.routing = ClientRoutingTable(self.metric) if index_config.get('client_routing', False) else None
+        
+        # Candidates expanded per client round during search
+        if hasattr(self.hnsw, 'set_beam_width'):
+            self.hnsw.set_beam_width(index_config.get('beam_width', 1))
+        
+        # Optionally keep stored vectors at a lower modulus level ("min" = lowest the distance needs)
+        storage_level = index_config.get('storage_level')
+        if storage_level is not None:
+            if storage_level == 'min':
+                storage_level = self.hnsw.min_storage_level()
+                # Packing a round's distances into one reply costs a level, so keep one spare
+                # whenever any configured beam width expands several candidates per round
+                widths = [index_config.get('beam_width', 1)] + list(config.get('benchmark', {}).get('beam_widths', []))
+                if max(widths) > 1:
+                    storage_level += 1
+            self.hnsw.set_storage_level(int(storage_level))
+        
     def build_index(self, vectors: np.ndarray):
         """Build index from plaintext vectors (encrypts them internally)"""
         print(f"[HNSW2] Building Encrypted Index for {len(vectors)} vectors...")
+        # Pre-size node storage so ingestion never reallocates
+        self.hnsw.reserve(len(vectors))
         
+        upper_vectors = {}
         for i, vec in enumerate(vectors):
+            vec = self._to_metric_space(vec)
             enc_vec = self.he_ctx.encrypt(vec)
-            level = self._random_level()
-            self.hnsw.add_encrypted_node(i, enc_vec, level)
+            # Random level and neighbor linking happen in C++
+            node_id = self.hnsw.insert(enc_vec)
+            if self.routing is not None and self.hnsw.node_level(node_id) >= 1:
+                upper_vectors[node_id] = np.asarray(vec, dtype=np.float64)
             
             if (i+1) % 100 == 0:
                 print(f"[HNSW2] Indexed {i+1}/{len(vectors)}", end='\r')
         print(f"\n[HNSW2] Build complete.")
+        
+        if self.routing is not None:
+            self.routing.refresh(self.hnsw, upper_vectors.__getitem__)
+            print(f"[HNSW2] Client routing table: {len(self.routing.vectors)} upper-layer nodes, "
+                  f"{self.routing.memory_bytes() / 1024:.1f} KB")
         return [] # Timings?
         
     def search(self, query: np.ndarray, k: int = 10):
         """Search encrypted index"""
         # Encrypt query
+        query = self._to_metric_space(query)
         q_enc = self.he_ctx.encrypt(query)
+        # Client-side routing: only the layer-0 entry point goes to the server
+        if self.routing is not None:
+            return self.hnsw.search_from(q_enc, self.routing.route(query), k)
         # Search
         return self.hnsw.search(q_enc, k)
     
+    def _to_metric_space(self, vec: np.ndarray) -> np.ndarray:
+        """Cosine compares unit vectors, so they are normalized before encryption"""
+        return normalize_rows(vec) if self.metric == 'cosine' else vec
+    
+    def search_block_topk(self, q_enc, candidate_ids: List[int], k: int,
+                          distance_bound: float = 4.0, min_gap: float = 0.2) -> List[int]:
+        """Server-side top-k over a candidate block (one ciphertext returned)"""
+        return self.hnsw.search_block_topk(q_enc, list(candidate_ids), k, distance_bound, min_gap)
+    
+    def search_block_client(self, q_enc, candidate_ids: List[int], k: int) -> List[int]:
+        """Client-aided top-k over a candidate block (one ciphertext per candidate)"""
+        return self.hnsw.search_block_client(q_enc, list(candidate_ids), k)
+    
     def get_communication_bytes(self) -> int:
         """Get total communication overhead in bytes"""
         if hasattr(self.hnsw, 'get_communication_bytes'):
             return self.hnsw.get_communication_bytes()
         return 0
     
+    def set_beam_width(self, w: int):
+        """Candidates expanded per client round"""
+        self.hnsw.set_beam_width(w)
+    
+    def get_rounds(self) -> int:
+        """Client round trips since the last counter reset"""
+        return self.hnsw.get_rounds()
+    
+    def get_distance_evaluations(self) -> int:
+        """Encrypted distances computed since the last counter reset"""
+        return self.hnsw.get_distance_evaluations()
+    
     def reset_communication_counter(self):
         """Reset communication counter"""
         if hasattr(self.hnsw, 'reset_communication_counter'):
             self.hnsw.reset_communication_counter()
-        
-    def _random_level(self):
-        # Simple Python random level generator
-        import math
-        import random
-        mult = 1.0 / math.log(16)
-        level = 0
-        while random.random() < math.exp(-mult) and level < 16:
-            level += 1
-        return level
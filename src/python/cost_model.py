@@ -0,0 +1,58 @@
+"""
+cost_model.py
+Predict HE wall time from simulated op counts
+
+The simulator build (pprag_core_sim) runs the index code on plaintext and
+counts every CKKS primitive by chain index. A CostModel holds the per-call
+cost of each (op, level) measured on real SEAL by
+scripts/09_calibrate_op_costs.py and turns those counts into seconds.
+"""
+import json
+from pathlib import Path
+from typing import Dict
+
+DEFAULT_COSTS_PATH = "./config/op_costs.json"
+
+
+class CostModel:
+    def __init__(self, costs: Dict[str, Dict[int, float]], meta: dict = None):
+        # op name -> chain index -> seconds per call
+        self.costs = {op: {int(level): float(s) for level, s in per_level.items()}
+                      for op, per_level in costs.items()}
+        # Machine and CKKS parameters the costs were measured with
+        self.meta = meta or {}
+
+    @classmethod
+    def load(cls, path: str = DEFAULT_COSTS_PATH) -> 'CostModel':
+        with open(path, 'r', encoding='utf-8') as f:
+            data = json.load(f)
+        return cls(data['costs'], data.get('meta'))
+
+    def save(self, path: str = DEFAULT_COSTS_PATH):
+        Path(path).parent.mkdir(parents=True, exist_ok=True)
+        with open(path, 'w', encoding='utf-8') as f:
+            json.dump({'meta': self.meta, 'costs': self.costs}, f, indent=2)
+        print(f"[CostModel] Op costs saved to {path}")
+
+    def op_cost(self, op: str, level: int) -> float:
+        """Seconds per call; an uncalibrated level takes the nearest calibrated one"""
+        per_level = self.costs.get(op)
+        if not per_level:
+            raise KeyError(f"no calibrated cost for op '{op}'; rerun 09_calibrate_op_costs.py")
+        if level in per_level:
+            return per_level[level]
+        nearest = min(per_level, key=lambda l: abs(l - level))
+        return per_level[nearest]
+
+    def breakdown(self, counts: Dict[str, Dict[int, int]]) -> Dict[str, float]:
+        """Predicted seconds per op for counts from sim_op_counts()"""
+        return {op: sum(n * self.op_cost(op, int(level)) for level, n in per_level.items())
+                for op, per_level in counts.items()}
+
+    def predict(self, counts: Dict[str, Dict[int, int]]) -> float:
+        """Predicted total seconds"""
+        return sum(self.breakdown(counts).values())
+
+
+def total_ops(counts: Dict[str, Dict[int, int]]) -> int:
+    return sum(sum(per_level.values()) for per_level in counts.values())
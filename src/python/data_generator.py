@@ -45,6 +45,12 @@ def generate_synthetic_embeddings(
     return data
 
 
+def normalize_rows(data: np.ndarray) -> np.ndarray:
+    """Scale each vector (last axis) to unit L2 norm."""
+    norms = np.linalg.norm(data, axis=-1, keepdims=True)
+    return data / np.maximum(norms, 1e-10)
+
+
 def generate_query_vectors(
     dataset: np.ndarray,
     num_queries: int,
@@ -0,0 +1,181 @@
+"""
+load_generator.py
+Open-loop load generation for retrieval latency under load
+
+A closed loop sends the next query only when the previous one returns, so a
+slow server is simply offered less load and queueing delay never shows. Here
+queries arrive on a Poisson schedule at a target rate whatever the server
+does, and wait in an unbounded queue for one of a fixed pool of worker
+threads. Latency runs from the scheduled arrival to completion, so time spent
+waiting for a free worker counts (no coordinated omission). Native searches
+release the GIL, so the workers search concurrently.
+"""
+import time
+import queue
+import threading
+import numpy as np
+from dataclasses import dataclass, asdict
+from typing import Callable, List, Optional, Sequence, Tuple
+
+
+@dataclass
+class LoadLevel:
+    """Latency distribution of one target rate (milliseconds)"""
+    target_qps: float
+    offered_qps: float       # arrivals actually drawn / duration (Poisson noise around the target)
+    achieved_qps: float      # completions / time until the window closed or the backlog drained
+    offered: int
+    completed: int
+    errors: int
+    duration_s: float        # arrival window; draining the backlog may take longer
+    mean_ms: float
+    p50_ms: float
+    p90_ms: float
+    p99_ms: float
+    p999_ms: float
+    max_ms: float
+    queue_wait_p50_ms: float
+    queue_wait_p99_ms: float
+
+    def to_dict(self) -> dict:
+        return asdict(self)
+
+    def keeps_up(self, latency_slo_ms: float, rate_tolerance: float = 0.95) -> bool:
+        """Served the offered rate without errors and with p99 inside the SLO"""
+        return (self.errors == 0 and not self.fell_behind(rate_tolerance)
+                and self.p99_ms <= latency_slo_ms)
+
+    def fell_behind(self, rate_tolerance: float = 0.95) -> bool:
+        return self.achieved_qps < rate_tolerance * self.offered_qps
+
+
+class OpenLoopGenerator:
+    """
+    Drives execute(request) at Poisson arrival times; requests are cycled
+    through in order. execute must be safe to call from several threads.
+    """
+
+    def __init__(self, execute: Callable[[object], object], requests: Sequence,
+                 workers: int = 4, seed: int = 0):
+        if not requests:
+            raise ValueError("OpenLoopGenerator needs at least one request")
+        self.execute = execute
+        self.requests = list(requests)
+        self.workers = max(1, int(workers))
+        self.rng = np.random.default_rng(seed)
+
+    def arrivals(self, qps: float, duration_s: float) -> np.ndarray:
+        """Arrival offsets (s) of a Poisson process: exponential gaps with mean 1/qps"""
+        if qps <= 0:
+            raise ValueError(f"target rate must be positive, got {qps}")
+        expected = int(qps * duration_s)
+        gaps = self.rng.exponential(1.0 / qps, size=expected + 8 * int(np.sqrt(expected)) + 16)
+        times = np.cumsum(gaps)
+        return times[times < duration_s]
+
+    def service_time(self, samples: int = 5) -> float:
+        """Mean seconds per request on an idle server (one request at a time)"""
+        t0 = time.perf_counter()
+        for i in range(samples):
+            self.execute(self.requests[i % len(self.requests)])
+        return (time.perf_counter() - t0) / samples
+
+    def run(self, qps: float, duration_s: float) -> LoadLevel:
+        offsets = self.arrivals(qps, duration_s)
+        n = len(offsets)
+        started = np.zeros(n)
+        finished = np.zeros(n)
+        failed = np.zeros(n, dtype=bool)
+        pending: queue.Queue = queue.Queue()
+
+        def worker():
+            while True:
+                i = pending.get()
+                if i is None:
+                    return
+                started[i] = time.perf_counter()
+                try:
+                    self.execute(self.requests[i % len(self.requests)])
+                except Exception:
+                    failed[i] = True
+                finished[i] = time.perf_counter()
+
+        threads = [threading.Thread(target=worker, daemon=True) for _ in range(self.workers)]
+        for t in threads:
+            t.start()
+        t0 = time.perf_counter()
+        scheduled = t0 + offsets
+        for i in range(n):
+            # Dispatch on schedule whatever the backlog; a late dispatcher only
+            # delays the put, latency still counts from the scheduled time
+            delay = scheduled[i] - time.perf_counter()
+            if delay > 0:
+                time.sleep(delay)
+            pending.put(i)
+        for _ in threads:
+            pending.put(None)
+        for t in threads:
+            t.join()
+
+        ok = ~failed
+        latency = (finished - scheduled)[ok] * 1000
+        wait = (started - scheduled)[ok] * 1000
+        elapsed = max(duration_s, (finished.max() - t0) if n else 0.0)
+
+        def pct(values, q):
+            return float(np.percentile(values, q)) if len(values) else 0.0
+
+        return LoadLevel(
+            target_qps=float(qps),
+            offered_qps=n / duration_s,
+            achieved_qps=float(ok.sum() / elapsed),
+            offered=n,
+            completed=int(ok.sum()),
+            errors=int(failed.sum()),
+            duration_s=float(duration_s),
+            mean_ms=float(latency.mean()) if len(latency) else 0.0,
+            p50_ms=pct(latency, 50),
+            p90_ms=pct(latency, 90),
+            p99_ms=pct(latency, 99),
+            p999_ms=pct(latency, 99.9),
+            max_ms=float(latency.max()) if len(latency) else 0.0,
+            queue_wait_p50_ms=pct(wait, 50),
+            queue_wait_p99_ms=pct(wait, 99),
+        )
+
+    def auto_levels(self, capacity_qps: float) -> List[float]:
+        """Rates bracketing an estimated capacity, from light load to overload"""
+        return [round(capacity_qps * f, 3) for f in (0.25, 0.5, 0.75, 0.9, 1.0, 1.1, 1.25)]
+
+    def sweep(self, qps_levels: Optional[Sequence[float]], duration_s: float,
+              latency_slo_ms: float, stop_after_overload: bool = True) -> Tuple[List[LoadLevel], dict]:
+        """
+        Run each level (ascending; None/empty: auto_levels around workers /
+        service_time). Stops after the first level that falls behind, whose
+        backlog only grows from there. Summary: saturation_qps = highest
+        achieved rate at a level that kept up within the SLO, max_throughput_qps
+        = highest rate achieved at any level (the server's capacity once overloaded).
+        """
+        service = None
+        if not qps_levels:
+            service = self.service_time()
+            qps_levels = self.auto_levels(self.workers / max(service, 1e-9))
+        levels = []
+        for qps in sorted(float(q) for q in qps_levels):
+            level = self.run(qps, duration_s)
+            levels.append(level)
+            print(f"      {qps:8.2f} qps -> {level.achieved_qps:8.2f} achieved, "
+                  f"p50 {level.p50_ms:8.2f}ms, p99 {level.p99_ms:8.2f}ms, "
+                  f"wait p99 {level.queue_wait_p99_ms:8.2f}ms")
+            if stop_after_overload and level.fell_behind():
+                break
+        sustained = [lv.achieved_qps for lv in levels if lv.keeps_up(latency_slo_ms)]
+        summary = {
+            'saturation_qps': max(sustained) if sustained else 0.0,
+            'max_throughput_qps': max(lv.achieved_qps for lv in levels) if levels else 0.0,
+            'latency_slo_ms': float(latency_slo_ms),
+            'workers': float(self.workers),
+        }
+        if service is not None:
+            summary['service_time_ms'] = service * 1000
+        return levels, summary
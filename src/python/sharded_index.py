@@ -0,0 +1,257 @@
+"""
+sharded_index.py
+Sharded Secure HNSW: one index shard per worker process
+
+The coordinator owns the CKKS keys and encrypts. Each worker process holds a
+SecureHNSWEncrypted shard and talks to the coordinator over a local socket
+(multiprocessing.connection). Ciphertexts cross the wire in SEAL's compressed
+serialization. A query is encrypted once, broadcast to every shard, and the
+per-shard top-k lists are merged by distance.
+
+All shards run on this host: workers are spawned locally and connect back to
+a listener bound to the loopback interface.
+"""
+import os
+import heapq
+import multiprocessing as mp
+from multiprocessing.connection import Listener, Client
+from typing import Dict, List, Tuple
+
+import numpy as np
+
+from .ckks_wrapper import HEContext
+from .data_generator import normalize_rows
+
+# Vectors per insert message sent to one shard
+_INSERT_CHUNK = 64
+
+
+def _shard_worker(address, authkey: bytes, shard_id: int):
+    """Worker process main loop: serve requests for one index shard"""
+    from .ckks_wrapper import pprag_core  # real or simulator build, as the coordinator
+
+    conn = Client(address, authkey=authkey)
+    conn.send(('hello', shard_id))
+    ctx = hnsw = None
+    while True:
+        op, *args = conn.recv()
+        try:
+            if op == 'init':
+                key_blob, index_config = args
+                ctx = pprag_core.CKKSContext.import_keys(key_blob)
+                hnsw = pprag_core.SecureHNSWEncrypted(
+                    ctx,
+                    index_config.get('hnsw_m', 16),
+                    index_config.get('hnsw_ef_construction', 200),
+                    index_config.get('hnsw_ef_search', 100))
+                hnsw.set_metric(pprag_core.parse_metric(index_config.get('metric', 'l2')))
+                storage_level = index_config.get('storage_level')
+                if storage_level is not None:
+                    if storage_level == 'min':
+                        storage_level = hnsw.min_storage_level()
+                    hnsw.set_storage_level(int(storage_level))
+                reply = None
+            elif op == 'reserve':
+                hnsw.reserve(args[0])
+                reply = None
+            elif op == 'insert':
+                reply = [hnsw.insert(ctx.deserialize(data)) for data in args[0]]
+            elif op == 'remove':
+                for local_id in args[0]:
+                    hnsw.remove(local_id)
+                reply = None
+            elif op == 'compact':
+                reply = hnsw.compact()
+            elif op == 'search':
+                data, k = args
+                reply = hnsw.search_with_distances(ctx.deserialize(data), k)
+            elif op == 'size':
+                reply = hnsw.size()
+            elif op == 'close':
+                conn.send(('ok', None))
+                break
+            else:
+                raise ValueError(f"unknown op {op!r}")
+            conn.send(('ok', reply))
+        except Exception as e:
+            conn.send(('error', f"shard {shard_id}: {e!r}"))
+    conn.close()
+
+
+class ShardedSecureHNSW:
+    """
+    Coordinator for a sharded encrypted index
+
+    Vectors are assigned to shards round-robin by global ID. Each shard keeps
+    its own local IDs; the coordinator maps them back to global IDs.
+    """
+
+    def __init__(self, he_ctx: HEContext, config: dict, num_shards: int = None):
+        index_config = config.get('index', {})
+        if num_shards is None:
+            num_shards = index_config.get('num_shards', 2)
+        self.num_shards = num_shards
+        self.he_ctx = he_ctx
+        self.metric = index_config.get('metric', 'l2')
+
+        authkey = os.urandom(16)
+        self._listener = Listener(('127.0.0.1', 0), authkey=authkey)
+        spawn = mp.get_context('spawn')
+        self._procs = [
+            spawn.Process(target=_shard_worker, args=(self._listener.address, authkey, s), daemon=True)
+            for s in range(num_shards)
+        ]
+        for p in self._procs:
+            p.start()
+
+        self._conns = [None] * num_shards
+        for _ in range(num_shards):
+            conn = self._listener.accept()
+            _, shard_id = conn.recv()
+            self._conns[shard_id] = conn
+
+        key_blob = he_ctx.ctx.export_keys()
+        self._broadcast(('init', key_blob, index_config))
+        print(f"[Sharded] {num_shards} shard workers ready "
+              f"(key material {len(key_blob) / 1e6:.1f} MB per shard)")
+
+        self._next_id = 0
+        self._local_to_global: List[Dict[int, int]] = [{} for _ in range(num_shards)]
+        self._global_to_local: Dict[int, Tuple[int, int]] = {}
+        self.bytes_sent = 0
+
+    # ==================== Transport ====================
+
+    def _send(self, shard: int, msg):
+        self._conns[shard].send(msg)
+
+    def _gather(self, shards, on_reply=None) -> list:
+        """
+        Read one reply from each shard, in order. A failure is raised only
+        after every reply has been read, so no connection is left holding a
+        stale reply for the next request. on_reply(shard, reply) runs for
+        every shard that succeeded, even when another one failed.
+        """
+        replies, errors = [], []
+        for s in shards:
+            status, reply = self._conns[s].recv()
+            if status != 'ok':
+                errors.append(reply)
+                continue
+            if on_reply is not None:
+                on_reply(s, reply)
+            replies.append(reply)
+        if errors:
+            raise RuntimeError('; '.join(errors))
+        return replies
+
+    def _broadcast(self, msg) -> list:
+        """Send to every shard first, then gather, so shards work in parallel"""
+        for s in range(self.num_shards):
+            self._send(s, msg)
+        return self._gather(range(self.num_shards))
+
+    # ==================== Index operations ====================
+
+    def build_index(self, vectors: np.ndarray):
+        """Encrypt vectors and distribute them across shards"""
+        print(f"[Sharded] Building Encrypted Index for {len(vectors)} vectors "
+              f"across {self.num_shards} shards...")
+        per_shard = (len(vectors) + self.num_shards - 1) // self.num_shards
+        self._broadcast(('reserve', per_shard))
+        self.insert(vectors)
+        print(f"\n[Sharded] Build complete.")
+        return []
+
+    def insert(self, vectors: np.ndarray) -> List[int]:
+        """Encrypt and insert vectors; returns the assigned global IDs"""
+        new_ids = []
+        step = _INSERT_CHUNK * self.num_shards
+        for start in range(0, len(vectors), step):
+            batches = [[] for _ in range(self.num_shards)]
+            gids = [[] for _ in range(self.num_shards)]
+            for vec in vectors[start:start + step]:
+                gid = self._next_id
+                self._next_id += 1
+                shard = gid % self.num_shards
+                batches[shard].append(self.he_ctx.ctx.serialize(self.he_ctx.encrypt(self._to_metric_space(vec))))
+                gids[shard].append(gid)
+                new_ids.append(gid)
+
+            active = [s for s in range(self.num_shards) if batches[s]]
+            for s in active:
+                self.bytes_sent += sum(len(b) for b in batches[s])
+                self._send(s, ('insert', batches[s]))
+
+            def record_ids(s, local_ids):
+                # Shards that succeeded keep their nodes mapped even if another failed
+                for local_id, gid in zip(local_ids, gids[s]):
+                    self._local_to_global[s][local_id] = gid
+                    self._global_to_local[gid] = (s, local_id)
+            self._gather(active, record_ids)
+            print(f"[Sharded] Indexed {start + sum(len(b) for b in batches)}/{len(vectors)}", end='\r')
+        return new_ids
+
+    def remove(self, ids: List[int]):
+        """Tombstone global IDs on their owning shards"""
+        per_shard = [[] for _ in range(self.num_shards)]
+        for gid in ids:
+            shard, local_id = self._global_to_local.pop(int(gid))
+            per_shard[shard].append(local_id)
+        active = [s for s in range(self.num_shards) if per_shard[s]]
+        for s in active:
+            self._send(s, ('remove', per_shard[s]))
+        self._gather(active)
+
+    def compact(self) -> int:
+        """Compact every shard; local IDs may be reused afterwards"""
+        reclaimed = sum(self._broadcast(('compact',)))
+        live = set(self._global_to_local.values())
+        for s in range(self.num_shards):
+            self._local_to_global[s] = {l: g for l, g in self._local_to_global[s].items() if (s, l) in live}
+        return reclaimed
+
+    def size(self) -> int:
+        return sum(self._broadcast(('size',)))
+
+    def search(self, query: np.ndarray, k: int = 10):
+        return self.search_encrypted(self.he_ctx.encrypt(self._to_metric_space(query)), k)
+
+    def search_encrypted(self, q_enc, k: int = 10):
+        """Scatter the encrypted query to all shards and merge their top-k by distance"""
+        data = self.he_ctx.ctx.serialize(q_enc)
+        self.bytes_sent += len(data) * self.num_shards
+        per_shard = self._broadcast(('search', data, k))
+        merged = heapq.nsmallest(k, (
+            (dist, self._local_to_global[s][local_id])
+            for s, results in enumerate(per_shard)
+            for dist, local_id in results
+        ))
+        return np.array([gid for _, gid in merged], dtype=np.int32)
+
+    def _to_metric_space(self, vec: np.ndarray) -> np.ndarray:
+        """Cosine compares unit vectors, so they are normalized before encryption"""
+        return normalize_rows(vec) if self.metric == 'cosine' else vec
+
+    # ==================== Lifecycle ====================
+
+    def close(self):
+        if self._listener is None:
+            return
+        for s in range(self.num_shards):
+            try:
+                self._send(s, ('close',))
+                self._gather([s])
+            except (EOFError, OSError, RuntimeError):
+                pass
+            self._conns[s].close()
+        for p in self._procs:
+            p.join(timeout=10)
+        self._listener.close()
+        self._listener = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
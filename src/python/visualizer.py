@@ -25,7 +25,9 @@ def plot_setup_breakdown(results: dict, output_dir: str = "./results/figures"):
     Generate a breakdown chart for the Setup phase.
     Shows time shares for encryption upload, secure K-Means, and secure HNSW build.
     """
-    setup_data = results.get('setup', [])
+    # Parallel-build results are an alternative to the serial build, not a share of it
+    setup_data = [r for r in results.get('setup', [])
+                  if not r['component'].endswith('_parallel')]
     if not setup_data:
         print("[Visualizer] No setup data found")
         return
@@ -73,8 +75,10 @@ def plot_retrieval_latency(results: dict, output_dir: str = "./results/figures")
         print("[Visualizer] No retrieve data found")
         return
     
-    # Filter search results
-    search_results = [r for r in retrieve_data if 'search_top' in r['operation']]
+    # Filter search results (plain search_top{k}; beam / sharded runs are separate sweeps)
+    search_results = [r for r in retrieve_data
+                      if r['component'] in ('secure_hnsw', 'secure_hnsw2')
+                      and r['operation'].replace('search_top', '').isdigit()]
     if not search_results:
         print("[Visualizer] No search results found")
         return
@@ -121,7 +125,8 @@ def plot_update_throughput(results: dict, output_dir: str = "./results/figures")
         print("[Visualizer] No update data found")
         return
     
-    # Separate insert and delete records
+    # Separate insert and delete records (concurrent-load runs are reported separately)
+    update_data = [r for r in update_data if not r['component'].endswith('_concurrent')]
     insert_data = [r for r in update_data if 'insert' in r['operation']]
     delete_data = [r for r in update_data if 'delete' in r['operation']]
     
@@ -257,7 +262,8 @@ def plot_scale_setup_comparison(results: dict, output_dir: str = "./results/figu
         if scale_name not in scales_data:
             continue
         scale_data = scales_data[scale_name]
-        setup_data = scale_data.get('setup', [])
+        setup_data = [r for r in scale_data.get('setup', [])
+                      if not r['component'].endswith('_parallel')]
         
         scale_names.append(scale_name.upper())
         total_time = sum(r['total_time'] for r in setup_data)
@@ -379,7 +385,8 @@ def plot_scale_update_comparison(results: dict, output_dir: str = "./results/fig
         if scale_name not in scales_data:
             continue
         scale_data = scales_data[scale_name]
-        update_data = scale_data.get('update', [])
+        update_data = [r for r in scale_data.get('update', [])
+                       if not r['component'].endswith('_concurrent')]
         
         # Compute average throughput
         insert_data = [r for r in update_data if 'insert' in r['operation']]